@@ -83,20 +83,7 @@ end
 on_recalculate_base_attribute(recalculate_base_attribute)
 on_update_derived_attribute(update_derived_attributes)
 
-function Entity:level()
-    return math.floor(self:base_attribute("Level"))
-end
-
-function Entity:give_experience(experience)
-    local old_experience = self:base_attribute("XP")
-    local old_level = self:level()
-    self:set_base_attribute("XP", old_experience + experience)
-    if self:level() > old_level then
-        self:say("LEVELUP!!! " .. self:level())
-        self:set_attribute_points(self:attribute_points() + 1)
-        self:set_correction_points(self:correction_points() + 1)
-    end
-end
+require "scripts/experience"
 
 local mobs_config = require "scripts/monster/settings"
 
@@ -0,0 +1,22 @@
+--[[
+
+ Experience and levels of characters. Unlike attributes.lua, this file does
+ not assign any callbacks, so map scripts running in a script state of their
+ own can require it as well.
+
+--]]
+
+function Entity:level()
+    return math.floor(self:base_attribute("Level"))
+end
+
+function Entity:give_experience(experience)
+    local old_experience = self:base_attribute("XP")
+    local old_level = self:level()
+    self:set_base_attribute("XP", old_experience + experience)
+    if self:level() > old_level then
+        self:say("LEVELUP!!! " .. self:level())
+        self:set_attribute_points(self:attribute_points() + 1)
+        self:set_correction_points(self:correction_points() + 1)
+    end
+end
@@ -7,6 +7,7 @@
 -- From scripts/
 require "scripts/lua/npclib"
 -- From example/scripts
+require "scripts/experience"
 require "scripts/npcs/banker"
 require "scripts/npcs/barber"
 require "scripts/npcs/merchant"
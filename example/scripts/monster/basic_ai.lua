@@ -32,6 +32,14 @@ end
 
 local mob_config = require "scripts/monster/settings"
 
+-- Directions of the positions from which a target can be attacked
+local attack_offsets = {
+    { -1, 0 },
+    { 0, -1 },
+    { 1, 0 },
+    { 0, 1 },
+}
+
 local function calculate_position_priority(x1, y1, x2, y2, anger, range)
     if math.floor(x1 / TILESIZE) == math.floor(x2 / TILESIZE) and
        math.floor(y1 / TILESIZE) == math.floor(y2 / TILESIZE)
@@ -57,50 +65,36 @@ local function update_attack_ai(mob, tick)
         return false
     end
 
-    for _, being in ipairs(get_beings_in_circle(mob, config.trackrange)) do
-        if being:type() == TYPE_CHARACTER
-           and being:action() ~= ACTION_DEAD
-        then
-            local anger = mob_status.angerlist[being] or 0
-            if anger == 0 and config.aggressive then
-                anger = 1
-            end
+    for_each_being_in_circle(mob, config.trackrange, TYPE_CHARACTER,
+                             function(being)
+        if being:action() == ACTION_DEAD then
+            return
+        end
 
-            local possible_attack_positions = {
-                {
-                    x = being:x() - config.attack_distance,
-                    y = being:y(),
-                },
-                {
-                    x = being:x(),
-                    y = being:y() - config.attack_distance,
-                },
-                {
-                    x = being:x() + config.attack_distance,
-                    y = being:y(),
-                },
-                {
-                    x = being:x(),
-                    y = being:y() + config.attack_distance,
-                },
-            }
-            for _, point in ipairs(possible_attack_positions) do
-                local priority = calculate_position_priority(mob:x(),
-                                                             mob:y(),
-                                                             point.x,
-                                                             point.y,
-                                                             anger,
-                                                             config.trackrange)
-
-                if priority > 0 and (not target or priority > target_priority)
-                then
-                    target = being
-                    target_priority = priority
-                    attack_x, attack_y = point.x, point.y
-                end
+        local anger = mob_status.angerlist[being] or 0
+        if anger == 0 and config.aggressive then
+            anger = 1
+        end
+
+        local being_x, being_y = being:position()
+        for _, offset in ipairs(attack_offsets) do
+            local x = being_x + offset[1] * config.attack_distance
+            local y = being_y + offset[2] * config.attack_distance
+            local priority = calculate_position_priority(mob:x(),
+                                                         mob:y(),
+                                                         x,
+                                                         y,
+                                                         anger,
+                                                         config.trackrange)
+
+            if priority > 0 and (not target or priority > target_priority)
+            then
+                target = being
+                target_priority = priority
+                attack_x, attack_y = x, y
             end
         end
-    end
+    end)
 
     mob_status.update_target_timer = tick + TARGET_SEARCH_DELAY
 
@@ -106,48 +106,6 @@ function DEBUG(...) log(LOG_DEBUG, table.concat({...}, " ")) end
 -- Array containing the function registered by atinit.
 local init_fun = {}
 
--- Set of scheduled jobs. The key is the mapid or 0 for no map.
--- The value is an array with 3 elements:
--- 0: the UNIX timestamp when it is executed
--- 1: the function which is executed
--- 2: nil when it is a one-time job. Repetition interval is seconds when it is
---    a repeated job.
-local scheduler_jobs = {}
-
--- checks for jobs which have to be executed, executes them and reschedules
--- them when they are repeated jobs.
-local function check_schedule(mapid)
-  local current_time = os.time()
-  local jobs
-
-  jobs = scheduler_jobs[mapid or 0]
-
-  if not jobs then return end
-
-  while #jobs ~= 0 and current_time >= jobs[#jobs][0] do
-    -- retreive the job and remove it from the schedule
-    local job = jobs[#jobs]
-    table.remove(jobs)
-    -- reschedule the job when it is a repeated job
-    if job[2] then
-        schedule_every(job[2], job[1])
-    end
-    -- execute the job
-    job[1]()
-  end
-end
-
--- Registered as the function to call every tick.
-local function update()
-    check_schedule()
-end
-
--- Registered as function to call every map tick.
--- Checks for scheduled function calls
-local function mapupdate(mapid)
-    check_schedule(mapid)
-end
-
 --- LUA_CATEGORY Scheduling (scheduling)
 
 --- LUA atinit (scheduling)
@@ -187,56 +145,17 @@ end
 
 -- SCHEDULER
 
--- compare function used to sort the scheduler_jobs table.
--- the jobs which come first are at the end of the table.
-local function job_cmp(job1, job2)
-  return (job1[0] > job2[0])
-end
-
---- LUA schedule_in (scheduling)
--- schedule_in(seconds, function() [function body] end)
----
--- Executes the ''function body'' in ''seconds'' seconds.
-function schedule_in(seconds, funct)
-  local job = {}
-  job[0] = os.time() + seconds
-  job[1] = funct
-  job[2] = nil
-  local map_id = get_map_id() or 0 -- if no map context
-  scheduler_jobs[map_id] = scheduler_jobs[map_id] or {}
-  table.insert(scheduler_jobs[map_id], job)
-  table.sort(scheduler_jobs[map_id], job_cmp)
-end
-
---- LUA schedule_every (scheduling)
--- schedule_every(seconds, function() [function body] end)
----
--- Executes the ''function body'' every ''seconds'' seconds from now on.
-function schedule_every(seconds, funct)
-  local job = {}
-  job[0] = os.time() + seconds
-  job[1] = funct
-  job[2] = seconds
-  local map_id = get_map_id() or 0 -- if no map context
-  scheduler_jobs[map_id] = scheduler_jobs[map_id] or {}
-  table.insert(scheduler_jobs[map_id], job)
-  table.sort(scheduler_jobs[map_id], job_cmp)
-end
-
 --- LUA schedule_per_date (scheduling)
 -- schedule_per_date(year, month, day, hour, minute, function() [function body] end)
 ---
+-- **Return value:** A handle for cancelling the job with
+-- [schedule_cancel](scripting.html#schedule_cancel).
+--
 -- Executes the ''function body'' at the given date and time.
 function schedule_per_date(my_year, my_month, my_day, my_hour, my_minute, funct)
-  local job = {}
-  job[0] = os.time{year = my_year, month = my_month, day = my_day,
-                   hour = my_hour, min = my_minute}
-  job[1] = funct
-  job[2] = nil
-  local map_id = get_map_id() or 0 -- if no map context
-  scheduler_jobs[map_id] = scheduler_jobs[map_id] or {}
-  table.insert(scheduler_jobs[map_id], job)
-  table.sort(scheduler_jobs[map_id], job_cmp)
+  local time = os.time{year = my_year, month = my_month, day = my_day,
+                       hour = my_hour, min = my_minute}
+  return schedule_in(os.difftime(time, os.time()), funct)
 end
 
 -- MAP/WORLD VARIABLES NOTIFICATIONS
@@ -396,9 +315,6 @@ function Entity:money()
 end
 
 -- Register callbacks
-on_update(update)
-on_mapupdate(mapupdate)
-
 on_create_npc_delayed(create_npc_delayed)
 on_map_initialize(map_initialize)
 
@@ -242,6 +242,7 @@ void AccountClientHandler::deinitialize()
 void AccountClientHandler::process()
 {
     accountHandler->process(50);
+    accountHandler->mTokenCollector.removeExpired();
 }
 
 void AccountClientHandler::prepareReconnect(const std::string &token, int id)
@@ -249,6 +250,22 @@ void AccountClientHandler::prepareReconnect(const std::string &token, int id)
     accountHandler->mTokenCollector.addPendingConnect(token, id);
 }
 
+void AccountClientHandler::dumpStatistics(std::ostream &os)
+{
+    const TokenCollector<AccountHandler, AccountClient *, int> &collector =
+            accountHandler->mTokenCollector;
+    const TokenStatistics &stats = collector.getStatistics();
+
+    os << "<tokens matched=\"" << stats.matched
+       << "\" max_latency=\"" << stats.maxMatchLatency
+       << "\" total_latency=\"" << stats.totalMatchLatency
+       << "\" expired_clients=\"" << stats.expiredClients
+       << "\" expired_connects=\"" << stats.expiredConnects
+       << "\" pending_clients=\"" << collector.getPendingClientCount()
+       << "\" pending_connects=\"" << collector.getPendingConnectCount()
+       << "\" />\n";
+}
+
 NetComputer *AccountHandler::computerConnected(ENetPeer *peer)
 {
     return new AccountClient(peer);
@@ -368,10 +385,10 @@ void AccountHandler::handleLoginMessage(AccountClient &client, MessageIn &msg)
     }
     mLastLoginAttemptForIP[address] = now;
 
-    const std::string username = msg.readString();
-    const std::string password = msg.readString();
+    // Rejected logins do not need copies of the credentials
+    const utils::StringView usernameView = msg.readStringView();
 
-    if (stringFilter->findDoubleQuotes(username))
+    if (stringFilter->findDoubleQuotes(usernameView))
     {
         reply.writeInt8(ERRMSG_INVALID_ARGUMENT);
         client.send(reply);
@@ -388,6 +405,9 @@ void AccountHandler::handleLoginMessage(AccountClient &client, MessageIn &msg)
         return;
     }
 
+    const std::string username = usernameView.str();
+    const std::string password = msg.readString();
+
     // Check if the account exists
     Account *acc = nullptr;
     for (Account *account : mPendingAccounts)
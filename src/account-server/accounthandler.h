@@ -21,6 +21,7 @@
 #ifndef ACCOUNTHANDLER_H
 #define ACCOUNTHANDLER_H
 
+#include <iosfwd>
 #include <string>
 
 namespace AccountClientHandler
@@ -45,6 +46,11 @@ namespace AccountClientHandler
      * Processes messages received by the connection handler.
      */
     void process();
+
+    /**
+     * Dumps the statistics of the reconnection tokens.
+     */
+    void dumpStatistics(std::ostream &os);
 }
 
 #endif // ACCOUNTHANDLER_H
@@ -25,6 +25,8 @@
 #include "net/messagein.h"
 #include "net/messageout.h"
 
+using namespace ManaServ;
+
 CharacterData::CharacterData(const std::string &name, int id):
     mName(name),
     mDatabaseID(id),
@@ -208,6 +210,117 @@ void CharacterData::deserialize(MessageIn &msg)
     poss.setEquipment(equipmentData);
 }
 
+bool CharacterData::deserializeSnapshot(MessageIn &msg)
+{
+    const int version = msg.readInt8();
+    if (version != CHARACTER_SNAPSHOT_VERSION)
+        return false;
+
+    const int sections = msg.readInt8();
+
+    if (sections & SNAPSHOT_GENERAL)
+    {
+        setAccountLevel(msg.readInt8());
+        setGender(ManaServ::getGender(msg.readInt8()));
+        setHairStyle(msg.readInt8());
+        setHairColor(msg.readInt8());
+        setAttributePoints(msg.readInt16());
+        setCorrectionPoints(msg.readInt16());
+    }
+
+    if (sections & SNAPSHOT_ATTRIBUTES)
+    {
+        const unsigned attrSize = msg.readVarInt();
+        for (unsigned i = 0; i < attrSize; ++i)
+        {
+            unsigned id = msg.readVarInt();
+            double base = msg.readDouble(),
+                   mod  = msg.readDouble();
+            setAttribute(id, base);
+            setModAttribute(id, mod);
+        }
+    }
+
+    if (sections & SNAPSHOT_STATUS)
+    {
+        const unsigned statusSize = msg.readVarInt();
+        for (unsigned i = 0; i < statusSize; ++i)
+        {
+            int status = msg.readVarInt();
+            int time = msg.readVarInt();
+            applyStatusEffect(status, time);
+        }
+    }
+
+    if (sections & SNAPSHOT_LOCATION)
+    {
+        setMapId(msg.readInt16());
+
+        Point temporaryPoint;
+        temporaryPoint.x = msg.readInt16();
+        temporaryPoint.y = msg.readInt16();
+        setPosition(temporaryPoint);
+    }
+
+    if (sections & SNAPSHOT_KILLS)
+    {
+        const unsigned killSize = msg.readVarInt();
+        for (unsigned i = 0; i < killSize; ++i)
+        {
+            int monsterId = msg.readVarInt();
+            int kills = msg.readVarInt();
+            setKillCount(monsterId, kills);
+        }
+    }
+
+    if (sections & SNAPSHOT_ABILITIES)
+    {
+        const unsigned abilitiesSize = msg.readVarInt();
+        clearAbilities();
+        for (unsigned i = 0; i < abilitiesSize; ++i)
+            giveAbility(msg.readVarInt());
+    }
+
+    if (sections & SNAPSHOT_QUESTS)
+    {
+        const unsigned questlogSize = msg.readVarInt();
+        mQuests.clear();
+        for (unsigned i = 0; i < questlogSize; ++i)
+        {
+            QuestInfo quest;
+            quest.id = msg.readVarInt();
+            quest.state = msg.readInt8();
+            quest.title = msg.readString();
+            quest.description = msg.readString();
+            mQuests.push_back(quest);
+        }
+    }
+
+    if (sections & SNAPSHOT_INVENTORY)
+    {
+        InventoryData inventoryData;
+        EquipData equipmentData;
+        const unsigned inventorySize = msg.readVarInt();
+        for (unsigned i = 0; i < inventorySize; ++i)
+        {
+            InventoryItem item;
+            item.slot          = msg.readVarInt();
+            item.itemId        = msg.readVarInt();
+            item.amount        = msg.readVarInt();
+            item.equipmentSlot = msg.readInt8();
+            inventoryData.insert(std::make_pair(item.slot, item));
+            if (item.equipmentSlot != 0)
+                equipmentData.insert(item.slot);
+        }
+
+        Possessions &poss = getPossessions();
+        poss.setInventory(inventoryData);
+        poss.setEquipment(equipmentData);
+    }
+
+    return true;
+}
+
 void CharacterData::setAccount(Account *acc)
 {
     mAccount = acc;
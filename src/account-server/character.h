@@ -85,6 +85,14 @@ class CharacterData
         void serialize(MessageOut &msg);
         void deserialize(MessageIn &msg);
 
+        /**
+         * Applies the sections of a GAMSG_PLAYER_SNAPSHOT, after the
+         * sequence number. Sections that are not included keep their value.
+         *
+         * @return false when the snapshot version is not supported.
+         */
+        bool deserializeSnapshot(MessageIn &msg);
+
         /**
          * Gets the database id of the character.
          */
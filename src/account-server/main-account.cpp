@@ -41,11 +41,13 @@
 #include "net/bandwidth.h"
 #include "net/connectionhandler.h"
 #include "net/messageout.h"
+#include "net/netcomputer.h"
 #include "utils/logger.h"
 #include "utils/processorutils.h"
 #include "utils/stringfilter.h"
 #include "utils/time.h"
 #include "utils/timer.h"
+#include "utils/tracer.h"
 
 #include <cstdlib>
 #include <getopt.h>
@@ -56,9 +58,11 @@
 #include <enet/enet.h>
 
 using utils::Logger;
+using utils::Tracer;
 
 // Default options that automake should be able to override.
 #define DEFAULT_LOG_FILE          "manaserv-account.log"
+#define DEFAULT_TRACE_FILE        "manaserv-account.trace.json"
 #define DEFAULT_STATS_FILE        "manaserv.stats"
 #define DEFAULT_ATTRIBUTEDB_FILE  "attributes.xml"
 
@@ -85,6 +89,12 @@ static void closeGracefully(int)
     running = false;
 }
 
+/** Callback used when SIGUSR1 signal is received. */
+static void dumpTrace(int)
+{
+    Tracer::requestDump();
+}
+
 /**
  * Initializes the server.
  */
@@ -96,6 +106,9 @@ static void initialize()
 #endif
     signal(SIGINT, closeGracefully);
     signal(SIGTERM, closeGracefully);
+#ifndef _WIN32
+    signal(SIGUSR1, dumpTrace);
+#endif
 
     std::string logFile = Configuration::getValue("log_accountServerFile",
                                                   DEFAULT_LOG_FILE);
@@ -105,6 +118,9 @@ static void initialize()
 
     Logger::initialize(logFile);
 
+    Tracer::initialize(Configuration::getValue("log_accountTraceFile",
+                                               DEFAULT_TRACE_FILE));
+
     // Indicate in which file the statistics are put.
     statisticsFile = Configuration::getValue("log_statisticsFile",
                                              DEFAULT_STATS_FILE);
@@ -131,6 +147,8 @@ static void initialize()
     guildManager = new GuildManager;
     postalManager = new PostManager;
     gBandwidth = new BandwidthMonitor;
+    NetComputer::setCompressionThreshold(
+            Configuration::getValue("net_compressionThreshold", 256));
 
     // --- Initialize the global handlers
     // FIXME: Make the global handlers global vars or part of a bigger
@@ -180,6 +198,9 @@ static void deinitializeServer()
     delete storage;
 
     PHYSFS_deinit();
+
+    // Write the pending log messages
+    Logger::deinitialize();
 }
 
 /**
@@ -197,6 +218,10 @@ static void dumpStatistics(std::string accountAddress, int accountClientPort,
     os << "<accountserver address=\"" << accountAddress << "\" clientport=\""
     << accountClientPort << "\" gameport=\"" << accountGamePort
     << "\" chatclientport=\"" << chatClientPort << "\" />\n";
+    // Add the network traffic of the account server
+    gBandwidth->dumpStatistics(os);
+    // Add the reconnection tokens of the account server
+    AccountClientHandler::dumpStatistics(os);
     // Add game servers information
     GameServerHandler::dumpStatistics(os);
     os << "</statistics>\n";
@@ -377,6 +402,8 @@ int main(int argc, char *argv[])
 
     while (running)
     {
+        Tracer::update();
+
         AccountClientHandler::process();
         GameServerHandler::process();
         chatHandler->process(50);
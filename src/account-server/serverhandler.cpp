@@ -18,6 +18,7 @@
  *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cassert>
 #include <sstream>
 #include <list>
@@ -36,8 +37,10 @@
 #include "common/defines.h"
 #include "common/manaserv_protocol.h"
 #include "common/transaction.h"
+#include "net/bandwidth.h"
 #include "net/connectionhandler.h"
 #include "net/messageout.h"
+#include "net/messageschema.h"
 #include "net/netcomputer.h"
 #include "utils/logger.h"
 #include "utils/tokendispenser.h"
@@ -53,17 +56,35 @@ struct MapStatistics
 
 typedef std::map<unsigned short, MapStatistics> ServerStatistics;
 
+/**
+ * Traffic caused by one message type on a game server.
+ */
+struct MessageTraffic
+{
+    MessageStatistics sent;
+    MessageStatistics received;
+};
+
+typedef std::map<unsigned short, MessageTraffic> TrafficStatistics;
+
 /**
  * Stores address, maps, and statistics, of a connected game server.
  */
 struct GameServer: NetComputer
 {
-    GameServer(ENetPeer *peer): NetComputer(peer), server(0), port(0) {}
+    GameServer(ENetPeer *peer):
+        NetComputer(peer), server(0), capabilities(0), syncSequence(0),
+        overloadLevel(0), deferredLogins(0), port(0) {}
 
     std::string name;
     std::string address;
     NetComputer *server;
     ServerStatistics maps;
+    TrafficStatistics traffic;  /**< Accumulated since it registered. */
+    int capabilities;           /**< Accepted in GAMSG_REGISTER. */
+    unsigned syncSequence;      /**< Last sync batch applied. */
+    int overloadLevel;          /**< Last reported in GAMSG_STATISTICS. */
+    int deferredLogins;         /**< Last reported in GAMSG_STATISTICS. */
     short port;
 };
 
@@ -158,6 +179,7 @@ static void registerGameClient(GameServer *s, const std::string &token,
                                CharacterData *ptr)
 {
     MessageOut msg(AGMSG_PLAYER_ENTER);
+    msg.setBinaryEncoding(s->capabilities & CAPABILITY_BINARY_ENCODING);
     msg.writeString(token, MAGIC_TOKEN_LENGTH);
     msg.writeInt32(ptr->getDatabaseID());
     msg.writeString(ptr->getName());
@@ -192,6 +214,14 @@ void ServerHandler::processMessage(NetComputer *comp, MessageIn &msg)
             unsigned dbversion = msg.readInt32();
             LOG_INFO("Game server uses itemsdatabase with version " << dbversion);
 
+            // Older game servers do not send any capabilities
+            const bool capabilitiesNegotiated = msg.getUnreadLength() > 0;
+            if (capabilitiesNegotiated)
+            {
+                server->capabilities =
+                        msg.readInt16() & SUPPORTED_SERVER_CAPABILITIES;
+            }
+
             LOG_DEBUG("AGMSG_REGISTER_RESPONSE");
             MessageOut outMsg(AGMSG_REGISTER_RESPONSE);
             if (dbversion == storage->getItemDatabaseVersion())
@@ -219,6 +249,11 @@ void ServerHandler::processMessage(NetComputer *comp, MessageIn &msg)
                     outMsg.writeString(variableIt.second);
                 }
 
+                // Comes last, so older game servers read the variables
+                // without knowing about it
+                if (capabilitiesNegotiated)
+                    outMsg.writeInt16(server->capabilities);
+
                 comp->send(outMsg);
             }
             else
@@ -305,12 +340,66 @@ void ServerHandler::processMessage(NetComputer *comp, MessageIn &msg)
             }
         } break;
 
+        case GAMSG_PLAYER_SNAPSHOT:
+        {
+            LOG_DEBUG("GAMSG_PLAYER_SNAPSHOT");
+            const int id = msg.readInt32();
+            const unsigned sequence = msg.readInt32();
+            CharacterData *ptr = storage->getCharacter(id, nullptr);
+            if (!ptr)
+            {
+                LOG_ERROR("Received data for non-existing character "
+                          << id << '.');
+                break;
+            }
+
+            // Sections that are not included did not change since the
+            // last acknowledged snapshot, so the stored ones are up to date.
+            if (!ptr->deserializeSnapshot(msg))
+            {
+                LOG_ERROR("Unsupported snapshot version for character "
+                          << id << '.');
+            }
+            else if (!storage->updateCharacter(ptr))
+            {
+                LOG_ERROR("Failed to update character " << id << '.');
+            }
+            else
+            {
+                MessageOut ackMsg(AGMSG_PLAYER_SNAPSHOT_ACK);
+                ackMsg.writeInt32(id);
+                ackMsg.writeInt32(sequence);
+                comp->send(ackMsg);
+            }
+            delete ptr;
+        } break;
+
         case GAMSG_PLAYER_SYNC:
         {
             LOG_DEBUG("GAMSG_PLAYER_SYNC");
             GameServerHandler::syncDatabase(msg);
         } break;
 
+        case GAMSG_PLAYER_SYNC_SEQUENCED:
+        {
+            LOG_DEBUG("GAMSG_PLAYER_SYNC_SEQUENCED");
+            const unsigned sequence = msg.readInt32();
+
+            // Batches are replayed when the game server reconnects, so a
+            // batch may arrive again. The sync data only sets values, so
+            // applying a batch that was applied over an earlier connection
+            // is harmless.
+            if (sequence > server->syncSequence)
+            {
+                GameServerHandler::syncDatabase(msg);
+                server->syncSequence = sequence;
+            }
+
+            MessageOut ackMsg(AGMSG_PLAYER_SYNC_ACK);
+            ackMsg.writeInt32(server->syncSequence);
+            comp->send(ackMsg);
+        } break;
+
         case GAMSG_REDIRECT:
         {
             LOG_DEBUG("GAMSG_REDIRECT");
@@ -431,6 +520,9 @@ void ServerHandler::processMessage(NetComputer *comp, MessageIn &msg)
             while (msg.getUnreadLength())
             {
                 int mapId = msg.readInt16();
+                if (mapId == 0)
+                    break;
+
                 ServerStatistics::iterator i = server->maps.find(mapId);
                 if (i == server->maps.end())
                 {
@@ -441,15 +533,45 @@ void ServerHandler::processMessage(NetComputer *comp, MessageIn &msg)
                     break;
                 }
                 MapStatistics &m = i->second;
-                m.nbEntities = msg.readInt16();
-                m.nbMonsters = msg.readInt16();
-                int nb = msg.readInt16();
+                schema::MapStatistics stats;
+                if (!msg.read(stats))
+                    break;
+
+                m.nbEntities = stats[0];
+                m.nbMonsters = stats[1];
+                const int nb = stats[2];
+                if (nb < 0 || msg.getUnreadCount<schema::MapPlayer>() < nb)
+                {
+                    m.players.clear();
+                    break;
+                }
+
                 m.players.resize(nb);
-                for (int j = 0; j < nb; ++j)
+                schema::MapPlayer player;
+                for (int p = 0; p < nb; ++p)
                 {
-                    m.players[j] = msg.readInt32();
+                    msg.read(player);
+                    m.players[p] = player[0];
                 }
             }
+
+            if (server->capabilities & CAPABILITY_LOAD_STATISTICS)
+            {
+                server->overloadLevel = msg.readInt16();
+                server->deferredLogins = msg.readInt16();
+            }
+
+            schema::MessageTraffic record;
+            for (int n = msg.getUnreadCount<schema::MessageTraffic>(); n > 0;
+                 --n)
+            {
+                msg.read(record);
+                MessageTraffic &t = server->traffic[record[0]];
+                t.sent.count += (unsigned) record[1];
+                t.sent.bytes += (unsigned) record[2];
+                t.received.count += (unsigned) record[3];
+                t.received.bytes += (unsigned) record[4];
+            }
         } break;
 
         case GCMSG_REQUEST_POST:
@@ -627,6 +749,13 @@ void GameServerHandler::dumpStatistics(std::ostream &os)
         os << "<gameserver address=\"" << server->address << "\" port=\""
            << server->port << "\">\n";
 
+        if (server->capabilities & CAPABILITY_LOAD_STATISTICS)
+        {
+            os << "<load overload_level=\"" << server->overloadLevel
+               << "\" deferred_logins=\"" << server->deferredLogins
+               << "\"/>\n";
+        }
+
         for (ServerStatistics::const_iterator j = server->maps.begin(),
              j_end = server->maps.end(); j != j_end; ++j)
         {
@@ -640,6 +769,19 @@ void GameServerHandler::dumpStatistics(std::ostream &os)
             }
             os << "</map>\n";
         }
+
+        os << "<network>\n";
+        for (TrafficStatistics::const_iterator j = server->traffic.begin(),
+             j_end = server->traffic.end(); j != j_end; ++j)
+        {
+            const MessageTraffic &t = j->second;
+            os << "<message id=\"" << j->first
+               << "\" sent=\"" << t.sent.count
+               << "\" sent_bytes=\"" << t.sent.bytes
+               << "\" received=\"" << t.received.count
+               << "\" received_bytes=\"" << t.received.bytes << "\"/>\n";
+        }
+        os << "</network>\n";
         os << "</gameserver>\n";
     }
 }
@@ -685,6 +827,16 @@ void GameServerHandler::syncDatabase(MessageIn &msg)
                 storage->updateAttribute(charId, attrId, base, mod);
             } break;
 
+            case SYNC_CHARACTER_ATTRIBUTE_COMPACT:
+            {
+                LOG_DEBUG("received SYNC_CHARACTER_ATTRIBUTE_COMPACT");
+                int    charId = msg.readVarInt();
+                int    attrId = msg.readVarInt();
+                double base   = msg.readDouble();
+                double mod    = msg.readDouble();
+                storage->updateAttribute(charId, attrId, base, mod);
+            } break;
+
             case SYNC_ONLINE_STATUS:
             {
                 LOG_DEBUG("received SYNC_ONLINE_STATUS");
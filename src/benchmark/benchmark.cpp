@@ -0,0 +1,133 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "benchmark/benchmark.h"
+
+#include "utils/logger.h"
+
+#include <chrono>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+
+typedef std::chrono::steady_clock Clock;
+
+BenchmarkRunner::BenchmarkRunner(unsigned batches, const std::string &filter):
+    mBatches(batches),
+    mFilter(filter)
+{
+}
+
+bool BenchmarkRunner::isSelected(const std::string &name) const
+{
+    return mFilter.empty() || name.find(mFilter) != std::string::npos;
+}
+
+void BenchmarkRunner::run(const std::string &name, unsigned operations,
+                          const Function &batch, const Function &prepare)
+{
+    if (!isSelected(name) || operations == 0)
+        return;
+
+    LOG_INFO("Running benchmark " << name);
+
+    // Warm up caches, allocators and branch predictors
+    const unsigned warmup = mBatches / 10 + 1;
+    for (unsigned i = 0; i < warmup; ++i)
+    {
+        if (prepare)
+            prepare();
+        batch();
+    }
+
+    mResults.push_back(Result());
+    Result &result = mResults.back();
+    result.name = name;
+    result.operations = 0;
+    result.time = 0;
+
+    for (unsigned i = 0; i < mBatches; ++i)
+    {
+        if (prepare)
+            prepare();
+
+        const Clock::time_point start = Clock::now();
+        batch();
+        const Clock::time_point end = Clock::now();
+
+        const unsigned long long time =
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        end - start).count();
+        result.operations += operations;
+        result.time += time;
+        result.histogram.record(time / operations);
+    }
+}
+
+void BenchmarkRunner::setContext(const std::string &key, long value)
+{
+    std::ostringstream text;
+    text << value;
+    mContext[key] = text.str();
+}
+
+void BenchmarkRunner::writeJson(std::ostream &os) const
+{
+    os << "{\n  \"context\": {";
+    for (std::map<std::string, std::string>::const_iterator
+         i = mContext.begin(), i_end = mContext.end(); i != i_end; ++i)
+    {
+        os << (i == mContext.begin() ? "\n" : ",\n")
+           << "    \"" << i->first << "\": \"" << i->second << '"';
+    }
+    os << "\n  },\n  \"benchmarks\": [";
+
+    for (std::vector<Result>::const_iterator i = mResults.begin(),
+         i_end = mResults.end(); i != i_end; ++i)
+    {
+        const utils::Histogram &histogram = i->histogram;
+        os << (i == mResults.begin() ? "\n" : ",\n")
+           << "    {\"name\": \"" << i->name << '"'
+           << ", \"operations\": " << i->operations
+           << ", \"mean_ns\": " << i->time / i->operations
+           << ", \"p50_ns\": " << histogram.getPercentile(50)
+           << ", \"p90_ns\": " << histogram.getPercentile(90)
+           << ", \"p99_ns\": " << histogram.getPercentile(99)
+           << ", \"max_ns\": " << histogram.getMax() << '}';
+    }
+    os << "\n  ]\n}\n";
+}
+
+void BenchmarkRunner::writeSummary(std::ostream &os) const
+{
+    os << std::left << std::setw(40) << "benchmark" << std::right
+       << std::setw(12) << "mean ns" << std::setw(12) << "p50 ns"
+       << std::setw(12) << "p99 ns" << std::endl;
+
+    for (std::vector<Result>::const_iterator i = mResults.begin(),
+         i_end = mResults.end(); i != i_end; ++i)
+    {
+        os << std::left << std::setw(40) << i->name << std::right
+           << std::setw(12) << i->time / i->operations
+           << std::setw(12) << i->histogram.getPercentile(50)
+           << std::setw(12) << i->histogram.getPercentile(99) << std::endl;
+    }
+}
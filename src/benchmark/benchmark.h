@@ -0,0 +1,103 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "utils/histogram.h"
+
+#include <functional>
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Runs pieces of code many times and collects how long they take.
+ *
+ * A benchmark is run as a number of batches of operations. The time of a
+ * batch is divided by its number of operations and counted in a histogram,
+ * so that reading the clock does not dominate cheap operations. A
+ * preparation step before each batch is not measured.
+ *
+ * The results are written as JSON with a fixed layout and no timestamps,
+ * so that the output of two builds can be compared directly.
+ */
+class BenchmarkRunner
+{
+    public:
+        typedef std::function<void ()> Function;
+
+        /**
+         * @param batches number of measured batches of each benchmark.
+         * @param filter  only benchmarks whose name contains it are run.
+         */
+        BenchmarkRunner(unsigned batches, const std::string &filter);
+
+        /**
+         * Returns whether the benchmark of the given name is to be run.
+         */
+        bool isSelected(const std::string &name) const;
+
+        /**
+         * Runs a benchmark, unless it is filtered out. A tenth of the
+         * batches is run first without being measured.
+         *
+         * @param name       unique name of the benchmark.
+         * @param operations number of operations done by one batch.
+         * @param batch      the measured code.
+         * @param prepare    code run before each batch, not measured.
+         */
+        void run(const std::string &name, unsigned operations,
+                 const Function &batch,
+                 const Function &prepare = Function());
+
+        /**
+         * Adds a value describing the conditions of the run to the output.
+         */
+        void setContext(const std::string &key, const std::string &value)
+        { mContext[key] = value; }
+
+        void setContext(const std::string &key, long value);
+
+        void writeJson(std::ostream &os) const;
+
+        /**
+         * Writes a short table of the results for humans.
+         */
+        void writeSummary(std::ostream &os) const;
+
+    private:
+        struct Result
+        {
+            std::string name;
+            unsigned long operations;   /**< Measured operations. */
+            unsigned long long time;    /**< Nanoseconds spent in them. */
+            utils::Histogram histogram; /**< Nanoseconds per operation. */
+        };
+
+        unsigned mBatches;
+        std::string mFilter;
+        std::map<std::string, std::string> mContext;
+        std::vector<Result> mResults;
+};
+
+#endif // BENCHMARK_H
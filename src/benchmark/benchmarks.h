@@ -0,0 +1,47 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <vector>
+
+class BenchmarkRunner;
+
+/**
+ * Benchmarks of code that needs no game world: message encoding and
+ * decoding, sha256, the slang filter and attribute modifiers.
+ */
+void runCoreBenchmarks(BenchmarkRunner &runner);
+
+/**
+ * Benchmarks of the game world: path finding on every loaded map, and zone
+ * iterators and player updates among crowds of characters walking around
+ * on the given map.
+ *
+ * @param mapId       the map the crowds are put on.
+ * @param crowdSizes  the numbers of characters of the crowds.
+ * @param port        local port used to connect the characters.
+ */
+void runWorldBenchmarks(BenchmarkRunner &runner, int mapId,
+                        const std::vector<int> &crowdSizes, int port);
+
+#endif // BENCHMARKS_H
@@ -0,0 +1,339 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "benchmark/benchmarks.h"
+
+#include "benchmark/benchmark.h"
+#include "common/manaserv_protocol.h"
+#include "game-server/attribute.h"
+#include "game-server/attributemanager.h"
+#include "net/messagein.h"
+#include "net/messageout.h"
+#include "net/messageschema.h"
+#include "utils/sha256.h"
+#include "utils/stringfilter.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <set>
+#include <sstream>
+
+using namespace ManaServ;
+
+/** Operations per batch of the cheap benchmarks. */
+static const unsigned BATCH_OPERATIONS = 1000;
+
+/** Keeps the compiler from optimizing the measured code away. */
+static unsigned long sink;
+
+static void benchmarkSha256(BenchmarkRunner &runner)
+{
+    // A password hash with its salt, as checked at each login
+    const std::string shortText = sha256("password") + "salt";
+    const std::string longText(1024, 'x');
+
+    runner.run("sha256/short", BATCH_OPERATIONS, [&] {
+        for (unsigned i = 0; i < BATCH_OPERATIONS; ++i)
+            sink += sha256(shortText).size();
+    });
+    runner.run("sha256/1024", BATCH_OPERATIONS, [&] {
+        for (unsigned i = 0; i < BATCH_OPERATIONS; ++i)
+            sink += sha256(longText).size();
+    });
+}
+
+/**
+ * Writes a message like the one a client gets when a character comes in
+ * sight.
+ */
+static void writeSmallMessage(MessageOut &msg, int id)
+{
+    msg.writeInt8(OBJECT_CHARACTER);
+    msg.writeInt16(id);
+    msg.writeInt8(0);
+    msg.writeInt16(1200);
+    msg.writeInt16(800);
+    msg.writeInt8(2);
+    msg.writeInt8(1);
+    msg.writeString("Benchmarker");
+    msg.writeInt8(0);
+    msg.writeInt8(3);
+}
+
+static void readSmallMessage(MessageIn &msg)
+{
+    sink += msg.readInt8();
+    sink += msg.readInt16();
+    sink += msg.readInt8();
+    sink += msg.readInt16();
+    sink += msg.readInt16();
+    sink += msg.readInt8();
+    sink += msg.readInt8();
+    sink += msg.readString().size();
+    sink += msg.readInt8();
+    sink += msg.readInt8();
+}
+
+/**
+ * Writes the same message as writeSmallMessage, with the fixed part as a
+ * schema record like the game server does.
+ */
+static void writeSmallRecord(MessageOut &msg, int id)
+{
+    msg.write(schema::BeingEnter(OBJECT_CHARACTER, id, 0, 1200, 800, 2, 1));
+    msg.writeString("Benchmarker");
+    msg.writeInt8(0);
+    msg.writeInt8(3);
+}
+
+static void readSmallRecord(MessageIn &msg)
+{
+    schema::BeingEnter enter;
+    msg.read(enter);
+    for (unsigned i = 0; i < schema::BeingEnter::count; ++i)
+        sink += enter[i];
+    sink += msg.readString().size();
+    sink += msg.readInt8();
+    sink += msg.readInt8();
+}
+
+/** Beings in the large message. */
+static const int LARGE_MESSAGE_ENTRIES = 64;
+
+/**
+ * Writes a message like the movement update of a crowd.
+ */
+static void writeLargeMessage(MessageOut &msg)
+{
+    for (int i = 0; i < LARGE_MESSAGE_ENTRIES; ++i)
+    {
+        msg.writeVarInt(1000 + i);
+        msg.writeInt8(MOVING_DESTINATION);
+        msg.writeInt16(32 * i);
+        msg.writeInt16(16 * i);
+        msg.writeInt8(60);
+    }
+}
+
+static void readLargeMessage(MessageIn &msg)
+{
+    for (int i = 0; i < LARGE_MESSAGE_ENTRIES; ++i)
+    {
+        sink += msg.readVarInt();
+        sink += msg.readInt8();
+        sink += msg.readInt16();
+        sink += msg.readInt16();
+        sink += msg.readInt8();
+    }
+}
+
+/**
+ * Writes the movement update of a crowd as GPMSG_BEINGS_MOVE, with schema
+ * records for each entry.
+ */
+static void writeLargeRecords(MessageOut &msg)
+{
+    msg.reserve(LARGE_MESSAGE_ENTRIES * (schema::BeingMove::size +
+                                         schema::BeingMoveDestination::size));
+    for (int i = 0; i < LARGE_MESSAGE_ENTRIES; ++i)
+    {
+        msg.write(schema::BeingMove(1000 + i, MOVING_DESTINATION));
+        msg.write(schema::BeingMoveDestination(32 * i, 16 * i, 60));
+    }
+}
+
+static void readLargeRecords(MessageIn &msg)
+{
+    schema::BeingMove move;
+    schema::BeingMoveDestination destination;
+    for (int i = 0; i < LARGE_MESSAGE_ENTRIES; ++i)
+    {
+        msg.read(move);
+        msg.read(destination);
+        sink += move[0] + move[1];
+        sink += destination[0] + destination[1] + destination[2];
+    }
+}
+
+static void benchmarkMessages(BenchmarkRunner &runner)
+{
+    runner.run("message/encode/small", BATCH_OPERATIONS, [] {
+        for (unsigned i = 0; i < BATCH_OPERATIONS; ++i)
+        {
+            MessageOut msg(GPMSG_BEING_ENTER);
+            writeSmallMessage(msg, i);
+            sink += msg.getLength();
+        }
+    });
+
+    MessageOut small(GPMSG_BEING_ENTER);
+    writeSmallMessage(small, 1);
+    runner.run("message/decode/small", BATCH_OPERATIONS, [&] {
+        for (unsigned i = 0; i < BATCH_OPERATIONS; ++i)
+        {
+            MessageIn msg(small.getData(), small.getLength());
+            readSmallMessage(msg);
+        }
+    });
+
+    runner.run("message/encode/large", BATCH_OPERATIONS, [] {
+        for (unsigned i = 0; i < BATCH_OPERATIONS; ++i)
+        {
+            MessageOut msg(GPMSG_BEINGS_MOVE_COMPACT);
+            writeLargeMessage(msg);
+            sink += msg.getLength();
+        }
+    });
+
+    MessageOut large(GPMSG_BEINGS_MOVE_COMPACT);
+    writeLargeMessage(large);
+    runner.run("message/decode/large", BATCH_OPERATIONS, [&] {
+        for (unsigned i = 0; i < BATCH_OPERATIONS; ++i)
+        {
+            MessageIn msg(large.getData(), large.getLength());
+            readLargeMessage(msg);
+        }
+    });
+
+    runner.run("message/encode/small-schema", BATCH_OPERATIONS, [] {
+        for (unsigned i = 0; i < BATCH_OPERATIONS; ++i)
+        {
+            MessageOut msg(GPMSG_BEING_ENTER);
+            writeSmallRecord(msg, i);
+            sink += msg.getLength();
+        }
+    });
+
+    MessageOut smallRecord(GPMSG_BEING_ENTER);
+    writeSmallRecord(smallRecord, 1);
+    runner.run("message/decode/small-schema", BATCH_OPERATIONS, [&] {
+        for (unsigned i = 0; i < BATCH_OPERATIONS; ++i)
+        {
+            MessageIn msg(smallRecord.getData(), smallRecord.getLength());
+            readSmallRecord(msg);
+        }
+    });
+
+    runner.run("message/encode/large-schema", BATCH_OPERATIONS, [] {
+        for (unsigned i = 0; i < BATCH_OPERATIONS; ++i)
+        {
+            MessageOut msg(GPMSG_BEINGS_MOVE);
+            writeLargeRecords(msg);
+            sink += msg.getLength();
+        }
+    });
+
+    MessageOut largeRecords(GPMSG_BEINGS_MOVE);
+    writeLargeRecords(largeRecords);
+    runner.run("message/decode/large-schema", BATCH_OPERATIONS, [&] {
+        for (unsigned i = 0; i < BATCH_OPERATIONS; ++i)
+        {
+            MessageIn msg(largeRecords.getData(), largeRecords.getLength());
+            readLargeRecords(msg);
+        }
+    });
+}
+
+static void benchmarkStringFilter(BenchmarkRunner &runner)
+{
+    // A fixed list, so that the results do not depend on the configuration
+    std::ostringstream slangs;
+    for (int i = 0; i < 64; ++i)
+        slangs << (i ? "," : "") << "slang" << i;
+
+    utils::StringFilter filter;
+    filter.loadSlangFilterList(slangs.str());
+
+    const std::string lines[] = {
+        "Hi",
+        "Anyone up for the desert cave?",
+        "I will trade my sword for 200 gold pieces, or something similar",
+        "Does somebody know where the quest giver of the eastern village "
+        "went? I have been looking for him for quite some time now.",
+    };
+    const unsigned lineCount = sizeof(lines) / sizeof(lines[0]);
+
+    runner.run("stringFilter/filterContent", BATCH_OPERATIONS, [&] {
+        for (unsigned i = 0; i < BATCH_OPERATIONS; ++i)
+            sink += filter.filterContent(lines[i % lineCount]);
+    });
+}
+
+static bool compareAttributeIds(const AttributeInfo *a, const AttributeInfo *b)
+{
+    return a->id < b->id;
+}
+
+/** Characters whose attributes are ticked. */
+static const int ATTRIBUTE_BEINGS = 100;
+
+static void benchmarkAttributes(BenchmarkRunner &runner)
+{
+    const std::set<AttributeInfo *> &scope =
+            attributeManager->getAttributeScope(CharacterScope);
+
+    // Sorted by id, so that the same attributes get the same modifiers
+    std::vector<AttributeInfo *> infos;
+    for (AttributeInfo *info : scope)
+        if (!info->modifiers.empty())
+            infos.push_back(info);
+    std::sort(infos.begin(), infos.end(), compareAttributeIds);
+
+    if (infos.empty())
+        return;
+
+    std::vector<Attribute *> attributes;
+    std::vector<unsigned> layers;
+    for (int i = 0; i < ATTRIBUTE_BEINGS; ++i)
+    {
+        for (AttributeInfo *info : infos)
+        {
+            attributes.push_back(new Attribute(info));
+            layers.push_back(info->modifiers.size());
+        }
+    }
+
+    // Every tick each attribute gets a modifier lasting a few ticks, so
+    // that about four of them are active at any time.
+    auto addModifiers = [&] {
+        for (size_t i = 0; i < attributes.size(); ++i)
+        {
+            attributes[i]->add(1 + rand() % 8, 1 + rand() % 10,
+                               rand() % layers[i]);
+        }
+    };
+
+    runner.run("attribute/tick", attributes.size(), [&] {
+        for (Attribute *attribute : attributes)
+            sink += attribute->tick();
+    }, addModifiers);
+
+    for (Attribute *attribute : attributes)
+        delete attribute;
+}
+
+void runCoreBenchmarks(BenchmarkRunner &runner)
+{
+    benchmarkMessages(runner);
+    benchmarkSha256(runner);
+    benchmarkStringFilter(runner);
+    benchmarkAttributes(runner);
+}
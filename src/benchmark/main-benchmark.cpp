@@ -0,0 +1,327 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "benchmark/benchmark.h"
+#include "benchmark/benchmarks.h"
+#include "common/configuration.h"
+#include "common/defines.h"
+#include "common/resourcemanager.h"
+#include "game-server/abilitymanager.h"
+#include "game-server/accountconnection.h"
+#include "game-server/attributemanager.h"
+#include "game-server/emotemanager.h"
+#include "game-server/gamehandler.h"
+#include "game-server/itemmanager.h"
+#include "game-server/mapmanager.h"
+#include "game-server/monstermanager.h"
+#include "game-server/postman.h"
+#include "game-server/sendscheduler.h"
+#include "game-server/settingsmanager.h"
+#include "game-server/statusmanager.h"
+#include "net/bandwidth.h"
+#include "scripting/scriptmanager.h"
+#include "utils/logger.h"
+#include "utils/mathutils.h"
+#include "utils/processorutils.h"
+#include "utils/stringfilter.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <getopt.h>
+#include <iostream>
+#include <physfs.h>
+#include <sstream>
+#include <enet/enet.h>
+
+using utils::Logger;
+
+#define DEFAULT_LOG_FILE                    "manaserv-benchmark.log"
+#define DEFAULT_MAIN_SCRIPT_FILE            "scripts/main.lua"
+#define DEFAULT_CROWD_SIZES                 "50,200"
+
+/*
+ * The global objects of the game server, which the benchmarked code uses.
+ */
+utils::StringFilter *stringFilter;
+AbilityManager *abilityManager = new AbilityManager();
+AttributeManager *attributeManager = new AttributeManager();
+ItemManager *itemManager = new ItemManager();
+MonsterManager *monsterManager = new MonsterManager();
+EmoteManager *emoteManager = new EmoteManager();
+SettingsManager *settingsManager = new SettingsManager(DEFAULT_SETTINGS_FILE);
+GameHandler *gameHandler;
+AccountConnection *accountHandler;
+PostMan *postMan;
+BandwidthMonitor *gBandwidth;
+
+/**
+ * Loads the game data like the game server does. The maps are loaded but
+ * not activated, and no account server is involved.
+ */
+static void initializeGame()
+{
+    PHYSFS_init("");
+
+    stringFilter = new utils::StringFilter;
+
+    ResourceManager::initialize();
+    ScriptManager::initialize();   // Depends on ResourceManager
+
+    settingsManager->initialize();
+
+    SendScheduler::initialize();
+
+    ScriptManager::loadMainScript(
+            Configuration::getValue("script_mainFile",
+                                    DEFAULT_MAIN_SCRIPT_FILE));
+
+    gameHandler = new GameHandler;
+    accountHandler = new AccountConnection;
+    postMan = new PostMan;
+    gBandwidth = new BandwidthMonitor;
+
+    if (enet_initialize() != 0)
+    {
+        LOG_FATAL("An error occurred while initializing ENet");
+        exit(EXIT_NET_EXCEPTION);
+    }
+
+    utils::math::init();
+    utils::processor::init();
+}
+
+static void deinitializeGame()
+{
+    enet_deinitialize();
+
+    delete gameHandler; gameHandler = 0;
+    delete accountHandler; accountHandler = 0;
+    delete postMan; postMan = 0;
+    delete gBandwidth; gBandwidth = 0;
+
+    delete stringFilter; stringFilter = 0;
+    delete monsterManager; monsterManager = 0;
+    delete abilityManager; abilityManager = 0;
+    delete itemManager; itemManager = 0;
+    delete emoteManager; emoteManager = 0;
+    delete settingsManager; settingsManager = 0;
+    MapManager::deinitialize();
+    StatusManager::deinitialize();
+    ScriptManager::deinitialize();
+
+    PHYSFS_deinit();
+}
+
+/**
+ * Show command line arguments.
+ */
+static void printHelp()
+{
+    std::cout << "manaserv-benchmark" << std::endl << std::endl
+              << "Options: " << std::endl
+              << "  -h --help          : Display this help" << std::endl
+              << "     --config <path> : Set the config path to use."
+              << " (Default: ./manaserv.xml)" << std::endl
+              << "  -v --verbosity <n> : Set the verbosity level of the log"
+              << std::endl
+              << "  -b --batches <n>   : Measured batches per benchmark."
+              << " (Default: 100)" << std::endl
+              << "  -f --filter <text> : Only run the benchmarks whose name"
+              << " contains the text" << std::endl
+              << "  -o --output <path> : Write the JSON results to a file"
+              << " instead of the standard output" << std::endl
+              << "  -s --seed <n>      : Seed of the random numbers."
+              << " (Default: 1)" << std::endl
+              << "     --map <id>      : Map the crowds are put on."
+              << " (Default: the first map)" << std::endl
+              << "     --crowds <list> : Sizes of the crowds. (Default: "
+              << DEFAULT_CROWD_SIZES << ")" << std::endl
+              << "     --port <n>      : Local port the crowds connect to."
+              << std::endl;
+    exit(EXIT_NORMAL);
+}
+
+struct CommandLineOptions
+{
+    CommandLineOptions():
+        verbosity(Logger::Warn),
+        batches(100),
+        seed(1),
+        mapId(0),
+        crowds(DEFAULT_CROWD_SIZES),
+        port(DEFAULT_SERVER_PORT + 10)
+    {}
+
+    std::string configPath;
+    Logger::Level verbosity;
+    unsigned batches;
+    std::string filter;
+    std::string output;
+    unsigned seed;
+    int mapId;
+    std::string crowds;
+    int port;
+};
+
+/**
+ * Parse the command line arguments
+ */
+static void parseOptions(int argc, char *argv[], CommandLineOptions &options)
+{
+    const char *optString = "hv:b:f:o:s:";
+
+    const struct option longOptions[] =
+    {
+        { "help",       no_argument,       0, 'h' },
+        { "config",     required_argument, 0, 'c' },
+        { "verbosity",  required_argument, 0, 'v' },
+        { "batches",    required_argument, 0, 'b' },
+        { "filter",     required_argument, 0, 'f' },
+        { "output",     required_argument, 0, 'o' },
+        { "seed",       required_argument, 0, 's' },
+        { "map",        required_argument, 0, 'm' },
+        { "crowds",     required_argument, 0, 'w' },
+        { "port",       required_argument, 0, 'p' },
+        { 0, 0, 0, 0 }
+    };
+
+    while (optind < argc)
+    {
+        int result = getopt_long(argc, argv, optString, longOptions, nullptr);
+
+        if (result == -1)
+            break;
+
+        switch (result)
+        {
+            default: // Unknown option.
+            case 'h':
+                // Print help.
+                printHelp();
+                break;
+            case 'c':
+                // Change config filename and path.
+                options.configPath = optarg;
+                break;
+            case 'v':
+                options.verbosity = static_cast<Logger::Level>(atoi(optarg));
+                break;
+            case 'b':
+                options.batches = std::max(1, atoi(optarg));
+                break;
+            case 'f':
+                options.filter = optarg;
+                break;
+            case 'o':
+                options.output = optarg;
+                break;
+            case 's':
+                options.seed = atoi(optarg);
+                break;
+            case 'm':
+                options.mapId = atoi(optarg);
+                break;
+            case 'w':
+                options.crowds = optarg;
+                break;
+            case 'p':
+                options.port = atoi(optarg);
+                break;
+        }
+    }
+}
+
+static std::vector<int> parseCrowdSizes(const std::string &list)
+{
+    std::vector<int> sizes;
+    std::istringstream entries(list);
+    std::string entry;
+    while (std::getline(entries, entry, ','))
+    {
+        if (const int size = atoi(entry.c_str()))
+            sizes.push_back(size);
+    }
+    return sizes;
+}
+
+/**
+ * Main function, runs the benchmarks and writes their results.
+ */
+int main(int argc, char *argv[])
+{
+    CommandLineOptions options;
+    parseOptions(argc, argv, options);
+
+    if (!Configuration::initialize(options.configPath))
+    {
+        LOG_FATAL("Refusing to run without configuration!");
+        exit(EXIT_CONFIG_NOT_FOUND);
+    }
+
+    // The results go to the standard output, the log only to its file
+    Logger::initialize(Configuration::getValue("log_benchmarkFile",
+                                               DEFAULT_LOG_FILE));
+    Logger::setTeeMode(false);
+    Logger::setVerbosity(options.verbosity);
+
+    initializeGame();
+
+    if (!options.mapId && !MapManager::getMaps().empty())
+        options.mapId = MapManager::getMaps().begin()->first;
+
+    BenchmarkRunner runner(options.batches, options.filter);
+    runner.setContext("batches", options.batches);
+    runner.setContext("seed", options.seed);
+    runner.setContext("crowdMap", options.mapId);
+    runner.setContext("crowds", options.crowds);
+    runner.setContext("visualRange",
+                      Configuration::getValue("game_visualRange", 448));
+
+    // Every benchmark starts from the same random numbers
+    std::srand(options.seed);
+    runCoreBenchmarks(runner);
+    std::srand(options.seed);
+    runWorldBenchmarks(runner, options.mapId,
+                       parseCrowdSizes(options.crowds), options.port);
+
+    runner.writeSummary(std::cerr);
+
+    if (options.output.empty())
+    {
+        runner.writeJson(std::cout);
+    }
+    else
+    {
+        std::ofstream file(options.output.c_str());
+        runner.writeJson(file);
+        if (!file)
+        {
+            LOG_ERROR("Could not write the results to " << options.output);
+            return EXIT_FAILURE;
+        }
+    }
+
+    deinitializeGame();
+    Configuration::deinitialize();
+    Logger::deinitialize();
+
+    return EXIT_NORMAL;
+}
@@ -0,0 +1,416 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "benchmark/benchmarks.h"
+
+#include "benchmark/benchmark.h"
+#include "common/configuration.h"
+#include "common/defines.h"
+#include "common/manaserv_protocol.h"
+#include "game-server/actorcomponent.h"
+#include "game-server/being.h"
+#include "game-server/charactercomponent.h"
+#include "game-server/entity.h"
+#include "game-server/gamehandler.h"
+#include "game-server/map.h"
+#include "game-server/mapcomposite.h"
+#include "game-server/mapmanager.h"
+#include "game-server/state.h"
+#include "net/messagein.h"
+#include "net/messageout.h"
+#include "utils/logger.h"
+
+#include <cstdlib>
+#include <enet/enet.h>
+#include <sstream>
+
+#ifdef ENET_VERSION_CREATE
+#define ENET_CUTOFF ENET_VERSION_CREATE(1,3,0)
+#else
+#define ENET_CUTOFF 0xFFFFFFFF
+#endif
+
+using namespace ManaServ;
+
+/** Routes measured on each map. */
+static const int PATH_ROUTES = 64;
+
+/** Tiles between the start and the end of a route at most. */
+static const int PATH_RANGE = 16;
+
+/** Pixels a character of a crowd walks at most at once. */
+static const int CROWD_WALK_RANGE = 160;
+
+/** Keeps the compiler from optimizing the measured code away. */
+static unsigned long sink;
+
+/**
+ * Picks a random walkable tile inside the given area of tiles.
+ *
+ * @return whether a walkable tile was found.
+ */
+static bool randomWalkableTile(const Map *map, const Rectangle &area,
+                               Point &tile)
+{
+    for (int attempt = 0; attempt < 100; ++attempt)
+    {
+        const int x = area.x + rand() % area.w;
+        const int y = area.y + rand() % area.h;
+        if (x >= 0 && y >= 0 && x < map->getWidth() &&
+            y < map->getHeight() && map->getWalk(x, y))
+        {
+            tile = Point(x, y);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void benchmarkFindPath(BenchmarkRunner &runner)
+{
+    const MapManager::Maps &maps = MapManager::getMaps();
+    for (MapManager::Maps::const_iterator i = maps.begin(),
+         i_end = maps.end(); i != i_end; ++i)
+    {
+        const Map *map = i->second->getMap();
+        const std::string name = "findPath/" + i->second->getName();
+        if (!map || !runner.isSelected(name))
+            continue;
+
+        const Rectangle wholeMap = { 0, 0, map->getWidth(), map->getHeight() };
+        std::vector<Point> starts, ends;
+        for (int route = 0; route < PATH_ROUTES; ++route)
+        {
+            Point start, end;
+            if (!randomWalkableTile(map, wholeMap, start))
+                break;
+
+            const Rectangle around = { start.x - PATH_RANGE,
+                                       start.y - PATH_RANGE,
+                                       PATH_RANGE * 2 + 1,
+                                       PATH_RANGE * 2 + 1 };
+            if (!randomWalkableTile(map, around, end))
+                continue;
+
+            starts.push_back(start);
+            ends.push_back(end);
+        }
+
+        runner.run(name, starts.size(), [&] {
+            for (size_t route = 0; route < starts.size(); ++route)
+            {
+                sink += map->findPath(starts[route].x, starts[route].y,
+                                      ends[route].x, ends[route].y,
+                                      Map::BLOCKMASK_WALL).size();
+            }
+        });
+    }
+}
+
+/**
+ * A connection of this process to itself. The characters of the crowds
+ * need a connected client to be informed, their messages are queued on it
+ * and never sent.
+ */
+struct Loopback
+{
+    Loopback(): server(nullptr), client(nullptr), peer(nullptr) {}
+
+    ~Loopback()
+    {
+        if (client)
+            enet_host_destroy(client);
+        if (server)
+            enet_host_destroy(server);
+    }
+
+    bool connect(int port)
+    {
+        ENetAddress address;
+        enet_address_set_host(&address, "127.0.0.1");
+        address.port = port;
+
+#if defined(ENET_VERSION) && ENET_VERSION >= ENET_CUTOFF
+        server = enet_host_create(&address, 1, 0, 0, 0);
+        client = enet_host_create(nullptr, 1, 0, 0, 0);
+#else
+        server = enet_host_create(&address, 1, 0, 0);
+        client = enet_host_create(nullptr, 1, 0, 0);
+#endif
+        if (!server || !client)
+            return false;
+
+#if defined(ENET_VERSION) && ENET_VERSION >= ENET_CUTOFF
+        enet_host_connect(client, &address, 1, 0);
+#else
+        enet_host_connect(client, &address, 1);
+#endif
+
+        ENetEvent event;
+        for (int attempt = 0; attempt < 100 && !peer; ++attempt)
+        {
+            enet_host_service(client, &event, 5);
+            if (enet_host_service(server, &event, 5) > 0 &&
+                event.type == ENET_EVENT_TYPE_CONNECT)
+            {
+                peer = event.peer;
+            }
+        }
+        return peer;
+    }
+
+    ENetHost *server;
+    ENetHost *client;
+    ENetPeer *peer;     /**< The server side of the connection. */
+};
+
+/**
+ * Characters walking around in an area of a map.
+ */
+struct Crowd
+{
+    MapComposite *map;
+    Rectangle area;                     /**< In pixels. */
+    std::vector<Entity *> characters;
+    std::vector<GameClient *> clients;
+};
+
+/**
+ * Creates a character the way the account server describes it when it
+ * enters the game server.
+ */
+static Entity *createCharacter(int id, MapComposite *map, const Point &position)
+{
+    std::ostringstream name;
+    name << "Crowd" << id;
+
+    MessageOut data(AGMSG_PLAYER_ENTER);
+    data.writeInt32(id);                // database id
+    data.writeString(name.str());
+    data.writeInt8(AL_PLAYER);
+    data.writeInt8(id % 2);             // gender
+    data.writeInt8(0);                  // hair style
+    data.writeInt8(0);                  // hair color
+    data.writeInt16(0);                 // attribute points
+    data.writeInt16(0);                 // correction points
+    data.writeInt16(1);                 // attributes
+    data.writeInt16(ATTR_MOVE_SPEED_TPS);
+    data.writeDouble(6);
+    data.writeInt16(0);                 // status effects
+    data.writeInt16(map->getID());
+    data.writeInt16(position.x);
+    data.writeInt16(position.y);
+    data.writeInt16(0);                 // kill counts
+    data.writeInt16(0);                 // abilities
+    data.writeInt16(0);                 // quests
+
+    MessageIn msg(data.getData(), data.getLength());
+
+    Entity *character = new Entity(OBJECT_CHARACTER);
+    character->addComponent(new ActorComponent(*character));
+    character->addComponent(new BeingComponent(*character));
+    character->addComponent(new CharacterComponent(*character, msg));
+    return character;
+}
+
+/**
+ * Puts characters on random walkable spots of an area twice as large as
+ * the visual range, so that most of them see each other.
+ */
+static bool createCrowd(Crowd &crowd, MapComposite *map, int size,
+                        ENetPeer *peer)
+{
+    const Map *tiles = map->getMap();
+    const int tileWidth = tiles->getTileWidth();
+    const int tileHeight = tiles->getTileHeight();
+    const int visualRange = Configuration::getValue("game_visualRange", 448);
+
+    crowd.map = map;
+    crowd.area.w = std::min(visualRange * 2, tiles->getWidth() * tileWidth);
+    crowd.area.h = std::min(visualRange * 2, tiles->getHeight() * tileHeight);
+    crowd.area.x = (tiles->getWidth() * tileWidth - crowd.area.w) / 2;
+    crowd.area.y = (tiles->getHeight() * tileHeight - crowd.area.h) / 2;
+
+    const Rectangle tileArea = { crowd.area.x / tileWidth,
+                                 crowd.area.y / tileHeight,
+                                 crowd.area.w / tileWidth,
+                                 crowd.area.h / tileHeight };
+
+    for (int i = 0; i < size; ++i)
+    {
+        Point tile;
+        if (!randomWalkableTile(tiles, tileArea, tile))
+            return false;
+
+        const Point position(tile.x * tileWidth + tileWidth / 2,
+                             tile.y * tileHeight + tileHeight / 2);
+        Entity *character = createCharacter(i + 1, map, position);
+
+        GameClient *client = new GameClient(peer);
+        client->status = CLIENT_CONNECTED;
+        client->character = character;
+        character->getComponent<CharacterComponent>()->setClient(client);
+
+        if (!GameState::insert(character))
+        {
+            delete character;
+            delete client;
+            return false;
+        }
+
+        crowd.characters.push_back(character);
+        crowd.clients.push_back(client);
+    }
+    return true;
+}
+
+static void destroyCrowd(Crowd &crowd)
+{
+    // The others are told about each removal, so delete only afterwards
+    for (Entity *character : crowd.characters)
+        GameState::remove(character);
+
+    for (size_t i = 0; i < crowd.characters.size(); ++i)
+    {
+        delete crowd.characters[i];
+        delete crowd.clients[i];
+    }
+    crowd.characters.clear();
+    crowd.clients.clear();
+}
+
+/**
+ * Sends the characters that arrived somewhere else and moves everything
+ * on the map by one tick.
+ */
+static void walkCrowd(Crowd &crowd)
+{
+    for (Entity *character : crowd.characters)
+    {
+        auto *being = character->getComponent<BeingComponent>();
+        const Point &position =
+                character->getComponent<ActorComponent>()->getPosition();
+        if (being->getDestination() != position)
+            continue;
+
+        const int dx = rand() % (CROWD_WALK_RANGE * 2 + 1) - CROWD_WALK_RANGE;
+        const int dy = rand() % (CROWD_WALK_RANGE * 2 + 1) - CROWD_WALK_RANGE;
+        const Point destination(
+                std::max(crowd.area.x, std::min(crowd.area.x + crowd.area.w - 1,
+                                                position.x + dx)),
+                std::max(crowd.area.y, std::min(crowd.area.y + crowd.area.h - 1,
+                                                position.y + dy)));
+        being->setDestination(*character, destination);
+    }
+
+    crowd.map->update();
+}
+
+static void benchmarkCrowd(BenchmarkRunner &runner, Crowd &crowd)
+{
+    std::ostringstream suffix;
+    suffix << "/crowd=" << crowd.characters.size();
+
+    MapComposite *map = crowd.map;
+    const int radius = Configuration::getValue("game_visualRange", 448);
+    const unsigned size = crowd.characters.size();
+    const auto walk = [&] { walkCrowd(crowd); };
+
+    runner.run("zones/aroundPoint" + suffix.str(), size, [&] {
+        for (Entity *character : crowd.characters)
+        {
+            const Point &position =
+                    character->getComponent<ActorComponent>()->getPosition();
+            for (ActorIterator it(map->getAroundPointIterator(position,
+                                                              radius));
+                 it; ++it)
+            {
+                ++sink;
+            }
+        }
+    }, walk);
+
+    runner.run("zones/aroundActor" + suffix.str(), size, [&] {
+        for (Entity *character : crowd.characters)
+        {
+            for (ActorIterator it(map->getAroundActorIterator(character,
+                                                              radius));
+                 it; ++it)
+            {
+                ++sink;
+            }
+        }
+    }, walk);
+
+    runner.run("zones/aroundBeing" + suffix.str(), size, [&] {
+        for (Entity *character : crowd.characters)
+        {
+            for (BeingIterator it(map->getAroundBeingIterator(character,
+                                                              radius));
+                 it; ++it)
+            {
+                ++sink;
+            }
+        }
+    }, walk);
+
+    // One operation is informing the whole crowd of one tick
+    int tick = GameState::getCurrentTick();
+    runner.run("informPlayers" + suffix.str(), 1, [&] {
+        GameState::informPlayers(map, ++tick);
+    }, walk);
+}
+
+void runWorldBenchmarks(BenchmarkRunner &runner, int mapId,
+                        const std::vector<int> &crowdSizes, int port)
+{
+    benchmarkFindPath(runner);
+
+    if (!runner.isSelected("zones/") && !runner.isSelected("informPlayers"))
+        return;
+
+    MapComposite *map = MapManager::getMap(mapId);
+    if (!map || !MapManager::activateMap(mapId))
+    {
+        LOG_ERROR("Benchmarks: cannot activate map " << mapId
+                  << ", skipping the crowd benchmarks.");
+        return;
+    }
+
+    Loopback loopback;
+    if (!loopback.connect(port))
+    {
+        LOG_ERROR("Benchmarks: cannot connect to port " << port
+                  << ", skipping the crowd benchmarks.");
+        return;
+    }
+
+    for (int size : crowdSizes)
+    {
+        Crowd crowd;
+        if (createCrowd(crowd, map, size, loopback.peer))
+            benchmarkCrowd(runner, crowd);
+        else
+            LOG_ERROR("Benchmarks: no room for a crowd of " << size
+                      << " on map " << mapId << '.');
+        destroyCrowd(crowd);
+    }
+}
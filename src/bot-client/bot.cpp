@@ -0,0 +1,585 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "bot-client/bot.h"
+
+#include "common/manaserv_protocol.h"
+#include "net/messagein.h"
+#include "net/messageout.h"
+#include "net/messageschema.h"
+#include "utils/logger.h"
+#include "utils/sha256.h"
+#include "utils/tokendispenser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iterator>
+#include <sstream>
+
+using namespace ManaServ;
+
+/** Milliseconds to wait before starting over after a failure. */
+static const unsigned long RETRY_DELAY = 5000;
+
+/** Milliseconds to wait when the account server asked to slow down. */
+static const unsigned long LOGIN_RETRY_DELAY = 1100;
+
+/** Milliseconds a dead bot waits before respawning. */
+static const unsigned long RESPAWN_DELAY = 2000;
+
+/** Milliseconds after which a said text is not waited for anymore. */
+static const unsigned long SAY_TIMEOUT = 10000;
+
+/** Attempts before a bot gives up logging in. */
+static const int MAX_LOGIN_FAILURES = 5;
+
+static std::string makeName(const std::string &prefix, unsigned index)
+{
+    std::ostringstream name;
+    name << prefix << index;
+    return name.str();
+}
+
+Bot::Bot(unsigned index, BotNetwork &network,
+         const BotBehaviour &behaviour, BotStatistics &statistics):
+    mIndex(index),
+    mName(makeName(behaviour.namePrefix, index)),
+    mNetwork(network),
+    mBehaviour(behaviour),
+    mStatistics(statistics),
+    mState(STATE_IDLE),
+    mFailures(0),
+    mLoginStart(0),
+    mRetryTime(0),
+    mNextAction(0),
+    mRespawnTime(0),
+    mBeingId(0),
+    mSaid(0),
+    mPendingSayTime(0)
+{
+    for (int i = 0; i < BOT_SERVER_COUNT; ++i)
+    {
+        mLinks[i].bot = this;
+        mLinks[i].server = (BotServer) i;
+    }
+}
+
+Bot::~Bot()
+{
+    for (int i = 0; i < BOT_SERVER_COUNT; ++i)
+        mNetwork.disconnect(mLinks[i]);
+}
+
+unsigned long Bot::now()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(
+            steady_clock::now().time_since_epoch()).count();
+}
+
+void Bot::start()
+{
+    for (int i = 0; i < BOT_SERVER_COUNT; ++i)
+        mNetwork.disconnect(mLinks[i]);
+
+    mRetryTime = 0;
+    mRespawnTime = 0;
+    mBeingId = 0;
+    mMonsters.clear();
+    mPendingSay.clear();
+    mLoginStart = now();
+
+    if (!mNetwork.connect(mLinks[BOT_ACCOUNT], mBehaviour.accountHost,
+                          mBehaviour.accountPort))
+    {
+        fail("could not connect to the account server", 0);
+        return;
+    }
+    mState = STATE_CONNECTING;
+}
+
+void Bot::update()
+{
+    const unsigned long time = now();
+
+    if (mRetryTime && time >= mRetryTime)
+    {
+        start();
+        return;
+    }
+
+    if (mState != STATE_IN_GAME)
+        return;
+
+    if (mRespawnTime)
+    {
+        if (time >= mRespawnTime)
+        {
+            mRespawnTime = 0;
+            mNetwork.send(mLinks[BOT_GAME], MessageOut(PGMSG_RESPAWN));
+        }
+        return;
+    }
+
+    if (time >= mNextAction)
+    {
+        act();
+
+        // Spread the actions so that the bots do not act in lockstep
+        const int interval = std::max(1, mBehaviour.actionInterval);
+        mNextAction = time + interval / 2 + rand() % interval;
+    }
+}
+
+void Bot::connected(BotServer server)
+{
+    switch (server)
+    {
+    case BOT_ACCOUNT:
+    {
+        // Registering first avoids the login rate limit of the account
+        // server for new accounts, existing ones fall back to logging in.
+        mState = STATE_REGISTERING;
+
+        MessageOut msg(PAMSG_REGISTER);
+        msg.writeInt32(PROTOCOL_VERSION);
+        msg.writeString(mName);
+        msg.writeString(mBehaviour.password);
+        msg.writeString(mName + "@bots.invalid");
+        msg.writeString(std::string());
+        mNetwork.send(mLinks[BOT_ACCOUNT], msg);
+        break;
+    }
+    case BOT_GAME:
+    case BOT_CHAT:
+    {
+        MessageOut msg(server == BOT_GAME ? PGMSG_CONNECT : PCMSG_CONNECT);
+        msg.writeString(mToken, MAGIC_TOKEN_LENGTH);
+        if (mBehaviour.capabilities)
+            msg.writeInt16(mBehaviour.capabilities);
+        mNetwork.send(mLinks[server], msg);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void Bot::disconnected(BotServer server)
+{
+    mLinks[server].peer = 0;
+
+    if (server == BOT_CHAT)
+        return;
+
+    if (server == BOT_GAME && mState == STATE_IN_GAME)
+    {
+        ++mStatistics.disconnects;
+        LOG_INFO(mName << ": lost the connection to the game server.");
+        retry(RETRY_DELAY);
+        return;
+    }
+
+    if (mState != STATE_FAILED && !mRetryTime)
+        fail("lost the connection", 0);
+}
+
+void Bot::processMessage(BotServer server, MessageIn &msg)
+{
+    switch (msg.getId())
+    {
+    case APMSG_REGISTER_RESPONSE:
+        handleRegister(msg);
+        break;
+    case APMSG_LOGIN_RNDTRGR_RESPONSE:
+        handleLoginRandTrigger(msg);
+        break;
+    case APMSG_LOGIN_RESPONSE:
+        handleLogin(msg);
+        break;
+    case APMSG_CHAR_CREATE_RESPONSE:
+        handleCharacterCreate(msg);
+        break;
+    case APMSG_CHAR_SELECT_RESPONSE:
+        handleCharacterSelect(msg);
+        break;
+    case GPMSG_CONNECT_RESPONSE:
+        handleGameConnect(msg);
+        break;
+    case CPMSG_CONNECT_RESPONSE:
+        if (msg.readInt8() != ERRMSG_OK)
+            mNetwork.disconnect(mLinks[BOT_CHAT]);
+        break;
+    default:
+        if (server == BOT_GAME)
+            handleGameMessage(msg);
+        break;
+    }
+}
+
+void Bot::requestLogin()
+{
+    mState = STATE_LOGGING_IN;
+
+    MessageOut msg(PAMSG_LOGIN_RNDTRGR);
+    msg.writeString(mName);
+    mNetwork.send(mLinks[BOT_ACCOUNT], msg);
+}
+
+void Bot::handleRegister(MessageIn &msg)
+{
+    const int error = msg.readInt8();
+    if (error == REGISTER_EXISTS_USERNAME)
+    {
+        requestLogin();
+        return;
+    }
+    if (error != ERRMSG_OK)
+    {
+        fail("registration failed", error);
+        return;
+    }
+
+    ++mStatistics.registrations;
+    createCharacter();
+}
+
+void Bot::handleLoginRandTrigger(MessageIn &msg)
+{
+    const std::string salt = msg.readString();
+
+    MessageOut login(PAMSG_LOGIN);
+    login.writeInt32(PROTOCOL_VERSION);
+    login.writeString(mName);
+    login.writeString(sha256(sha256(mBehaviour.password) + salt));
+    mNetwork.send(mLinks[BOT_ACCOUNT], login);
+}
+
+void Bot::handleLogin(MessageIn &msg)
+{
+    const int error = msg.readInt8();
+    if (error == LOGIN_INVALID_TIME)
+    {
+        // Only one login per second is accepted from an address
+        mNetwork.disconnect(mLinks[BOT_ACCOUNT]);
+        retry(LOGIN_RETRY_DELAY + rand() % LOGIN_RETRY_DELAY);
+        return;
+    }
+    if (error != ERRMSG_OK)
+    {
+        fail("login failed", error);
+        return;
+    }
+
+    msg.readString();   // update host
+    msg.readString();   // client data url
+    msg.readInt8();     // character slots
+
+    // Play the first character of the account
+    if (msg.getUnreadLength() > 0)
+        selectCharacter(msg.readInt8());
+    else
+        createCharacter();
+}
+
+void Bot::createCharacter()
+{
+    mState = STATE_CREATING;
+
+    MessageOut msg(PAMSG_CHAR_CREATE);
+    msg.writeString(mName);
+    msg.writeInt8(0);           // hair style
+    msg.writeInt8(0);           // hair color
+    msg.writeInt8(mIndex % 2);  // gender
+    msg.writeInt8(1);           // slot
+    for (std::vector<int>::const_iterator i = mBehaviour.attributes.begin(),
+         i_end = mBehaviour.attributes.end(); i != i_end; ++i)
+    {
+        msg.writeInt16(*i);
+    }
+    mNetwork.send(mLinks[BOT_ACCOUNT], msg);
+}
+
+void Bot::handleCharacterCreate(MessageIn &msg)
+{
+    const int error = msg.readInt8();
+    if (error != ERRMSG_OK)
+    {
+        fail("character creation failed", error);
+        return;
+    }
+
+    selectCharacter(msg.readInt8());
+}
+
+void Bot::selectCharacter(int slot)
+{
+    mState = STATE_SELECTING;
+
+    MessageOut msg(PAMSG_CHAR_SELECT);
+    msg.writeInt8(slot);
+    mNetwork.send(mLinks[BOT_ACCOUNT], msg);
+}
+
+void Bot::handleCharacterSelect(MessageIn &msg)
+{
+    const int error = msg.readInt8();
+    if (error != ERRMSG_OK)
+    {
+        fail("character selection failed", error);
+        return;
+    }
+
+    mToken = msg.readString(MAGIC_TOKEN_LENGTH);
+    const std::string gameAddress = msg.readString();
+    const int gamePort = msg.readInt16();
+    const std::string chatAddress = msg.readString();
+    const int chatPort = msg.readInt16();
+
+    mNetwork.disconnect(mLinks[BOT_ACCOUNT]);
+    connectGame(gameAddress, gamePort);
+
+    if (mBehaviour.connectChat)
+        mNetwork.connect(mLinks[BOT_CHAT], chatAddress, chatPort);
+}
+
+void Bot::connectGame(const std::string &address, int port)
+{
+    mState = STATE_ENTERING;
+
+    if (!mNetwork.connect(mLinks[BOT_GAME], address, port))
+        fail("could not connect to the game server", 0);
+}
+
+void Bot::handleGameConnect(MessageIn &msg)
+{
+    const int error = msg.readInt8();
+    if (error != ERRMSG_OK)
+    {
+        fail("game server refused the connection", error);
+        return;
+    }
+
+    // A server change does not count as another login
+    if (mLoginStart)
+    {
+        ++mStatistics.logins;
+        mStatistics.loginLatency.record(now() - mLoginStart);
+        mLoginStart = 0;
+    }
+
+    mFailures = 0;
+    mState = STATE_IN_GAME;
+    mNextAction = now() + rand() % std::max(1, mBehaviour.actionInterval);
+}
+
+void Bot::handleGameMessage(MessageIn &msg)
+{
+    switch (msg.getId())
+    {
+    case GPMSG_PLAYER_MAP_CHANGE:
+    {
+        msg.readString();
+        const int x = msg.readInt16();
+        const int y = msg.readInt16();
+        mPosition = Point(x, y);
+        mMonsters.clear();
+        break;
+    }
+    case GPMSG_PLAYER_SERVER_CHANGE:
+    {
+        mToken = msg.readString(MAGIC_TOKEN_LENGTH);
+        const std::string address = msg.readString();
+        const int port = msg.readInt16();
+
+        mNetwork.disconnect(mLinks[BOT_GAME]);
+        connectGame(address, port);
+        break;
+    }
+    case GPMSG_BEING_ENTER:
+    {
+        const int type = msg.readInt8();
+        const int id = msg.readInt16();
+        const int action = msg.readInt8();
+        const int x = msg.readInt16();
+        const int y = msg.readInt16();
+        if (type == OBJECT_MONSTER && action != DEAD)
+            mMonsters[id] = Point(x, y);
+        break;
+    }
+    case GPMSG_BEING_LEAVE:
+        mMonsters.erase(msg.readInt16());
+        break;
+    case GPMSG_BEING_ACTION_CHANGE:
+    {
+        const int id = msg.readInt16();
+        const int action = msg.readInt8();
+        if (action != DEAD)
+            break;
+
+        if (mBeingId && id == mBeingId)
+            mRespawnTime = now() + RESPAWN_DELAY;
+        else
+            mMonsters.erase(id);
+        break;
+    }
+    case GPMSG_SAY:
+    {
+        const int id = msg.readInt16();
+        const std::string text = msg.readString();
+        if (!mPendingSay.empty() && text == mPendingSay)
+        {
+            mBeingId = id;
+            mStatistics.responseLatency.record(now() - mPendingSayTime);
+            mPendingSay.clear();
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void Bot::retry(unsigned long delay)
+{
+    mState = STATE_IDLE;
+    mRetryTime = now() + delay;
+}
+
+void Bot::fail(const char *reason, int error)
+{
+    LOG_WARN(mName << ": " << reason << " (error " << error << ").");
+
+    for (int i = 0; i < BOT_SERVER_COUNT; ++i)
+        mNetwork.disconnect(mLinks[i]);
+
+    if (++mFailures >= MAX_LOGIN_FAILURES)
+    {
+        ++mStatistics.failures;
+        mState = STATE_FAILED;
+        mRetryTime = 0;
+        return;
+    }
+
+    retry(RETRY_DELAY);
+}
+
+void Bot::act()
+{
+    int total = 0;
+    for (int i = 0; i < ACTION_COUNT; ++i)
+        total += mBehaviour.weights[i];
+    if (total <= 0)
+        return;
+
+    int pick = rand() % total;
+    int action = 0;
+    while (pick >= mBehaviour.weights[action])
+        pick -= mBehaviour.weights[action++];
+
+    switch (action)
+    {
+    case ACTION_WALK:
+    {
+        const int radius = std::max(1, mBehaviour.walkRadius);
+        walk(Point(mPosition.x + rand() % (2 * radius + 1) - radius,
+                   mPosition.y + rand() % (2 * radius + 1) - radius));
+        break;
+    }
+    case ACTION_FIGHT:
+        fight();
+        break;
+    case ACTION_CHAT:
+        chat();
+        break;
+    case ACTION_WARP:
+        warp();
+        break;
+    }
+}
+
+void Bot::walk(const Point &destination)
+{
+    const Point target(std::max(0, destination.x),
+                       std::max(0, destination.y));
+
+    MessageOut msg(PGMSG_WALK);
+    msg.write(schema::Walk(target.x, target.y));
+    mNetwork.send(mLinks[BOT_GAME], msg);
+
+    // Assume the destination is reached, the server corrects it otherwise
+    mPosition = target;
+}
+
+void Bot::fight()
+{
+    if (mMonsters.empty())
+    {
+        chat();
+        return;
+    }
+
+    // Go to a random monster in sight and hit it
+    std::map<int, Point>::const_iterator it = mMonsters.begin();
+    std::advance(it, rand() % mMonsters.size());
+    walk(it->second);
+
+    MessageOut msg(PGMSG_USE_ABILITY_ON_BEING);
+    msg.writeInt8(mBehaviour.attackAbility);
+    msg.writeInt16(it->first);
+    mNetwork.send(mLinks[BOT_GAME], msg);
+}
+
+void Bot::chat()
+{
+    // Only one message is timed at once, the others are just load
+    std::ostringstream text;
+    text << "Hello from " << mName << " #" << ++mSaid;
+
+    const unsigned long time = now();
+    if (mPendingSay.empty() || time - mPendingSayTime > SAY_TIMEOUT)
+    {
+        mPendingSay = text.str();
+        mPendingSayTime = time;
+    }
+
+    MessageOut msg(PGMSG_SAY);
+    msg.writeString(text.str());
+    mNetwork.send(mLinks[BOT_GAME], msg);
+}
+
+void Bot::warp()
+{
+    if (mBehaviour.warpMaps.empty())
+    {
+        walk(mPosition);
+        return;
+    }
+
+    const int map = mBehaviour.warpMaps[rand() % mBehaviour.warpMaps.size()];
+    std::ostringstream command;
+    command << "@warp " << map << ' ' << mPosition.x << ' ' << mPosition.y;
+
+    MessageOut msg(PGMSG_SAY);
+    msg.writeString(command.str());
+    mNetwork.send(mLinks[BOT_GAME], msg);
+}
@@ -0,0 +1,206 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef BOT_H
+#define BOT_H
+
+#include "bot-client/botnetwork.h"
+#include "utils/histogram.h"
+#include "utils/point.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+class MessageIn;
+
+/**
+ * The things a bot does while in game.
+ */
+enum BotAction
+{
+    ACTION_WALK,    /**< Walks to a random spot around it. */
+    ACTION_FIGHT,   /**< Attacks a monster in sight, or chats. */
+    ACTION_CHAT,    /**< Says something around it. */
+    ACTION_WARP,    /**< Warps to one of the configured maps, or stays. */
+    ACTION_COUNT
+};
+
+/**
+ * How the bots behave, shared by all of them.
+ */
+struct BotBehaviour
+{
+    BotBehaviour():
+        accountPort(0),
+        actionInterval(1000),
+        walkRadius(320),
+        attackAbility(1),
+        capabilities(0),
+        connectChat(true)
+    {
+        for (int i = 0; i < ACTION_COUNT; ++i)
+            weights[i] = 0;
+    }
+
+    std::string accountHost;
+    int accountPort;
+    std::string namePrefix;
+    std::string password;
+
+    int weights[ACTION_COUNT];      /**< Relative frequency of the actions. */
+    int actionInterval;             /**< Average milliseconds between actions. */
+    int walkRadius;                 /**< Pixels walked at most per action. */
+    int attackAbility;              /**< Ability used on monsters. */
+    std::vector<int> warpMaps;      /**< Maps to warp to, requires @warp. */
+    std::vector<int> attributes;    /**< Points spent at character creation. */
+    int capabilities;               /**< Protocol features asked for. */
+    bool connectChat;               /**< Whether to connect to the chat server. */
+};
+
+/**
+ * What the bots measured, shared by all of them.
+ */
+struct BotStatistics
+{
+    BotStatistics():
+        logins(0),
+        registrations(0),
+        failures(0),
+        disconnects(0)
+    {}
+
+    unsigned long logins;           /**< Characters that entered the game. */
+    unsigned long registrations;    /**< Accounts created. */
+    unsigned long failures;         /**< Bots that gave up logging in. */
+    unsigned long disconnects;      /**< Lost game server connections. */
+
+    /** Milliseconds from connecting to the account server to being in game. */
+    utils::Histogram loginLatency;
+
+    /**
+     * Milliseconds between saying something and hearing it back. The game
+     * server answers at its next tick, so this follows the tick latency.
+     */
+    utils::Histogram responseLatency;
+};
+
+/**
+ * A simulated client speaking the manaserv protocol.
+ *
+ * The bot logs in to its account, registering it and creating a character
+ * when needed, enters the game and then keeps doing random actions until
+ * the program stops. When the game server drops it, it starts over.
+ */
+class Bot
+{
+    public:
+        enum State
+        {
+            STATE_IDLE,
+            STATE_CONNECTING,
+            STATE_LOGGING_IN,
+            STATE_REGISTERING,
+            STATE_CREATING,
+            STATE_SELECTING,
+            STATE_ENTERING,
+            STATE_IN_GAME,
+            STATE_FAILED
+        };
+
+        Bot(unsigned index, BotNetwork &network,
+            const BotBehaviour &behaviour, BotStatistics &statistics);
+        ~Bot();
+
+        /**
+         * Starts logging in.
+         */
+        void start();
+
+        /**
+         * Performs the actions that are due.
+         */
+        void update();
+
+        void connected(BotServer server);
+        void disconnected(BotServer server);
+        void processMessage(BotServer server, MessageIn &msg);
+
+        State getState() const
+        { return mState; }
+
+        /**
+         * Returns a steady time in milliseconds.
+         */
+        static unsigned long now();
+
+    private:
+        void requestLogin();
+        void handleLoginRandTrigger(MessageIn &msg);
+        void handleLogin(MessageIn &msg);
+        void handleRegister(MessageIn &msg);
+        void handleCharacterCreate(MessageIn &msg);
+        void handleCharacterSelect(MessageIn &msg);
+        void handleGameConnect(MessageIn &msg);
+        void handleGameMessage(MessageIn &msg);
+
+        void createCharacter();
+        void selectCharacter(int slot);
+        void connectGame(const std::string &address, int port);
+
+        /**
+         * Tries again later, or gives up.
+         */
+        void retry(unsigned long delay);
+        void fail(const char *reason, int error);
+
+        void act();
+        void walk(const Point &destination);
+        void fight();
+        void chat();
+        void warp();
+
+        unsigned mIndex;
+        std::string mName;
+        BotNetwork &mNetwork;
+        const BotBehaviour &mBehaviour;
+        BotStatistics &mStatistics;
+
+        State mState;
+        BotLink mLinks[BOT_SERVER_COUNT];
+        std::string mToken;
+        int mFailures;                  /**< Failed attempts in a row. */
+
+        unsigned long mLoginStart;      /**< When the login started. */
+        unsigned long mRetryTime;       /**< When to start over, 0 if not. */
+        unsigned long mNextAction;      /**< When to do the next action. */
+        unsigned long mRespawnTime;     /**< When to respawn, 0 if alive. */
+
+        int mBeingId;                   /**< Own being id, once known. */
+        Point mPosition;
+        std::map<int, Point> mMonsters; /**< Monsters in sight. */
+
+        unsigned mSaid;                 /**< Number of things said. */
+        std::string mPendingSay;        /**< Text waiting for its echo. */
+        unsigned long mPendingSayTime;
+};
+
+#endif // BOT_H
@@ -0,0 +1,265 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "bot-client/botnetwork.h"
+
+#include "bot-client/bot.h"
+#include "common/manaserv_protocol.h"
+#include "net/messagein.h"
+#include "net/messageout.h"
+#include "utils/logger.h"
+#include "utils/zlib.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#ifdef ENET_VERSION_CREATE
+#define ENET_CUTOFF ENET_VERSION_CREATE(1,3,0)
+#else
+#define ENET_CUTOFF 0xFFFFFFFF
+#endif
+
+/** Connections per ENet host. */
+static const size_t PEERS_PER_HOST = 256;
+
+/**
+ * Restores the message id and payload of a packet sent with
+ * XXMSG_COMPRESSED_FLAG into the given buffer. Returns false when the packet
+ * is malformed.
+ */
+static bool inflatePacket(const ENetPacket *packet, std::vector<char> &buffer)
+{
+    const unsigned headerLength = 2 + 4;
+    if (packet->dataLength < headerLength)
+        return false;
+
+    uint16_t id;
+    uint32_t length;
+    memcpy(&id, packet->data, 2);
+    memcpy(&length, packet->data + 2, 4);
+    id &= ENET_HOST_TO_NET_16(~ManaServ::XXMSG_COMPRESSED_FLAG & 0xFFFF);
+    length = ENET_NET_TO_HOST_32(length);
+
+    char *inflated;
+    unsigned inflatedLength;
+    if (!inflateMemory((char *) packet->data + headerLength,
+                       packet->dataLength - headerLength,
+                       inflated, inflatedLength))
+        return false;
+
+    const bool valid = inflatedLength == length;
+    if (valid)
+    {
+        buffer.resize(2 + inflatedLength);
+        memcpy(&buffer[0], &id, 2);
+        memcpy(&buffer[2], inflated, inflatedLength);
+    }
+    free(inflated);
+    return valid;
+}
+
+BotNetwork::BotNetwork():
+    mMessagesIn(0),
+    mMessagesOut(0),
+    mBytesIn(0),
+    mBytesOut(0)
+{
+}
+
+BotNetwork::~BotNetwork()
+{
+    for (std::vector<ENetHost *>::iterator i = mHosts.begin(),
+         i_end = mHosts.end(); i != i_end; ++i)
+    {
+        enet_host_flush(*i);
+        enet_host_destroy(*i);
+    }
+}
+
+ENetHost *BotNetwork::createHost()
+{
+#if defined(ENET_VERSION) && ENET_VERSION >= ENET_CUTOFF
+    ENetHost *host = enet_host_create(nullptr /* create a client host */,
+                                      PEERS_PER_HOST,
+                                      0 /* unlimited channel count */,
+                                      0 /* assume any amount of incoming bandwidth */,
+                                      0 /* assume any amount of outgoing bandwidth */);
+#else
+    ENetHost *host = enet_host_create(nullptr /* create a client host */,
+                                      PEERS_PER_HOST,
+                                      0 /* assume any amount of incoming bandwidth */,
+                                      0 /* assume any amount of outgoing bandwidth */);
+#endif
+
+    if (host)
+        mHosts.push_back(host);
+    return host;
+}
+
+bool BotNetwork::connect(BotLink &link, const std::string &address, int port)
+{
+    ENetAddress enetAddress;
+    if (enet_address_set_host(&enetAddress, address.c_str()) != 0)
+    {
+        LOG_ERROR("Unable to resolve " << address);
+        return false;
+    }
+    enetAddress.port = port;
+
+    // Use the first host that still has a free peer.
+    ENetPeer *peer = nullptr;
+    for (std::vector<ENetHost *>::iterator i = mHosts.begin(),
+         i_end = mHosts.end(); i != i_end && !peer; ++i)
+    {
+#if defined(ENET_VERSION) && ENET_VERSION >= ENET_CUTOFF
+        peer = enet_host_connect(*i, &enetAddress, 1, 0);
+#else
+        peer = enet_host_connect(*i, &enetAddress, 1);
+#endif
+    }
+
+    if (!peer)
+    {
+        ENetHost *host = createHost();
+        if (!host)
+        {
+            LOG_ERROR("Unable to create an ENet host.");
+            return false;
+        }
+#if defined(ENET_VERSION) && ENET_VERSION >= ENET_CUTOFF
+        peer = enet_host_connect(host, &enetAddress, 1, 0);
+#else
+        peer = enet_host_connect(host, &enetAddress, 1);
+#endif
+    }
+
+    if (!peer)
+        return false;
+
+    peer->data = &link;
+    link.peer = peer;
+    return true;
+}
+
+void BotNetwork::disconnect(BotLink &link)
+{
+    if (!link.peer)
+        return;
+
+    // Events of the old connection are not for this link anymore.
+    link.peer->data = nullptr;
+    enet_peer_disconnect_later(link.peer, 0);
+    link.peer = nullptr;
+}
+
+void BotNetwork::send(BotLink &link, const MessageOut &msg)
+{
+    if (!link.peer)
+        return;
+
+    ENetPacket *packet = enet_packet_create(msg.getData(), msg.getLength(),
+                                            ENET_PACKET_FLAG_RELIABLE);
+    if (!packet)
+    {
+        LOG_ERROR("Failure to create packet!");
+        return;
+    }
+
+    ++mMessagesOut;
+    mBytesOut += msg.getLength();
+    enet_peer_send(link.peer, 0, packet);
+}
+
+void BotNetwork::process()
+{
+    for (std::vector<ENetHost *>::iterator i = mHosts.begin(),
+         i_end = mHosts.end(); i != i_end; ++i)
+    {
+        ENetEvent event;
+        while (enet_host_service(*i, &event, 0) > 0)
+        {
+            BotLink *link = static_cast<BotLink *>(event.peer->data);
+
+            switch (event.type)
+            {
+                case ENET_EVENT_TYPE_CONNECT:
+                    if (link)
+                        link->bot->connected(link->server);
+                    break;
+
+                case ENET_EVENT_TYPE_RECEIVE:
+                    ++mMessagesIn;
+                    mBytesIn += event.packet->dataLength;
+
+                    if (link && event.packet->dataLength >= 2)
+                    {
+                        uint16_t id;
+                        memcpy(&id, event.packet->data, 2);
+                        if (ENET_NET_TO_HOST_16(id) &
+                                ManaServ::XXMSG_COMPRESSED_FLAG)
+                        {
+                            static std::vector<char> buffer;
+                            if (inflatePacket(event.packet, buffer))
+                            {
+                                MessageIn msg(&buffer[0], buffer.size());
+                                link->bot->processMessage(link->server, msg);
+                            }
+                            else
+                            {
+                                LOG_WARN("Bot dropped a malformed "
+                                         "compressed message");
+                            }
+                        }
+                        else
+                        {
+                            MessageIn msg((char *) event.packet->data,
+                                          event.packet->dataLength);
+                            link->bot->processMessage(link->server, msg);
+                        }
+                    }
+                    enet_packet_destroy(event.packet);
+                    break;
+
+                case ENET_EVENT_TYPE_DISCONNECT:
+                    event.peer->data = nullptr;
+                    if (link)
+                    {
+                        link->peer = nullptr;
+                        link->bot->disconnected(link->server);
+                    }
+                    break;
+
+                default:
+                    break;
+            }
+        }
+    }
+}
+
+void BotNetwork::flush()
+{
+    for (std::vector<ENetHost *>::iterator i = mHosts.begin(),
+         i_end = mHosts.end(); i != i_end; ++i)
+    {
+        enet_host_flush(*i);
+    }
+}
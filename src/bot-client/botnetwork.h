@@ -0,0 +1,111 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef BOTNETWORK_H
+#define BOTNETWORK_H
+
+#include <enet/enet.h>
+
+#include <string>
+#include <vector>
+
+class Bot;
+class MessageOut;
+
+/**
+ * The servers a bot talks to.
+ */
+enum BotServer
+{
+    BOT_ACCOUNT,
+    BOT_GAME,
+    BOT_CHAT,
+    BOT_SERVER_COUNT
+};
+
+/**
+ * The connection of a bot to one of the servers. The ENet peer points back
+ * to it, so that events can be routed to the bot.
+ */
+struct BotLink
+{
+    BotLink(): bot(0), server(BOT_ACCOUNT), peer(0) {}
+
+    Bot *bot;
+    BotServer server;
+    ENetPeer *peer;
+};
+
+/**
+ * Carries the connections of all bots.
+ *
+ * A few ENet client hosts are shared among the bots, each of them holding
+ * a limited number of peers, so thousands of bots need neither thousands
+ * of sockets nor a service call each.
+ */
+class BotNetwork
+{
+    public:
+        BotNetwork();
+        ~BotNetwork();
+
+        /**
+         * Starts connecting the given link to a server.
+         *
+         * @return whether a connection could be initiated.
+         */
+        bool connect(BotLink &link, const std::string &address, int port);
+
+        /**
+         * Closes the connection of the given link, after the messages that
+         * are still queued were sent.
+         */
+        void disconnect(BotLink &link);
+
+        void send(BotLink &link, const MessageOut &msg);
+
+        /**
+         * Handles all pending network events without blocking.
+         */
+        void process();
+
+        /**
+         * Sends all queued messages.
+         */
+        void flush();
+
+        unsigned long getMessagesIn() const { return mMessagesIn; }
+        unsigned long getMessagesOut() const { return mMessagesOut; }
+        unsigned long getBytesIn() const { return mBytesIn; }
+        unsigned long getBytesOut() const { return mBytesOut; }
+
+    private:
+        ENetHost *createHost();
+
+        std::vector<ENetHost *> mHosts;
+
+        unsigned long mMessagesIn;
+        unsigned long mMessagesOut;
+        unsigned long mBytesIn;
+        unsigned long mBytesOut;
+};
+
+#endif // BOTNETWORK_H
@@ -0,0 +1,481 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "bot-client/bot.h"
+#include "bot-client/botnetwork.h"
+#include "common/configuration.h"
+#include "common/defines.h"
+#include "common/manaserv_protocol.h"
+#include "net/bandwidth.h"
+#include "net/messageout.h"
+#include "utils/logger.h"
+#include "utils/xml.h"
+
+#include <cstdlib>
+#include <ctime>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <signal.h>
+#include <sstream>
+#include <enet/enet.h>
+#include <unistd.h>
+
+#ifdef __MINGW32__
+#include <windows.h>
+#define usleep(usec) (Sleep ((usec) / 1000), 0)
+#endif
+
+using utils::Logger;
+
+#define DEFAULT_LOG_FILE                    "manaserv-bot.log"
+#define DEFAULT_BEHAVIOUR_MIX               "walk=60,fight=25,chat=10,warp=5"
+
+static bool running = true;     /**< Whether the bots keep running */
+
+/** Not used by the bots, but needed by the shared network code. */
+BandwidthMonitor *gBandwidth = nullptr;
+
+/** Callback used when SIGQUIT signal is received. */
+static void closeGracefully(int)
+{
+    running = false;
+}
+
+/**
+ * Show command line arguments.
+ */
+static void printHelp()
+{
+    std::cout << "manaserv-bot" << std::endl << std::endl
+              << "Options: " << std::endl
+              << "  -h --help          : Display this help" << std::endl
+              << "     --config <path> : Set the config path to use."
+              << " (Default: ./manaserv.xml)" << std::endl
+              << "  -v --verbosity <n> : Set the verbosity level" << std::endl
+              << "                        - 0. Fatal Errors only." << std::endl
+              << "                        - 1. All Errors." << std::endl
+              << "                        - 2. Plus warnings." << std::endl
+              << "                        - 3. Plus standard information." << std::endl
+              << "                        - 4. Plus debugging information." << std::endl
+              << "  -b --bots <n>      : Number of bots to run. (Default: 100)"
+              << std::endl
+              << "  -r --rate <n>      : Bots started per second. (Default: 50)"
+              << std::endl
+              << "  -d --duration <n>  : Seconds to run, 0 for until"
+              << " interrupted. (Default: 0)" << std::endl;
+    exit(EXIT_NORMAL);
+}
+
+struct CommandLineOptions
+{
+    CommandLineOptions():
+        verbosity(Logger::Warn),
+        verbosityChanged(false),
+        bots(100),
+        rate(50),
+        duration(0)
+    {}
+
+    std::string configPath;
+
+    Logger::Level verbosity;
+    bool verbosityChanged;
+
+    int bots;
+    int rate;
+    int duration;
+};
+
+/**
+ * Parse the command line arguments
+ */
+static void parseOptions(int argc, char *argv[], CommandLineOptions &options)
+{
+    const char *optString = "hv:b:r:d:";
+
+    const struct option longOptions[] =
+    {
+        { "help",       no_argument,       0, 'h' },
+        { "config",     required_argument, 0, 'c' },
+        { "verbosity",  required_argument, 0, 'v' },
+        { "bots",       required_argument, 0, 'b' },
+        { "rate",       required_argument, 0, 'r' },
+        { "duration",   required_argument, 0, 'd' },
+        { 0, 0, 0, 0 }
+    };
+
+    while (optind < argc)
+    {
+        int result = getopt_long(argc, argv, optString, longOptions, nullptr);
+
+        if (result == -1)
+            break;
+
+        switch (result)
+        {
+            default: // Unknown option.
+            case 'h':
+                // Print help.
+                printHelp();
+                break;
+            case 'c':
+                // Change config filename and path.
+                options.configPath = optarg;
+                break;
+            case 'v':
+                options.verbosity = static_cast<Logger::Level>(atoi(optarg));
+                options.verbosityChanged = true;
+                break;
+            case 'b':
+                options.bots = atoi(optarg);
+                break;
+            case 'r':
+                options.rate = std::max(1, atoi(optarg));
+                break;
+            case 'd':
+                options.duration = atoi(optarg);
+                break;
+        }
+    }
+}
+
+/**
+ * Reads the relative weights of the actions, given as a list like
+ * "walk=60,fight=25,chat=10,warp=5". Actions left out are never done.
+ */
+static void parseBehaviourMix(const std::string &mix, BotBehaviour &behaviour)
+{
+    static const char *names[ACTION_COUNT] = { "walk", "fight", "chat", "warp" };
+
+    std::istringstream list(mix);
+    std::string entry;
+    while (std::getline(list, entry, ','))
+    {
+        const std::string::size_type separator = entry.find('=');
+        const std::string name = entry.substr(0, separator);
+        const int weight = separator == std::string::npos ?
+                    1 : atoi(entry.c_str() + separator + 1);
+
+        int action = 0;
+        while (action < ACTION_COUNT && name != names[action])
+            ++action;
+
+        if (action == ACTION_COUNT)
+            LOG_WARN("Unknown bot action '" << name << "' ignored.");
+        else
+            behaviour.weights[action] = std::max(0, weight);
+    }
+}
+
+static void parseMapList(const std::string &maps, std::vector<int> &result)
+{
+    std::istringstream list(maps);
+    std::string entry;
+    while (std::getline(list, entry, ','))
+    {
+        if (const int map = atoi(entry.c_str()))
+            result.push_back(map);
+    }
+}
+
+/**
+ * Spreads the starting points of the attributes file over the modifiable
+ * attributes, the way the account server checks them at creation.
+ */
+static bool readCharacterAttributes(const std::string &fileName,
+                                    std::vector<int> &attributes)
+{
+    XML::Document doc(fileName, false);
+    xmlNodePtr rootNode = doc.rootNode();
+
+    if (!rootNode || !xmlStrEqual(rootNode->name, BAD_CAST "attributes"))
+    {
+        LOG_ERROR("Bots: " << fileName << " is not a valid attributes file!");
+        return false;
+    }
+
+    int modifiable = 0;
+    int points = 0, minimum = 0, maximum = 0;
+    for_each_xml_child_node(node, rootNode)
+    {
+        if (xmlStrEqual(node->name, BAD_CAST "attribute"))
+        {
+            if (XML::getBoolProperty(node, "modifiable", false))
+                ++modifiable;
+        }
+        else if (xmlStrEqual(node->name, BAD_CAST "points"))
+        {
+            points = XML::getProperty(node, "start", 0);
+            minimum = XML::getProperty(node, "minimum", 0);
+            maximum = XML::getProperty(node, "maximum", 0);
+        }
+    }
+
+    for (int i = 0; i < modifiable; ++i)
+    {
+        // Hand out what is left evenly over the remaining attributes
+        const int share = points / (modifiable - i);
+        const int value = std::min(std::max(share, minimum), maximum);
+        attributes.push_back(value);
+        points -= value;
+    }
+    return true;
+}
+
+static void printRate(const char *name, unsigned long count, double seconds)
+{
+    std::cout << "  " << std::left << std::setw(22) << name << std::right
+              << std::setw(12) << count << std::setw(12) << std::fixed
+              << std::setprecision(1) << count / seconds << "/s" << std::endl;
+}
+
+static void printLatency(const char *name, const utils::Histogram &histogram)
+{
+    std::cout << "  " << std::left << std::setw(22) << name << std::right
+              << " count " << histogram.getCount()
+              << "  p50 " << histogram.getPercentile(50)
+              << "  p99 " << histogram.getPercentile(99)
+              << "  max " << histogram.getMax() << " ms" << std::endl;
+}
+
+/**
+ * Writes what the bots did since the last report.
+ */
+static void printReport(const std::vector<Bot *> &bots,
+                        const BotNetwork &network,
+                        const BotStatistics &statistics,
+                        const BotStatistics &last,
+                        unsigned long lastMessagesIn,
+                        unsigned long lastMessagesOut,
+                        unsigned long lastBytesIn,
+                        unsigned long lastBytesOut,
+                        double seconds)
+{
+    int inGame = 0, failed = 0;
+    for (std::vector<Bot *>::const_iterator i = bots.begin(),
+         i_end = bots.end(); i != i_end; ++i)
+    {
+        if ((*i)->getState() == Bot::STATE_IN_GAME)
+            ++inGame;
+        else if ((*i)->getState() == Bot::STATE_FAILED)
+            ++failed;
+    }
+
+    std::cout << "Bots: " << bots.size() << " started, " << inGame
+              << " in game, " << bots.size() - inGame - failed
+              << " logging in, " << failed << " failed" << std::endl;
+    printRate("logins", statistics.logins - last.logins, seconds);
+    printRate("registrations",
+              statistics.registrations - last.registrations, seconds);
+    printRate("disconnects",
+              statistics.disconnects - last.disconnects, seconds);
+    printRate("messages in",
+              network.getMessagesIn() - lastMessagesIn, seconds);
+    printRate("messages out",
+              network.getMessagesOut() - lastMessagesOut, seconds);
+    printRate("bytes in", network.getBytesIn() - lastBytesIn, seconds);
+    printRate("bytes out", network.getBytesOut() - lastBytesOut, seconds);
+    printLatency("login latency", statistics.loginLatency);
+    printLatency("response latency", statistics.responseLatency);
+}
+
+/**
+ * Starts the bots at the requested rate and runs them until stopped,
+ * reporting what they did at regular intervals.
+ */
+static void runBots(const CommandLineOptions &options,
+                    const BotBehaviour &behaviour,
+                    int reportInterval)
+{
+    BotNetwork network;
+    BotStatistics statistics;
+    std::vector<Bot *> bots;
+
+    // Values at the last report, and over the whole run
+    BotStatistics last;
+    BotStatistics total;
+    unsigned long lastMessagesIn = 0, lastMessagesOut = 0;
+    unsigned long lastBytesIn = 0, lastBytesOut = 0;
+
+    const unsigned long startTime = Bot::now();
+    unsigned long lastReport = startTime;
+
+    while (running)
+    {
+        const unsigned long time = Bot::now();
+
+        // Start the bots at the requested rate
+        const unsigned long due = std::min<unsigned long>(
+                options.bots, (time - startTime) * options.rate / 1000 + 1);
+        while (bots.size() < due)
+        {
+            Bot *bot = new Bot(bots.size(), network, behaviour, statistics);
+            bots.push_back(bot);
+            bot->start();
+        }
+
+        network.process();
+
+        for (std::vector<Bot *>::iterator i = bots.begin(),
+             i_end = bots.end(); i != i_end; ++i)
+        {
+            (*i)->update();
+        }
+
+        network.flush();
+
+        if (time - lastReport >= (unsigned long) reportInterval * 1000)
+        {
+            printReport(bots, network, statistics, last,
+                        lastMessagesIn, lastMessagesOut,
+                        lastBytesIn, lastBytesOut,
+                        (time - lastReport) / 1000.0);
+
+            total.loginLatency.merge(statistics.loginLatency);
+            total.responseLatency.merge(statistics.responseLatency);
+            statistics.loginLatency.reset();
+            statistics.responseLatency.reset();
+
+            last.logins = statistics.logins;
+            last.registrations = statistics.registrations;
+            last.disconnects = statistics.disconnects;
+            lastMessagesIn = network.getMessagesIn();
+            lastMessagesOut = network.getMessagesOut();
+            lastBytesIn = network.getBytesIn();
+            lastBytesOut = network.getBytesOut();
+            lastReport = time;
+        }
+
+        if (options.duration > 0 &&
+            time - startTime >= (unsigned long) options.duration * 1000)
+        {
+            running = false;
+        }
+
+        usleep(1000);
+    }
+
+    // Summary of the whole run
+    total.loginLatency.merge(statistics.loginLatency);
+    total.responseLatency.merge(statistics.responseLatency);
+    total.logins = statistics.logins;
+    total.registrations = statistics.registrations;
+    total.disconnects = statistics.disconnects;
+
+    std::cout << std::endl << "Total:" << std::endl;
+    printReport(bots, network, total, BotStatistics(), 0, 0, 0, 0,
+                std::max<unsigned long>(1, Bot::now() - startTime) / 1000.0);
+
+    for (std::vector<Bot *>::iterator i = bots.begin(),
+         i_end = bots.end(); i != i_end; ++i)
+    {
+        delete *i;
+    }
+}
+
+/**
+ * Main function, starts the bots and runs them until stopped.
+ */
+int main(int argc, char *argv[])
+{
+    // Parse command line options
+    CommandLineOptions options;
+    parseOptions(argc, argv, options);
+
+    if (!Configuration::initialize(options.configPath))
+    {
+        LOG_FATAL("Refusing to run without configuration!");
+        exit(EXIT_CONFIG_NOT_FOUND);
+    }
+
+    if (!options.verbosityChanged)
+        options.verbosity = static_cast<Logger::Level>(
+                               Configuration::getValue("log_botLogLevel",
+                                                       options.verbosity) );
+    Logger::setVerbosity(options.verbosity);
+    Logger::initialize(Configuration::getValue("log_botFile",
+                                               DEFAULT_LOG_FILE));
+
+#if (defined __USE_UNIX98 || defined __FreeBSD__)
+    signal(SIGQUIT, closeGracefully);
+#endif
+    signal(SIGINT, closeGracefully);
+    signal(SIGTERM, closeGracefully);
+
+    BotBehaviour behaviour;
+    behaviour.accountHost = Configuration::getValue("net_accountHost",
+                                                    "localhost");
+    behaviour.accountPort =
+            Configuration::getValue("net_accountListenToClientPort",
+                                    DEFAULT_SERVER_PORT);
+    behaviour.namePrefix = Configuration::getValue("bot_namePrefix", "bot");
+    behaviour.password = Configuration::getValue("bot_password", "bot");
+    parseBehaviourMix(Configuration::getValue("bot_mix",
+                                              DEFAULT_BEHAVIOUR_MIX),
+                      behaviour);
+    behaviour.actionInterval =
+            Configuration::getValue("bot_actionInterval", 1000);
+    behaviour.walkRadius = Configuration::getValue("bot_walkRadius", 320);
+    behaviour.attackAbility = Configuration::getValue("bot_attackAbility", 1);
+    parseMapList(Configuration::getValue("bot_warpMaps", std::string()),
+                 behaviour.warpMaps);
+    behaviour.capabilities = Configuration::getValue("bot_capabilities", 0);
+    if (behaviour.capabilities & ~ManaServ::SUPPORTED_CAPABILITIES)
+    {
+        LOG_WARN("Ignoring unsupported bot capabilities "
+                 << (behaviour.capabilities &
+                     ~ManaServ::SUPPORTED_CAPABILITIES));
+        behaviour.capabilities &= ManaServ::SUPPORTED_CAPABILITIES;
+    }
+    behaviour.connectChat = Configuration::getBoolValue("bot_connectChat",
+                                                        true);
+
+    const std::string attributesFile =
+            Configuration::getValue("bot_attributesFile",
+                    Configuration::getValue("worldDataPath", "example")
+                    + "/attributes.xml");
+    if (!readCharacterAttributes(attributesFile, behaviour.attributes))
+        return EXIT_XML_NOT_FOUND;
+
+    const int reportInterval =
+            std::max(1, Configuration::getValue("bot_reportInterval", 10));
+
+    MessageOut::setDebugModeEnabled(
+            Configuration::getBoolValue("net_debugMode", false));
+
+    if (enet_initialize() != 0)
+    {
+        LOG_FATAL("An error occurred while initializing ENet");
+        exit(EXIT_NET_EXCEPTION);
+    }
+
+    std::srand(time(nullptr));
+
+    runBots(options, behaviour, reportInterval);
+
+    enet_deinitialize();
+
+    Configuration::deinitialize();
+    Logger::deinitialize();
+
+    return EXIT_NORMAL;
+}
@@ -43,6 +43,8 @@ class ChatClient : public NetComputer
             , characterId(0)
             , party(0)
             , accountLevel(0)
+            , capabilities(0)
+            , capabilitiesNegotiated(false)
         {
         }
 
@@ -52,6 +54,8 @@ class ChatClient : public NetComputer
         std::vector<Guild *> guilds;
         Party *party;
         unsigned char accountLevel;
+        int capabilities;               /**< Accepted CAPABILITY_* flags. */
+        bool capabilitiesNegotiated;    /**< Client sent its capabilities. */
         std::map<ChatChannel*, std::string> userModes;
 };
 
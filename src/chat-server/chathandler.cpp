@@ -96,6 +96,8 @@ void ChatHandler::tokenMatched(ChatClient *client, Pending *p)
         delete p;
 
         msg.writeInt8(ERRMSG_OK);
+        if (client->capabilitiesNegotiated)
+            msg.writeInt16(client->capabilities);
 
         // Add chat client to player map
         mPlayerMap.insert(std::pair<std::string, ChatClient*>(client->characterName, client));
@@ -148,6 +150,17 @@ void ChatHandler::processMessage(NetComputer *comp, MessageIn &message)
         if (message.getId() != PCMSG_CONNECT) return;
 
         std::string magic_token = message.readString(MAGIC_TOKEN_LENGTH);
+
+        // Older clients do not send any capabilities
+        if (message.getUnreadLength() > 0)
+        {
+            computer.capabilities = message.readInt16() &
+                                    CAPABILITY_COMPRESSION;
+            computer.capabilitiesNegotiated = true;
+            computer.setCompressionEnabled(
+                    computer.capabilities & CAPABILITY_COMPRESSION);
+        }
+
         mTokenCollector.addPendingClient(magic_token, &computer);
         sendGuildRejoin(computer);
         return;
@@ -262,7 +275,8 @@ void ChatHandler::warnPlayerAboutBadWords(ChatClient &computer)
 
 void ChatHandler::handleChatMessage(ChatClient &client, MessageIn &msg)
 {
-    std::string text = msg.readString();
+    // The view is only valid until this message was processed
+    const utils::StringView text = msg.readStringView();
 
     // Pass it through the slang filter (false when it contains bad words)
     if (!stringFilter->filterContent(text))
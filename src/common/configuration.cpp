@@ -19,9 +19,11 @@
  *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cmath>
 #include <map>
 #include <set>
+#include <vector>
 #include <libxml/xmlreader.h>
 
 #include "common/configuration.h"
@@ -37,6 +39,18 @@ static std::map< std::string, std::string > options;
 /**< Location of config file. */
 static std::string configPath;
 static std::set<std::string> processedFiles;
+/**< Whether the configuration file was read. */
+static bool initialized = false;
+
+/**
+ * Returns the typed settings. A function-local static makes sure the list
+ * exists when static settings of other files register themselves.
+ */
+static std::vector<Configuration::SettingBase *> &settings()
+{
+    static std::vector<Configuration::SettingBase *> registered;
+    return registered;
+}
 
 static bool readFile(const std::string &fileName)
 {
@@ -92,17 +106,84 @@ bool Configuration::initialize(const std::string &fileName)
         configPath = fileName;
 
     const bool success = readFile(configPath);
+    initialized = true;
 
     LOG_INFO("Using config file: " << configPath);
 
+    // Resolve the settings created before the options were known.
+    std::vector<SettingBase *> &all = settings();
+    for (std::vector<SettingBase *>::iterator i = all.begin(),
+         i_end = all.end(); i != i_end; ++i)
+    {
+        (*i)->resolve();
+    }
+
     return success;
 }
 
+bool Configuration::isInitialized()
+{
+    return initialized;
+}
+
 void Configuration::deinitialize()
 {
     processedFiles.clear();
 }
 
+bool Configuration::reload()
+{
+    std::map<std::string, std::string> previous;
+    previous.swap(options);
+    processedFiles.clear();
+
+    if (!readFile(configPath))
+    {
+        LOG_WARN("Keeping the previous configuration.");
+        options.swap(previous);
+        return false;
+    }
+
+    std::vector<SettingBase *> &all = settings();
+    for (std::vector<SettingBase *>::iterator i = all.begin(),
+         i_end = all.end(); i != i_end; ++i)
+    {
+        SettingBase *setting = *i;
+        if (setting->isLive())
+        {
+            setting->resolve();
+            continue;
+        }
+
+        const std::string &key = setting->getKey();
+        std::map<std::string, std::string>::iterator old = previous.find(key);
+        const std::string oldValue =
+                old == previous.end() ? std::string() : old->second;
+
+        if (getValue(key, std::string()) != oldValue)
+        {
+            LOG_WARN("Option '" << key << "' changed but only takes "
+                     "effect after a restart.");
+        }
+    }
+
+    LOG_INFO("Reloaded config file: " << configPath);
+    return true;
+}
+
+Configuration::SettingBase::SettingBase(const std::string &key, bool live)
+    : mKey(key)
+    , mLive(live)
+{
+    settings().push_back(this);
+}
+
+Configuration::SettingBase::~SettingBase()
+{
+    std::vector<SettingBase *> &all = settings();
+    all.erase(std::remove(all.begin(), all.end(), this), all.end());
+}
+
 std::string Configuration::getValue(const std::string &key,
                                     const std::string &deflt)
 {
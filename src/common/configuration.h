@@ -24,6 +24,8 @@
 
 #include <string>
 
+#include <sigc++/signal.h>
+
 namespace Configuration
 {
     /**
@@ -37,6 +39,18 @@ namespace Configuration
 
     void deinitialize();
 
+    /**
+     * Returns whether the configuration options were loaded.
+     */
+    bool isInitialized();
+
+    /**
+     * Reads the configuration file again and updates all live settings.
+     *
+     * @return whether the configuration file could be read
+     */
+    bool reload();
+
     /**
      * Gets an option as a string.
      * @param key option identifier.
@@ -57,6 +71,97 @@ namespace Configuration
      * @param deflt default value.
      */
     bool getBoolValue(const std::string &key, bool deflt);
+
+    /**
+     * Base class of the typed settings, allowing the configuration to
+     * resolve them again when it is (re)loaded.
+     */
+    class SettingBase
+    {
+        public:
+            /**
+             * Looks up the option again and notifies listeners when its
+             * value changed.
+             */
+            virtual void resolve() = 0;
+
+            const std::string &getKey() const
+            { return mKey; }
+
+            /**
+             * Whether the setting follows configuration reloads. Settings
+             * that are not live keep the value read at startup.
+             */
+            bool isLive() const
+            { return mLive; }
+
+        protected:
+            SettingBase(const std::string &key, bool live);
+            virtual ~SettingBase();
+
+        private:
+            SettingBase(const SettingBase &);
+            SettingBase &operator=(const SettingBase &);
+
+            std::string mKey;
+            bool mLive;
+    };
+
+    /**
+     * A configuration option resolved once into a typed value.
+     *
+     * Reading a setting is as cheap as reading a variable, so unlike the
+     * getValue functions it can be used in code running every tick. The
+     * value is resolved when the configuration is loaded and, for live
+     * settings, again on reload, emitting signal_changed when it differs.
+     *
+     * Settings are supposed to be static objects with the lifetime of the
+     * program. Supported types are int, bool and std::string.
+     */
+    template<typename T>
+    class Setting : public SettingBase
+    {
+        public:
+            Setting(const std::string &key, const T &deflt,
+                    bool live = true)
+                : SettingBase(key, live)
+                , mDefault(deflt)
+                , mValue(deflt)
+            {
+                // Static settings are resolved by initialize() instead.
+                if (isInitialized())
+                    resolve();
+            }
+
+            const T &get() const
+            { return mValue; }
+
+            operator const T &() const
+            { return mValue; }
+
+            void resolve()
+            {
+                T value = read();
+                if (value == mValue)
+                    return;
+
+                mValue = value;
+                signal_changed.emit(mValue);
+            }
+
+            sigc::signal<void, const T &> signal_changed;
+
+        private:
+            T read() const
+            { return getValue(getKey(), mDefault); }
+
+            T mDefault;
+            T mValue;
+    };
+
+    template<>
+    inline bool Setting<bool>::read() const
+    { return getBoolValue(getKey(), mDefault); }
 }
 
 #ifndef DEFAULT_SERVER_PORT
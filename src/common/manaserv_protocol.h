@@ -43,7 +43,8 @@ enum ValueType {
     Int16,
     Int32,
     String,
-    Double
+    Double,
+    VarInt
 };
 
 /**
@@ -59,6 +60,11 @@ enum ValueType {
  *
  * Components: B byte, W word, D double word, S variable-size string
  *             C tile-based coordinates (B*3)
+ *             V variable-length unsigned integer (LEB128, 1-5 bytes)
+ *             Z variable-length signed integer (zigzag-encoded V)
+ *             DF double: B length, followed by that many characters of
+ *                decimal text, or B DOUBLE_BINARY_MARKER, followed by an
+ *                IEEE-754 double in network byte order (8 bytes)
  *
  * Hosts:      P (player's client), A (account server), C (chat server),
  *             G (game server)
@@ -95,10 +101,10 @@ enum {
     PAMSG_PASSWORD_CHANGE          = 0x0034, // S old password, S new password
     APMSG_PASSWORD_CHANGE_RESPONSE = 0x0035, // B error
 
-    PGMSG_CONNECT                  = 0x0050, // B*32 token
-    GPMSG_CONNECT_RESPONSE         = 0x0051, // B error
-    PCMSG_CONNECT                  = 0x0053, // B*32 token
-    CPMSG_CONNECT_RESPONSE         = 0x0054, // B error
+    PGMSG_CONNECT                  = 0x0050, // B*32 token [, W capabilities]
+    GPMSG_CONNECT_RESPONSE         = 0x0051, // B error [, W accepted capabilities]
+    PCMSG_CONNECT                  = 0x0053, // B*32 token [, W capabilities]
+    CPMSG_CONNECT_RESPONSE         = 0x0054, // B error [, W accepted capabilities]
 
     PGMSG_DISCONNECT               = 0x0060, // B reconnect account
     GPMSG_DISCONNECT_RESPONSE      = 0x0061, // B error, B*32 token
@@ -122,6 +128,7 @@ enum {
     GPMSG_UNEQUIP                  = 0x0124, // W equipped inventory slot
     GPMSG_UNEQUIP_RESPONSE         = 0x0125, // B error, W slot
     GPMSG_PLAYER_ATTRIBUTE_CHANGE  = 0x0130, // { W attribute, D base value (in 1/256ths), D modified value (in 1/256ths)}*
+    GPMSG_PLAYER_ATTRIBUTE_CHANGE_COMPACT = 0x0131, // { V attribute, Z base value (in 1/256ths), Z modified value (in 1/256ths)}*
     GPMSG_ATTRIBUTE_POINTS_STATUS  = 0x0140, // W character points, W correction points
     PGMSG_RAISE_ATTRIBUTE          = 0x0160, // W attribute
     GPMSG_RAISE_ATTRIBUTE_RESPONSE = 0x0161, // B error, W attribute
@@ -148,6 +155,7 @@ enum {
     GPMSG_BEING_ABILITY_POINT      = 0x0282, // W being id, B abilityId, W*2 point
     GPMSG_BEING_ABILITY_BEING      = 0x0283, // W being id, B abilityId, W target being id
     GPMSG_BEING_ABILITY_DIRECTION  = 0x0284, // W being id, B abilityId, B direction
+    GPMSG_BEINGS_MOVE_COMPACT      = 0x0285, // { V being id, B flags [, W*2 destination] [, Z*2 destination delta] [, B speed] }*
     PGMSG_USE_ABILITY_ON_BEING     = 0x0290, // B abilityID, W being id
     PGMSG_USE_ABILITY_ON_POINT     = 0x0291, // B abilityID, W*2 position
     PGMSG_USE_ABILITY_ON_DIRECTION = 0x0292, // B abilityID, B direction
@@ -260,15 +268,19 @@ enum {
     GPMSG_QUESTLOG_STATUS       = 0x0470, // {W quest id, B flags, [B status], [S questname], [S questdescription]}*
 
     // Inter-server
-    GAMSG_REGISTER              = 0x0500, // S address, W port, S password, D items db revision
-    AGMSG_REGISTER_RESPONSE     = 0x0501, // W item version, W password response, { S globalvar_key, S globalvar_value }
+    GAMSG_REGISTER              = 0x0500, // S address, W port, S password, D items db revision [, W capabilities]
+    AGMSG_REGISTER_RESPONSE     = 0x0501, // W item version, W password response, { S globalvar_key, S globalvar_value } [, W accepted capabilities (when asked for)]
     AGMSG_ACTIVE_MAP            = 0x0502, // W map id, W Number of mapvar_key mapvar_value sent, { S mapvar_key, S mapvar_value }, W Number of map items, { D item Id, W amount, W posX, W posY }
     AGMSG_PLAYER_ENTER          = 0x0510, // B*32 token, D id, S name, serialised character data
     GAMSG_PLAYER_DATA           = 0x0520, // D id, serialised character data
+    GAMSG_PLAYER_SNAPSHOT       = 0x0521, // D id, D sequence, B version, B sections, { section }* (see SNAPSHOT_*)
+    AGMSG_PLAYER_SNAPSHOT_ACK   = 0x0522, // D id, D sequence
     GAMSG_REDIRECT              = 0x0530, // D id
     AGMSG_REDIRECT_RESPONSE     = 0x0531, // D id, B*32 token, S game address, W game port
     GAMSG_PLAYER_RECONNECT      = 0x0532, // D id, B*32 token
     GAMSG_PLAYER_SYNC           = 0x0533, // serialised sync data
+    GAMSG_PLAYER_SYNC_SEQUENCED = 0x0534, // D sequence number, serialised sync data
+    AGMSG_PLAYER_SYNC_ACK       = 0x0535, // D highest sequence number applied
     GAMSG_SET_VAR_CHR           = 0x0540, // D id, S name, S value
     GAMSG_GET_VAR_CHR           = 0x0541, // D id, S name
     AGMSG_GET_VAR_CHR_RESPONSE  = 0x0542, // D id, S name, S value
@@ -280,7 +292,9 @@ enum {
     AGMSG_SET_VAR_WORLD         = 0x0548, // S name, S value
     GAMSG_BAN_PLAYER            = 0x0550, // D id, W duration
     GAMSG_CHANGE_ACCOUNT_LEVEL  = 0x0556, // D id, W level
-    GAMSG_STATISTICS            = 0x0560, // { W map id, W entity nb, W monster nb, W player nb, { D character id }* }*
+    GAMSG_STATISTICS            = 0x0560, // { W map id, W entity nb, W monster nb, W player nb, { D character id }* }*, W 0,
+                                          // [W overload level, W deferred logins (CAPABILITY_LOAD_STATISTICS),]
+                                          // { W message id, D sent nb, D sent bytes, D received nb, D received bytes }*
     CGMSG_CHANGED_PARTY         = 0x0590, // D character id, D party id
     GCMSG_REQUEST_POST          = 0x05A0, // D character id
     CGMSG_POST_RESPONSE         = 0x05A1, // D receiver id, { S sender name, S letter, W num attachments { W attachment item id, W quantity } }
@@ -292,6 +306,8 @@ enum {
     GAMSG_ANNOUNCE              = 0x0603, // S text, W senderid, S sendername
 
     XXMSG_DEBUG_FLAG            = 0x8000, // Message in debug mode
+    XXMSG_COMPRESSED_FLAG       = 0x4000, // Message payload is compressed:
+                                          // D payload length, B* zlib data
     XXMSG_INVALID               = 0x7FFF
 };
 
@@ -330,7 +346,14 @@ enum {
 enum {
     SYNC_CHARACTER_POINTS    = 0x01,       // D charId, D charPoints, D corrPoints
     SYNC_CHARACTER_ATTRIBUTE = 0x02,       // D charId, D attrId, DF base, DF mod
-    SYNC_ONLINE_STATUS       = 0x04        // D charId, B 0 = offline, 1 = online
+    SYNC_ONLINE_STATUS       = 0x04,       // D charId, B 0 = offline, 1 = online
+    SYNC_CHARACTER_ATTRIBUTE_COMPACT = 0x08 // V charId, V attrId, DF base, DF mod
+};
+
+// Marks a DF value that is sent as a binary IEEE-754 double rather than as
+// decimal text. Text doubles are never this long.
+enum {
+    DOUBLE_BINARY_MARKER = 0xFF
 };
 
 // Login specific return values
@@ -390,9 +413,70 @@ enum EntityType
 // Moving object flags
 enum {
     // Payload contains the current position.
+    // GPMSG_BEINGS_MOVE_COMPACT: payload contains the absolute destination.
     MOVING_POSITION = 1,
     // Payload contains the destination.
-    MOVING_DESTINATION = 2
+    // GPMSG_BEINGS_MOVE_COMPACT: payload contains the destination as a delta
+    // against the last destination sent for this being.
+    MOVING_DESTINATION = 2,
+    // GPMSG_BEINGS_MOVE_COMPACT: the destination delta is in tiles, not pixels.
+    MOVING_TILES = 4,
+    // GPMSG_BEINGS_MOVE_COMPACT: payload contains the speed, which changed
+    // since it was last sent for this being.
+    MOVING_SPEED = 8
+};
+
+// Optional protocol features a client can ask for in PGMSG_CONNECT and
+// PCMSG_CONNECT. The server answers with the subset it accepted in
+// GPMSG_CONNECT_RESPONSE and CPMSG_CONNECT_RESPONSE.
+enum {
+    // Movement is sent as GPMSG_BEINGS_MOVE_COMPACT instead of
+    // GPMSG_BEINGS_MOVE. Game server only.
+    CAPABILITY_COMPACT_MOVEMENT = 0x0001,
+    // Large messages may be sent with XXMSG_COMPRESSED_FLAG set.
+    CAPABILITY_COMPRESSION      = 0x0002,
+    // Doubles may be sent in binary form and some messages use varints for
+    // IDs and counts: GPMSG_PLAYER_ATTRIBUTE_CHANGE_COMPACT replaces
+    // GPMSG_PLAYER_ATTRIBUTE_CHANGE. Also negotiated between the game
+    // server and the account server in GAMSG_REGISTER, where it enables
+    // SYNC_CHARACTER_ATTRIBUTE_COMPACT.
+    CAPABILITY_BINARY_ENCODING  = 0x0004,
+    // Sync data is sent as GAMSG_PLAYER_SYNC_SEQUENCED and acknowledged
+    // with AGMSG_PLAYER_SYNC_ACK. Game server to account server only.
+    CAPABILITY_SEQUENCED_SYNC   = 0x0008,
+    // Character data is sent as GAMSG_PLAYER_SNAPSHOT and acknowledged with
+    // AGMSG_PLAYER_SNAPSHOT_ACK. Game server to account server only.
+    CAPABILITY_CHARACTER_SNAPSHOTS = 0x0010,
+    // GAMSG_STATISTICS carries the overload level and the number of
+    // deferred logins. Game server to account server only.
+    CAPABILITY_LOAD_STATISTICS  = 0x0020,
+
+    SUPPORTED_CAPABILITIES      = CAPABILITY_COMPACT_MOVEMENT |
+                                  CAPABILITY_COMPRESSION |
+                                  CAPABILITY_BINARY_ENCODING,
+
+    SUPPORTED_SERVER_CAPABILITIES = CAPABILITY_BINARY_ENCODING |
+                                    CAPABILITY_SEQUENCED_SYNC |
+                                    CAPABILITY_CHARACTER_SNAPSHOTS |
+                                    CAPABILITY_LOAD_STATISTICS
+};
+
+// Sections of GAMSG_PLAYER_SNAPSHOT, which follow each other in this order.
+// A snapshot only holds the sections that changed since the last snapshot
+// the account server acknowledged for the character.
+enum {
+    CHARACTER_SNAPSHOT_VERSION = 1,
+
+    SNAPSHOT_GENERAL    = 0x01, // B account level, B gender, B hair style, B hair color, W attribute points, W correction points
+    SNAPSHOT_ATTRIBUTES = 0x02, // V count, { V id, DF base, DF modified }*
+    SNAPSHOT_STATUS     = 0x04, // V count, { V status id, V time }*
+    SNAPSHOT_LOCATION   = 0x08, // W map id, W*2 position
+    SNAPSHOT_KILLS      = 0x10, // V count, { V monster id, V kills }*
+    SNAPSHOT_ABILITIES  = 0x20, // V count, { V ability id }*
+    SNAPSHOT_QUESTS     = 0x40, // V count, { V id, B state, S title, S description }*
+    SNAPSHOT_INVENTORY  = 0x80, // V count, { V slot, V item id, V amount, B equipment slot }*
+
+    SNAPSHOT_SECTION_COUNT = 8
 };
 
 // Chat errors return values
@@ -22,6 +22,8 @@
 
 #include "dalexcept.h"
 
+#include "utils/tracer.h"
+
 namespace dal
 {
 
@@ -143,6 +145,10 @@ const RecordSet &MySqlDataProvider::execSql(const std::string& sql,
     // otherwise just return the recordset from cache.
     if (refresh || (sql != mSql))
     {
+        utils::TraceSpan span("sql", "query");
+        if (span.isRecording())
+            span.setDetail(sql);
+
         mRecordSet.clear();
 
         // actually execute the query.
@@ -368,6 +374,8 @@ bool MySqlDataProvider::prepareSql(const std::string &sql)
     if (mysql_stmt_prepare(mStmt, sql.c_str(), sql.size()) != 0)
         return false;
 
+    mPreparedSql = sql;
+
     // Allocate bind memory now that the prepared state is done.
     mBind = new MYSQL_BIND[(int)mysql_stmt_param_count(mStmt)];
 
@@ -379,6 +387,10 @@ const RecordSet &MySqlDataProvider::processSql()
     if (!mIsConnected)
         throw std::runtime_error("not connected to database");
 
+    utils::TraceSpan span("sql", "statement");
+    if (span.isRecording())
+        span.setDetail(mPreparedSql);
+
     // Since we'll have to return something in all cases,
     // we clear the result member first.
     mRecordSet.clear();
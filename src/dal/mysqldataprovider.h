@@ -205,6 +205,8 @@ class MySqlDataProvider: public DataProvider
         MYSQL *mDb;
         /** The prepared statement to process */
         MYSQL_STMT *mStmt;
+        /** The text of the prepared statement, for tracing */
+        std::string mPreparedSql;
         /** The Bind structure used in prepared statement */
         MYSQL_BIND* mBind;
         /** Tells whether we're in the middle of a transaction */
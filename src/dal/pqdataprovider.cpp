@@ -21,6 +21,8 @@
 #include "pqdataprovider.h"
 #include "dalexcept.h"
 
+#include "utils/tracer.h"
+
 namespace dal
 {
 
@@ -87,6 +89,10 @@ const RecordSet &PqDataProvider::execSql(const std::string& sql,
 
     if (refresh || (sql != mSql))
     {
+        utils::TraceSpan span("sql", "query");
+        if (span.isRecording())
+            span.setDetail(sql);
+
         mRecordSet.clear();
 
         // execute the query
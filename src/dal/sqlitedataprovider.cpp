@@ -24,6 +24,7 @@
 
 #include "common/configuration.h"
 #include "utils/logger.h"
+#include "utils/tracer.h"
 
 #include <stdexcept>
 #include <limits.h>
@@ -131,6 +132,10 @@ const RecordSet &SqLiteDataProvider::execSql(const std::string& sql,
     // otherwise just return the recordset from cache.
     if (refresh || (sql != mSql))
     {
+        utils::TraceSpan span("sql", "query");
+        if (span.isRecording())
+            span.setDetail(sql);
+
         char** result;
         int nRows;
         int nCols;
@@ -373,6 +378,10 @@ const RecordSet &SqLiteDataProvider::processSql()
     if (!mIsConnected)
         throw std::runtime_error("not connected to database");
 
+    utils::TraceSpan span("sql", "statement");
+    if (span.isRecording())
+        span.setDetail(sqlite3_sql(mStmt));
+
     int totalCols = sqlite3_column_count(mStmt);
 
     // ensure we set column headers before adding a row
@@ -23,34 +23,52 @@
 #include "common/configuration.h"
 #include "game-server/charactercomponent.h"
 #include "game-server/gamehandler.h"
+#include "game-server/inputlog.h"
 #include "game-server/map.h"
 #include "game-server/mapcomposite.h"
 #include "game-server/mapmanager.h"
 #include "game-server/item.h"
 #include "game-server/itemmanager.h"
+#include "game-server/overloadcontroller.h"
 #include "game-server/postman.h"
 #include "game-server/quest.h"
 #include "game-server/state.h"
 #include "net/messagein.h"
+#include "net/messageschema.h"
 #include "utils/logger.h"
 #include "utils/tokendispenser.h"
 #include "utils/tokencollector.h"
 
-/** Maximum size of sync buffer in bytes. */
+#include <algorithm>
+
+/** Initial maximum size of sync buffer in bytes. */
 const unsigned SYNC_BUFFER_SIZE = 1024;
 
-/** Maximum number of messages in sync buffer. */
+/** Maximum size of sync buffer in bytes when under load. */
+const unsigned SYNC_BUFFER_MAX_SIZE = 16 * 1024;
+
+/** Initial maximum number of messages in sync buffer. */
 const int SYNC_BUFFER_LIMIT = 20;
 
+/** Number of sync batches that may be unacknowledged. */
+const unsigned SYNC_WINDOW = 16;
+
 AccountConnection::AccountConnection():
-    mSyncBuffer(0),
-    mSyncMessages(0)
+    mSyncBuffer(new MessageOut(GAMSG_PLAYER_SYNC)),
+    mSyncMessages(0),
+    mSyncBufferLimit(SYNC_BUFFER_SIZE),
+    mSyncSequence(0),
+    mSyncBackpressure(false),
+    mRegistered(false),
+    mCapabilities(0)
 {
 }
 
 AccountConnection::~AccountConnection()
 {
     delete mSyncBuffer;
+    for (const SyncBatch &batch : mUnacknowledgedSync)
+        delete batch.message;
 }
 
 bool AccountConnection::start(int gameServerPort)
@@ -75,6 +93,7 @@ bool AccountConnection::start(int gameServerPort)
     }
 
     LOG_INFO("Connection established to the account server.");
+    InputLog::recordAccountConnected();
 
     const std::string gameServerName =
         Configuration::getValue("net_gameServerName", std::string());
@@ -92,19 +111,38 @@ bool AccountConnection::start(int gameServerPort)
     msg.writeInt16(gameServerPort);
     msg.writeString(password);
     msg.writeInt32(itemManager->getDatabaseVersion());
+    msg.writeInt16(SUPPORTED_SERVER_CAPABILITIES);
     send(msg);
-
-    // initialize sync buffer
-    if (!mSyncBuffer)
-        mSyncBuffer = new MessageOut(GAMSG_PLAYER_SYNC);
+    mCapabilities = 0;
+    mRegistered = false;
 
     return true;
 }
 
+void AccountConnection::startDetached()
+{
+    Connection::startDetached();
+
+    // The registration is answered by the recorded account server
+    mCapabilities = 0;
+    mRegistered = false;
+}
+
 void AccountConnection::sendCharacterData(Entity *p)
 {
-    MessageOut msg(GAMSG_PLAYER_DATA);
     auto *characterComponent = p->getComponent<CharacterComponent>();
+
+    if (mCapabilities & CAPABILITY_CHARACTER_SNAPSHOTS)
+    {
+        MessageOut msg(GAMSG_PLAYER_SNAPSHOT);
+        msg.writeInt32(characterComponent->getDatabaseID());
+        characterComponent->serializeSnapshot(*p, msg);
+        send(msg);
+        return;
+    }
+
+    MessageOut msg(GAMSG_PLAYER_DATA);
+    msg.setBinaryEncoding(useBinaryEncoding());
     msg.writeInt32(characterComponent->getDatabaseID());
     characterComponent->serialize(*p, msg);
     send(msg);
@@ -113,6 +151,7 @@ void AccountConnection::sendCharacterData(Entity *p)
 void AccountConnection::processMessage(MessageIn &msg)
 {
     LOG_DEBUG("Received message " << msg << " from account server");
+    InputLog::recordAccountMessage(msg);
 
     switch (msg.getId())
     {
@@ -138,8 +177,10 @@ void AccountConnection::processMessage(MessageIn &msg)
                 exit(EXIT_BAD_CONFIG_PARAMETER);
             }
 
-            // read world state variables
-            while (msg.getUnreadLength())
+            // read world state variables. A variable takes at least four
+            // bytes, so fewer remaining bytes are the accepted capabilities,
+            // which older account servers do not send.
+            while (msg.getUnreadLength() >= 4)
             {
                 std::string key = msg.readString();
                 std::string value = msg.readString();
@@ -149,6 +190,31 @@ void AccountConnection::processMessage(MessageIn &msg)
                 }
             }
 
+            mCapabilities = 0;
+            if (msg.getUnreadLength() > 0)
+                mCapabilities = msg.readInt16() & SUPPORTED_SERVER_CAPABILITIES;
+
+            mSyncBuffer->setBinaryEncoding(useBinaryEncoding());
+            mRegistered = true;
+            replaySync();
+        } break;
+
+        case AGMSG_PLAYER_SYNC_ACK:
+        {
+            acknowledgeSync(msg.readInt32());
+        } break;
+
+        case AGMSG_PLAYER_SNAPSHOT_ACK:
+        {
+            const int id = msg.readInt32();
+            const unsigned sequence = msg.readInt32();
+
+            // The character may have left this server in the meantime
+            if (GameClient *client = gameHandler->getClientByDatabaseId(id))
+            {
+                client->character->getComponent<CharacterComponent>()
+                        ->snapshotAcknowledged(sequence);
+            }
         } break;
 
         case AGMSG_PLAYER_ENTER:
@@ -373,15 +439,44 @@ void AccountConnection::sendStatistics()
                     ++nbEntities;
             }
         }
-        msg.writeInt16(nbEntities);
-        msg.writeInt16(nbMonsters);
-        msg.writeInt16(players.size());
+        msg.write(schema::MapStatistics(nbEntities, nbMonsters,
+                                        players.size()));
         for (std::vector< int >::const_iterator j = players.begin(),
              j_end = players.end(); j != j_end; ++j)
         {
-            msg.writeInt32(*j);
+            msg.write(schema::MapPlayer(*j));
         }
     }
+
+    // Map 0 does not exist and ends the map list. Then follows the load of
+    // the server and the traffic per message type since the previous report.
+    msg.writeInt16(0);
+    if (mCapabilities & CAPABILITY_LOAD_STATISTICS)
+    {
+        msg.writeInt16(OverloadController::getLevel());
+        msg.writeInt16(gameHandler->getDeferredLoginCount());
+    }
+    for (int id = 0; id < MESSAGE_ID_SLOTS; ++id)
+    {
+        const MessageStatistics &out =
+                gBandwidth->getMessageStatistics(TRAFFIC_OUTPUT, id);
+        const MessageStatistics &in =
+                gBandwidth->getMessageStatistics(TRAFFIC_INPUT, id);
+        MessageStatistics &reportedOut = mReportedTraffic[TRAFFIC_OUTPUT][id];
+        MessageStatistics &reportedIn = mReportedTraffic[TRAFFIC_INPUT][id];
+
+        if (out.count == reportedOut.count && in.count == reportedIn.count)
+            continue;
+
+        msg.write(schema::MessageTraffic(id,
+                                         out.count - reportedOut.count,
+                                         out.bytes - reportedOut.bytes,
+                                         in.count - reportedIn.count,
+                                         in.bytes - reportedIn.bytes));
+        reportedOut = out;
+        reportedIn = in;
+    }
+
     send(msg);
 }
 
@@ -428,30 +523,122 @@ void AccountConnection::syncChanges(bool force)
     if (mSyncMessages == 0)
         return;
 
+    // Keep the changes until they can be delivered
+    if (!mRegistered || !isConnected())
+        return;
+
     // send buffer if:
     //    a.) forced by any process
     //    b.) every 10 seconds
-    //    c.) buffer reaches size of 1kb
-    //    d.) buffer holds more then 20 messages
-    if (force ||
-        mSyncMessages > SYNC_BUFFER_LIMIT ||
-        mSyncBuffer->getLength() > SYNC_BUFFER_SIZE )
+    //    c.) buffer reaches its size limit
+    //    d.) buffer holds more messages than its message limit
+    const int messageLimit =
+            SYNC_BUFFER_LIMIT * (mSyncBufferLimit / SYNC_BUFFER_SIZE);
+    const bool full = mSyncMessages > messageLimit ||
+                      mSyncBuffer->getLength() > mSyncBufferLimit;
+    if (!force && !full)
+    {
+        LOG_DEBUG("No changes to sync with account server.");
+        return;
+    }
+
+    if (useSequencedSync() && mUnacknowledgedSync.size() >= SYNC_WINDOW)
+    {
+        if (!mSyncBackpressure)
+        {
+            LOG_WARN("The account server falls behind, holding back "
+                     "character changes (" << mUnacknowledgedSync.size()
+                     << " batches unacknowledged).");
+            mSyncBackpressure = true;
+        }
+        return;
+    }
+
+    // Use larger batches while the account server is busy with earlier
+    // ones, and go back to small ones when the load goes down.
+    if (full && !mUnacknowledgedSync.empty())
+    {
+        mSyncBufferLimit = std::min(mSyncBufferLimit * 2,
+                                    SYNC_BUFFER_MAX_SIZE);
+    }
+    else if (!full && mSyncBuffer->getLength() < mSyncBufferLimit / 4)
+    {
+        mSyncBufferLimit = std::max(mSyncBufferLimit / 2, SYNC_BUFFER_SIZE);
+    }
+
+    flushSyncBuffer();
+}
+
+void AccountConnection::flushSyncBuffer()
+{
+    if (useSequencedSync())
+    {
+        LOG_DEBUG("Sending GAMSG_PLAYER_SYNC_SEQUENCED " << mSyncSequence + 1
+                  << " with " << mSyncMessages << " messages.");
+
+        // The sync data follows the sequence number, without the message ID
+        // of the buffer.
+        MessageOut *batch = new MessageOut(GAMSG_PLAYER_SYNC_SEQUENCED);
+        batch->writeInt32(++mSyncSequence);
+        batch->writeData(mSyncBuffer->getData() + 2,
+                         mSyncBuffer->getLength() - 2);
+        send(*batch);
+
+        SyncBatch sent = { mSyncSequence, batch };
+        mUnacknowledgedSync.push_back(sent);
+    }
+    else
     {
         LOG_DEBUG("Sending GAMSG_PLAYER_SYNC with "
                 << mSyncMessages << " messages." );
 
         send(*mSyncBuffer);
-        delete mSyncBuffer;
+    }
 
-        mSyncBuffer = new MessageOut(GAMSG_PLAYER_SYNC);
-        mSyncMessages = 0;
+    delete mSyncBuffer;
+    mSyncBuffer = new MessageOut(GAMSG_PLAYER_SYNC);
+    mSyncBuffer->setBinaryEncoding(useBinaryEncoding());
+    mSyncMessages = 0;
+}
+
+void AccountConnection::acknowledgeSync(unsigned sequence)
+{
+    while (!mUnacknowledgedSync.empty() &&
+           mUnacknowledgedSync.front().sequence <= sequence)
+    {
+        delete mUnacknowledgedSync.front().message;
+        mUnacknowledgedSync.pop_front();
     }
-    else
+
+    if (mSyncBackpressure && mUnacknowledgedSync.size() < SYNC_WINDOW / 2)
     {
-        LOG_DEBUG("No changes to sync with account server.");
+        LOG_INFO("The account server caught up with character changes.");
+        mSyncBackpressure = false;
+        syncChanges(true);
     }
 }
 
+void AccountConnection::replaySync()
+{
+    if (mUnacknowledgedSync.empty())
+        return;
+
+    if (!useSequencedSync())
+    {
+        LOG_WARN("Dropping " << mUnacknowledgedSync.size() << " unacknowledged "
+                 "sync batches, the account server does not support them.");
+        for (const SyncBatch &batch : mUnacknowledgedSync)
+            delete batch.message;
+        mUnacknowledgedSync.clear();
+        return;
+    }
+
+    LOG_INFO("Replaying " << mUnacknowledgedSync.size()
+             << " unacknowledged sync batches.");
+    for (const SyncBatch &batch : mUnacknowledgedSync)
+        send(*batch.message);
+}
+
 void AccountConnection::updateCharacterPoints(int charId, int charPoints,
                                               int corrPoints)
 {
@@ -467,9 +654,18 @@ void AccountConnection::updateAttributes(int charId, int attrId, double base,
                                          double mod)
 {
     ++mSyncMessages;
-    mSyncBuffer->writeInt8(SYNC_CHARACTER_ATTRIBUTE);
-    mSyncBuffer->writeInt32(charId);
-    mSyncBuffer->writeInt32(attrId);
+    if (useBinaryEncoding())
+    {
+        mSyncBuffer->writeInt8(SYNC_CHARACTER_ATTRIBUTE_COMPACT);
+        mSyncBuffer->writeVarInt(charId);
+        mSyncBuffer->writeVarInt(attrId);
+    }
+    else
+    {
+        mSyncBuffer->writeInt8(SYNC_CHARACTER_ATTRIBUTE);
+        mSyncBuffer->writeInt32(charId);
+        mSyncBuffer->writeInt32(attrId);
+    }
     mSyncBuffer->writeDouble(base);
     mSyncBuffer->writeDouble(mod);
     syncChanges();
@@ -21,9 +21,12 @@
 #ifndef ACCOUNTCONNECTION_H
 #define ACCOUNTCONNECTION_H
 
+#include "net/bandwidth.h"
 #include "net/messageout.h"
 #include "net/connection.h"
 
+#include <deque>
+
 class Entity;
 class MapComposite;
 
@@ -42,6 +45,12 @@ class AccountConnection : public Connection
          */
         bool start(int gameServerPort);
 
+        /**
+         * Acts as connected to an account server without networking, used
+         * when replaying recorded input.
+         */
+        void startDetached();
+
         /**
          * Sends data of a given character.
          */
@@ -112,14 +121,39 @@ class AccountConnection : public Connection
          * The sync buffer is sent when:
          * - forced by any process (param force = true)
          * - every 10 seconds
-         * - buffer reaches size of 1kb (SYNC_BUFFER_SIZE)
-         * - buffer holds more then 20 messages (SYNC_BUFFER_LIMIT)
+         * - buffer reaches its size limit, starting at 1kb (SYNC_BUFFER_SIZE)
+         * - buffer holds more messages than its message limit, starting at
+         *   20 messages (SYNC_BUFFER_LIMIT)
+         *
+         * The limits grow while the account server still has batches to
+         * acknowledge, and shrink again when the load goes down.
+         *
+         * When the account server supports it, each batch gets a sequence
+         * number and is kept until the account server acknowledged it, so
+         * it can be replayed after a reconnect. While too many batches are
+         * unacknowledged, changes are held back in the buffer.
+         *
+         * Nothing is sent while not registered with an account server.
          *
          * @param force Send changes even if buffer hasn't reached its size
          *              or message limit. (used to send in timed schedules)
          */
         void syncChanges(bool force = false);
 
+        /**
+         * Returns the number of sync batches the account server did not
+         * acknowledge yet.
+         */
+        unsigned getUnacknowledgedSyncCount() const
+        { return mUnacknowledgedSync.size(); }
+
+        /**
+         * Returns whether sync data is being held back because the account
+         * server falls behind.
+         */
+        bool isSyncBackpressured() const
+        { return mSyncBackpressure; }
+
         /**
          * Write a modification message about character points to the sync
          * buffer.
@@ -176,8 +210,54 @@ class AccountConnection : public Connection
         virtual void processMessage(MessageIn &);
 
     private:
+        /**
+         * Whether the account server accepted the binary encoding of doubles
+         * and the compact sync messages.
+         */
+        bool useBinaryEncoding() const
+        { return mCapabilities & ManaServ::CAPABILITY_BINARY_ENCODING; }
+
+        /**
+         * Whether the account server acknowledges sequenced sync batches.
+         */
+        bool useSequencedSync() const
+        { return mCapabilities & ManaServ::CAPABILITY_SEQUENCED_SYNC; }
+
+        /**
+         * Sends the sync buffer and starts a new one.
+         */
+        void flushSyncBuffer();
+
+        /**
+         * Forgets about the batches up to the given sequence number.
+         */
+        void acknowledgeSync(unsigned sequence);
+
+        /**
+         * Sends the unacknowledged batches again, after a reconnect.
+         */
+        void replaySync();
+
+        /**
+         * A sent sync batch that was not acknowledged yet.
+         */
+        struct SyncBatch
+        {
+            unsigned sequence;
+            MessageOut *message;
+        };
+
         MessageOut* mSyncBuffer;     /**< Message buffer to store sync data. */
         int mSyncMessages;           /**< Number of messages in the sync buffer. */
+        unsigned mSyncBufferLimit;   /**< Current size limit of the buffer. */
+        unsigned mSyncSequence;      /**< Sequence number of the last batch. */
+        std::deque<SyncBatch> mUnacknowledgedSync;
+        bool mSyncBackpressure;      /**< Holding back sync data. */
+        bool mRegistered;            /**< Registered with account server. */
+        int mCapabilities;           /**< Accepted by the account server. */
+
+        /** Message traffic as of the last statistics sent. */
+        MessageStatistics mReportedTraffic[2][MESSAGE_ID_SLOTS];
 };
 
 extern AccountConnection *accountHandler;
@@ -31,7 +31,8 @@ ActorComponent::ActorComponent(Entity &entity):
     mPublicID(65535),
     mSize(0),
     mWalkMask(0),
-    mBlockType(BLOCKTYPE_NONE)
+    mBlockType(BLOCKTYPE_NONE),
+    mSkippedTick(-1)
 {
     entity.signal_removed.connect(
             sigc::mem_fun(this, &ActorComponent::removed));
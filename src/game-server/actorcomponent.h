@@ -116,6 +116,16 @@ class ActorComponent : public Component
         bool isPublicIdValid() const
         { return (mPublicID > 0 && mPublicID != 65535); }
 
+        /**
+         * Marks the update of the actor as skipped in the given tick, see
+         * MapComposite::skipsUpdate().
+         */
+        void setSkippedTick(int tick)
+        { mSkippedTick = tick; }
+
+        int getSkippedTick() const
+        { return mSkippedTick; }
+
         void setWalkMask(unsigned char mask)
         { mWalkMask = mask; }
 
@@ -155,6 +165,8 @@ class ActorComponent : public Component
 
         unsigned char mWalkMask;
         BlockType mBlockType;
+
+        int mSkippedTick;           /**< Last tick the update was skipped. */
 };
 
 #endif // ACTORCOMPONENT_H
@@ -294,13 +294,13 @@ bool Attribute::remove(double value, unsigned layer,
     return false;
 }
 
-bool AttributeModifiersEffect::tick()
+bool AttributeModifiersEffect::tick(int ticks)
 {
     bool ret = false;
     std::list<AttributeModifierState *>::iterator it = mStates.begin();
     while (it != mStates.end())
     {
-        if ((*it)->tick())
+        if ((*it)->tick(ticks))
         {
             double value = (*it)->mValue;
             LOG_DEBUG("Modifier of value " << value << " expiring!");
@@ -344,14 +344,14 @@ Attribute::~Attribute()
 //    }
 }
 
-bool Attribute::tick()
+bool Attribute::tick(int ticks)
 {
     bool ret = false;
     double prev = mBase;
     for (std::vector<AttributeModifiersEffect *>::iterator it = mMods.begin(),
         it_end = mMods.end(); it != it_end; ++it)
     {
-        if ((*it)->tick())
+        if ((*it)->tick(ticks))
         {
             LOG_DEBUG("Attribute layer " << mMods.begin() - it
                       << " has expiring modifiers.");
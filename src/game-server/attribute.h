@@ -37,7 +37,19 @@ class AttributeModifierState
             , mId(id)
         {}
 
-        bool tick() { return mDuration ? !--mDuration : false; }
+        /**
+         * Counts down the duration by the given number of ticks. Returns
+         * whether the modifier expired.
+         */
+        bool tick(int ticks = 1)
+        {
+            if (!mDuration)
+                return false;
+            if (ticks >= mDuration)
+                return true;
+            mDuration -= ticks;
+            return false;
+        }
 
     private:
         /** Number of ticks (0 means permanent, e.g. equipment). */
@@ -98,7 +110,7 @@ class AttributeModifiersEffect
 
         double getCachedModifiedValue() const { return mCacheVal; }
 
-        bool tick();
+        bool tick(int ticks = 1);
 
         /**
          * clearMods() - removes all modifications present in this layer.
@@ -184,8 +196,10 @@ class Attribute
 
         /**
          * tick() processes all timers associated with modifiers for this attribute.
+         * More than one tick is processed at once for beings whose updates
+         * were skipped.
          */
-        bool tick();
+        bool tick(int ticks = 1);
 
     private:
         /**
@@ -18,6 +18,7 @@
  *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cassert>
 
 #include "game-server/being.h"
@@ -28,6 +29,7 @@
 #include "game-server/charactercomponent.h"
 #include "game-server/collisiondetection.h"
 #include "game-server/mapcomposite.h"
+#include "game-server/state.h"
 #include "game-server/effect.h"
 #include "game-server/statuseffect.h"
 #include "game-server/statusmanager.h"
@@ -44,6 +46,8 @@ BeingComponent::BeingComponent(Entity &entity):
     mAction(STAND),
     mGender(GENDER_UNSPECIFIED),
     mDirection(DOWN),
+    mLastUpdateTick(GameState::getCurrentTick()),
+    mUpdateTicks(1),
     mEmoteId(0)
 {
     auto &attributeScope = attributeManager->getAttributeScope(BeingScope);
@@ -197,10 +201,12 @@ void BeingComponent::move(Entity &entity)
     if ((mAction == STAND && mDst == mOld) || mAction == DEAD)
         return;
 
-    if (mMoveTime > WORLD_TICK_MS)
+    const int elapsed = mUpdateTicks * GameState::getTickLength();
+
+    if (mMoveTime > elapsed)
     {
         // Current move has not yet ended
-        mMoveTime -= WORLD_TICK_MS;
+        mMoveTime -= elapsed;
         return;
     }
 
@@ -285,10 +291,10 @@ void BeingComponent::move(Entity &entity)
         pos.x = next.x * tileWidth + (tileWidth / 2);
         pos.y = next.y * tileHeight + (tileHeight / 2);
     }
-    while (mMoveTime < WORLD_TICK_MS);
+    while (mMoveTime < elapsed);
     entity.getComponent<ActorComponent>()->setPosition(entity, pos);
 
-    mMoveTime = mMoveTime > WORLD_TICK_MS ? mMoveTime - WORLD_TICK_MS : 0;
+    mMoveTime = mMoveTime > elapsed ? mMoveTime - elapsed : 0;
 
     // Update the being direction also
     updateDirection(entity, mOld, pos);
@@ -517,6 +523,11 @@ void BeingComponent::setStatusEffectTime(int id, int time)
 
 void BeingComponent::update(Entity &entity)
 {
+    // Catch up with the ticks in which the update was skipped
+    const int tick = GameState::getCurrentTick();
+    mUpdateTicks = std::max(1, tick - mLastUpdateTick);
+    mLastUpdateTick = tick;
+
     auto *hpAttribute = attributeManager->getAttributeInfo(ATTR_HP);
 
     int oldHP = getModifiedAttribute(hpAttribute);
@@ -526,7 +537,10 @@ void BeingComponent::update(Entity &entity)
     // Regenerate HP
     if (mAction != DEAD && mHealthRegenerationTimeout.expired())
     {
-        mHealthRegenerationTimeout.set(TICKS_PER_HP_REGENERATION);
+        // Stay on schedule when the timeout was noticed late
+        mHealthRegenerationTimeout.set(std::max(1,
+                GameState::ticksFromMilliseconds(HP_REGENERATION_INTERVAL) +
+                mHealthRegenerationTimeout.remaining()));
         newHP += getModifiedAttribute(attributeManager->getAttributeInfo(ATTR_HP_REGEN));
     }
     // Cap HP at maximum
@@ -547,7 +561,7 @@ void BeingComponent::update(Entity &entity)
          it != mAttributes.end();
          ++it)
     {
-        if (it->second.tick())
+        if (it->second.tick(mUpdateTicks))
             updateDerivedAttributes(entity, it->first);
     }
 
@@ -555,9 +569,12 @@ void BeingComponent::update(Entity &entity)
     StatusEffects::iterator it = mStatus.begin();
     while (it != mStatus.end())
     {
-        it->second.time--;
-        if (it->second.time > 0 && mAction != DEAD)
-            it->second.status->tick(entity, it->second.time);
+        for (int i = 0; i < mUpdateTicks && it->second.time > 0; ++i)
+        {
+            it->second.time--;
+            if (it->second.time > 0 && mAction != DEAD)
+                it->second.status->tick(entity, it->second.time);
+        }
 
         if (it->second.time <= 0 || mAction == DEAD)
         {
@@ -581,4 +598,5 @@ void BeingComponent::inserted(Entity *entity)
     // Reset the old position, since after insertion it is important that it is
     // in sync with the zone that we're currently present in.
     mOld = entity->getComponent<ActorComponent>()->getPosition();
+    mLastUpdateTick = GameState::getCurrentTick();
 }
@@ -125,7 +125,8 @@ class BeingComponent : public Component
         { return mAction; }
 
         /**
-         * Moves the being toward its destination.
+         * Moves the being toward its destination, as far as it gets in the
+         * ticks covered by the last update.
          */
         void move(Entity &entity);
 
@@ -286,7 +287,8 @@ class BeingComponent : public Component
         void clearHitsTaken();
 
     protected:
-        static const int TICKS_PER_HP_REGENERATION = 100;
+        /** Milliseconds between the regenerations of HP. */
+        static const int HP_REGENERATION_INTERVAL = 10 * 1000;
 
         /** Delay until move to next tile in miliseconds. */
         unsigned short mMoveTime;
@@ -299,7 +301,8 @@ class BeingComponent : public Component
 
     private:
         /**
-         * Connected to signal_inserted to reset the old position.
+         * Connected to signal_inserted to reset the old position and the
+         * tick of the last update.
          */
         void inserted(Entity *);
 
@@ -311,6 +314,14 @@ class BeingComponent : public Component
         /** Time until hp is regenerated again */
         Timeout mHealthRegenerationTimeout;
 
+        /**
+         * Tick of the last update, and the number of ticks it covered. More
+         * than one when the map skipped updates of the being because no
+         * character was near, see MapComposite::skipsUpdate().
+         */
+        int mLastUpdateTick;
+        int mUpdateTicks;
+
         /** The last being emote Id. Used when triggering a being emoticon. */
         int mEmoteId;
 
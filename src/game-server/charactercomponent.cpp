@@ -36,6 +36,7 @@
 #include "scripting/scriptmanager.h"
 #include "net/messagein.h"
 #include "net/messageout.h"
+#include "net/messageschema.h"
 
 #include "utils/logger.h"
 
@@ -76,6 +77,7 @@ CharacterComponent::CharacterComponent(Entity &entity, MessageIn &msg):
     mTransaction(TRANS_NONE),
     mTalkNpcId(0),
     mNpcThread(0),
+    mSnapshotSequence(0),
     mBaseEntity(&entity)
 {
     auto *beingComponent = entity.getComponent<BeingComponent>();
@@ -290,6 +292,147 @@ void CharacterComponent::serialize(Entity &entity, MessageOut &msg)
     }
 }
 
+void CharacterComponent::serializeSnapshot(Entity &entity, MessageOut &msg)
+{
+    msg.writeInt32(++mSnapshotSequence);
+    msg.writeInt8(CHARACTER_SNAPSHOT_VERSION);
+
+    // Every section is serialized, so that it can become the new baseline,
+    // but only the changed ones are sent.
+    int sections = 0;
+    for (int i = 0; i < SNAPSHOT_SECTION_COUNT; ++i)
+    {
+        MessageOut sectionMsg(0);
+        sectionMsg.setBinaryEncoding(true);
+        serializeSnapshotSection(entity, 1 << i, sectionMsg);
+
+        mPendingSnapshot[i].assign(sectionMsg.getData() + 2,
+                                   sectionMsg.getLength() - 2);
+        if (mPendingSnapshot[i] != mAcknowledgedSnapshot[i])
+            sections |= 1 << i;
+    }
+
+    msg.writeInt8(sections);
+    for (int i = 0; i < SNAPSHOT_SECTION_COUNT; ++i)
+    {
+        if (sections & (1 << i))
+            msg.writeData(mPendingSnapshot[i].data(),
+                          mPendingSnapshot[i].size());
+    }
+}
+
+void CharacterComponent::snapshotAcknowledged(unsigned sequence)
+{
+    // An older snapshot may have been acknowledged while a newer one is
+    // underway. Its sections are not known anymore, so the baseline stays
+    // what it was, which only makes the next snapshot larger.
+    if (sequence != mSnapshotSequence)
+        return;
+
+    for (int i = 0; i < SNAPSHOT_SECTION_COUNT; ++i)
+        mAcknowledgedSnapshot[i] = mPendingSnapshot[i];
+}
+
+void CharacterComponent::serializeSnapshotSection(Entity &entity, int section,
+                                                  MessageOut &msg)
+{
+    auto *beingComponent = entity.getComponent<BeingComponent>();
+
+    switch (section)
+    {
+        case SNAPSHOT_GENERAL:
+            msg.writeInt8(getAccountLevel());
+            msg.writeInt8(beingComponent->getGender());
+            msg.writeInt8(getHairStyle());
+            msg.writeInt8(getHairColor());
+            msg.writeInt16(getAttributePoints());
+            msg.writeInt16(getCorrectionPoints());
+            break;
+
+        case SNAPSHOT_ATTRIBUTES:
+        {
+            std::map<unsigned, const Attribute *> attributesToSend;
+            for (auto &attributeIt : beingComponent->getAttributes())
+            {
+                if (attributeIt.first->persistent)
+                {
+                    attributesToSend.insert(std::make_pair(
+                            attributeIt.first->id, &attributeIt.second));
+                }
+            }
+            msg.writeVarInt(attributesToSend.size());
+            for (auto &attributeIt : attributesToSend)
+            {
+                msg.writeVarInt(attributeIt.first);
+                msg.writeDouble(attributeIt.second->getBase());
+                msg.writeDouble(attributeIt.second->getModifiedAttribute());
+            }
+        } break;
+
+        case SNAPSHOT_STATUS:
+        {
+            auto &statusEffects = beingComponent->getStatusEffects();
+            msg.writeVarInt(statusEffects.size());
+            for (auto &statusIt : statusEffects)
+            {
+                msg.writeVarInt(statusIt.first);
+                msg.writeVarInt(statusIt.second.time);
+            }
+        } break;
+
+        case SNAPSHOT_LOCATION:
+        {
+            msg.writeInt16(entity.getMap()->getID());
+            const Point &pos = entity.getComponent<ActorComponent>()->getPosition();
+            msg.writeInt16(pos.x);
+            msg.writeInt16(pos.y);
+        } break;
+
+        case SNAPSHOT_KILLS:
+            msg.writeVarInt(mKillCount.size());
+            for (auto &killCountIt : mKillCount)
+            {
+                msg.writeVarInt(killCountIt.first);
+                msg.writeVarInt(killCountIt.second);
+            }
+            break;
+
+        case SNAPSHOT_ABILITIES:
+        {
+            auto &abilities =
+                    entity.getComponent<AbilityComponent>()->getAbilities();
+            msg.writeVarInt(abilities.size());
+            for (auto &abilityIt : abilities)
+                msg.writeVarInt(abilityIt.first);
+        } break;
+
+        case SNAPSHOT_QUESTS:
+            msg.writeVarInt(mQuestlog.size());
+            for (auto &questlogIt : mQuestlog)
+            {
+                const QuestInfo &quest = questlogIt.second;
+                msg.writeVarInt(quest.id);
+                msg.writeInt8(quest.state);
+                msg.writeString(quest.title);
+                msg.writeString(quest.description);
+            }
+            break;
+
+        case SNAPSHOT_INVENTORY:
+        {
+            const InventoryData &inventoryData = getPossessions().getInventory();
+            msg.writeVarInt(inventoryData.size());
+            for (auto &itemIt : inventoryData)
+            {
+                msg.writeVarInt(itemIt.first);
+                msg.writeVarInt(itemIt.second.itemId);
+                msg.writeVarInt(itemIt.second.amount);
+                msg.writeInt8(itemIt.second.equipmentSlot);
+            }
+        } break;
+    }
+}
+
 void CharacterComponent::characterDied(Entity *being)
 {
     executeCallback(mDeathCallback, *being);
@@ -475,12 +618,29 @@ void CharacterComponent::setBuySell(BuySell *t)
 void CharacterComponent::sendStatus(Entity &entity)
 {
     auto *beingComponent = entity.getComponent<BeingComponent>();
-    MessageOut attribMsg(GPMSG_PLAYER_ATTRIBUTE_CHANGE);
+    const bool compact = mClient &&
+            (mClient->capabilities & CAPABILITY_BINARY_ENCODING);
+    MessageOut attribMsg(compact ? GPMSG_PLAYER_ATTRIBUTE_CHANGE_COMPACT
+                                 : GPMSG_PLAYER_ATTRIBUTE_CHANGE);
+    attribMsg.reserve(mModifiedAttributes.size() *
+                      schema::AttributeChange::size);
     for (AttributeInfo *attribute : mModifiedAttributes)
     {
-        attribMsg.writeInt16(attribute->id);
-        attribMsg.writeInt32(beingComponent->getAttributeBase(attribute) * 256);
-        attribMsg.writeInt32(beingComponent->getModifiedAttribute(attribute) * 256);
+        const int base = beingComponent->getAttributeBase(attribute) * 256;
+        const int modified =
+                beingComponent->getModifiedAttribute(attribute) * 256;
+
+        if (compact)
+        {
+            attribMsg.writeVarInt(attribute->id);
+            attribMsg.writeSignedVarInt(base);
+            attribMsg.writeSignedVarInt(modified);
+        }
+        else
+        {
+            attribMsg.write(schema::AttributeChange(attribute->id,
+                                                    base, modified));
+        }
     }
     if (attribMsg.getLength() > 2)
         gameHandler->sendTo(mClient, attribMsg);
@@ -603,7 +763,7 @@ void CharacterComponent::startNpcThread(Script::Thread *thread, int npcId)
 
 void CharacterComponent::resumeNpcThread()
 {
-    Script *script = ScriptManager::currentState();
+    Script *script = mNpcThread->mScript;
 
     assert(script->getCurrentThread() == mNpcThread);
 
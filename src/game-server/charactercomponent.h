@@ -315,9 +315,24 @@ class CharacterComponent : public Component
 
         void serialize(Entity &entity, MessageOut &msg);
 
+        /**
+         * Writes a snapshot of the character for GAMSG_PLAYER_SNAPSHOT,
+         * holding only the sections that changed since the last snapshot
+         * the account server acknowledged.
+         */
+        void serializeSnapshot(Entity &entity, MessageOut &msg);
+
+        /**
+         * Called when the account server applied the given snapshot.
+         */
+        void snapshotAcknowledged(unsigned sequence);
+
     private:
         void deserialize(Entity &entity, MessageIn &msg);
 
+        void serializeSnapshotSection(Entity &entity, int section,
+                                      MessageOut &msg);
+
         void abilityStatusChanged(int id);
         void abilityCooldownActivated();
 
@@ -371,6 +386,12 @@ class CharacterComponent : public Component
 
         std::map<unsigned, QuestInfo> mQuestlog;
 
+        /** Sections of the last acknowledged snapshot, empty when unknown. */
+        std::string mAcknowledgedSnapshot[SNAPSHOT_SECTION_COUNT];
+        /** Sections of the last snapshot sent. */
+        std::string mPendingSnapshot[SNAPSHOT_SECTION_COUNT];
+        unsigned mSnapshotSequence;  /**< Sequence of the last snapshot sent. */
+
         Entity *mBaseEntity;        /**< The entity this component is part of
                                          this is ONLY required to allow using
                                          the serialization routine without many
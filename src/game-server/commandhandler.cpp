@@ -36,12 +36,14 @@
 #include "game-server/state.h"
 
 #include "scripting/scriptmanager.h"
+#include "scripting/scriptprofiler.h"
 
 #include "common/configuration.h"
 #include "common/permissionmanager.h"
 #include "common/transaction.h"
 
 #include "utils/string.h"
+#include "utils/tracer.h"
 
 struct CmdRef
 {
@@ -87,6 +89,8 @@ static void handleRechargeAbility(Entity*, std::string&);
 static void handleListAbility(Entity*, std::string&);
 static void handleSetAttributePoints(Entity*, std::string&);
 static void handleSetCorrectionPoints(Entity*, std::string&);
+static void handleTrace(Entity*, std::string&);
+static void handleScriptProfile(Entity*, std::string&);
 
 static CmdRef const cmdRef[] =
 {
@@ -170,6 +174,10 @@ static CmdRef const cmdRef[] =
         "Sets the attribute points of a character.", &handleSetAttributePoints},
     {"setcorrectionpoints", "<character> <amount>",
         "Sets the correction points of a character.", &handleSetCorrectionPoints},
+    {"trace", "on|off|dump",
+        "Records server activity and writes it as a Chrome trace", &handleTrace},
+    {"scriptprofile", "on|sample|off|dump|reset",
+        "Measures the time spent in script functions", &handleScriptProfile},
     {nullptr, nullptr, nullptr, nullptr}
 
 };
@@ -415,7 +423,7 @@ static void handleCharWarp(Entity *player, std::string &args)
     else
     {
         // check for valid player
-        other = gameHandler->getCharacterByNameSlow(character);
+        other = gameHandler->getCharacterByName(character);
         if (!other)
         {
             say("Invalid or offline character <" + character + ">.", player);
@@ -518,7 +526,7 @@ static void handleItem(Entity *player, std::string &args)
     else
     {
         // check for valid player
-        other = gameHandler->getCharacterByNameSlow(character);
+        other = gameHandler->getCharacterByName(character);
         if (!other)
         {
             say("Invalid character or they are offline", player);
@@ -657,7 +665,7 @@ static void handleMoney(Entity *player, std::string &args)
     else
     {
         // check for valid player
-        other = gameHandler->getCharacterByNameSlow(character);
+        other = gameHandler->getCharacterByName(character);
         if (!other)
         {
             say("Invalid character or they are offline", player);
@@ -783,7 +791,7 @@ static void handleGoto(Entity *player, std::string &args)
     }
 
     // check for valid player
-    other = gameHandler->getCharacterByNameSlow(character);
+    other = gameHandler->getCharacterByName(character);
     if (!other)
     {
         say("Invalid character, or player is offline.", player);
@@ -820,7 +828,7 @@ static void handleRecall(Entity *player, std::string &args)
     }
 
     // check for valid player
-    other = gameHandler->getCharacterByNameSlow(character);
+    other = gameHandler->getCharacterByName(character);
     if (!other)
     {
         say("Invalid character, or player is offline.", player);
@@ -833,8 +841,12 @@ static void handleRecall(Entity *player, std::string &args)
     GameState::warp(other, map, pos);
 }
 
-static void handleReload(Entity *, std::string &)
+static void handleReload(Entity *player, std::string &)
 {
+    // reload the options, updating the live settings
+    if (!Configuration::reload())
+        say("Failed to reload the configuration file.", player);
+
     // reload the items and monsters
     itemManager->reload();
     monsterManager->reload();
@@ -859,7 +871,7 @@ static void handleBan(Entity *player, std::string &args)
     }
 
     // check for valid player
-    other = gameHandler->getCharacterByNameSlow(character);
+    other = gameHandler->getCharacterByName(character);
     if (!other)
     {
         say("Invalid character", player);
@@ -927,7 +939,7 @@ static void handlePermissions(Entity *player, std::string &args)
         return;
     }
 
-    Entity *other = gameHandler->getCharacterByNameSlow(character);
+    Entity *other = gameHandler->getCharacterByName(character);
     if (!other)
     {
         say("Invalid character", player);
@@ -962,7 +974,7 @@ static void handleGivePermission(Entity *player, std::string &args)
     else
     {
         // check for valid player
-        other = gameHandler->getCharacterByNameSlow(character);
+        other = gameHandler->getCharacterByName(character);
         if (!other)
         {
             say("Invalid character", player);
@@ -1030,7 +1042,7 @@ static void handleTakePermission(Entity *player, std::string &args)
     else
     {
         // check for valid player
-        other = gameHandler->getCharacterByNameSlow(character);
+        other = gameHandler->getCharacterByName(character);
         if (!other)
         {
             say("Invalid character", player);
@@ -1095,7 +1107,7 @@ static void handleAttribute(Entity *player, std::string &args)
     else
     {
         // check for valid player
-        other = gameHandler->getCharacterByNameSlow(character);
+        other = gameHandler->getCharacterByName(character);
         if (!other)
         {
             say("Invalid character", player);
@@ -1224,7 +1236,7 @@ static void handleMute(Entity *player, std::string &args)
 
 
     // Check for a valid player.
-    other = gameHandler->getCharacterByNameSlow(character);
+    other = gameHandler->getCharacterByName(character);
     if (!other)
     {
         say("Invalid character", player);
@@ -1298,7 +1310,7 @@ static void handleKill(Entity *player, std::string &args)
     std::string character = getArgument(args);
 
     // check for valid player
-    other = gameHandler->getCharacterByNameSlow(character);
+    other = gameHandler->getCharacterByName(character);
     if (!other)
     {
         say("Invalid character", player);
@@ -1336,7 +1348,7 @@ static void handleKick(Entity *player, std::string &args)
     std::string character = getArgument(args);
 
     // check for valid player
-    other = gameHandler->getCharacterByNameSlow(character);
+    other = gameHandler->getCharacterByName(character);
     if (!other)
     {
         say("Invalid character", player);
@@ -1516,7 +1528,7 @@ static void handleGetPos(Entity *player, std::string &args)
         return;
     }
     Entity *other;
-    other = gameHandler->getCharacterByNameSlow(character);
+    other = gameHandler->getCharacterByName(character);
     if (!other)
     {
         say("Invalid character, or player is offline.", player);
@@ -1553,7 +1565,7 @@ static void handleEffect(Entity *player, std::string &args)
     else if (arguments.size() == 2)
     {
         int id = utils::stringToInt(arguments[0]);
-        Entity *p = gameHandler->getCharacterByNameSlow(arguments[1]);
+        Entity *p = gameHandler->getCharacterByName(arguments[1]);
         if (!p)
         {
             say("Invalid target player.", player);
@@ -1591,7 +1603,7 @@ static void handleGiveAbility(Entity *player, std::string &args)
     if (character == "#")
         other = player;
     else
-        other = gameHandler->getCharacterByNameSlow(character);
+        other = gameHandler->getCharacterByName(character);
 
     if (!other)
     {
@@ -1628,7 +1640,7 @@ static void handleTakeAbility(Entity *player, std::string &args)
     if (character == "#")
         other = player;
     else
-        other = gameHandler->getCharacterByNameSlow(character);
+        other = gameHandler->getCharacterByName(character);
 
     if (!other)
     {
@@ -1670,7 +1682,7 @@ static void handleRechargeAbility(Entity *player, std::string &args)
     if (character == "#")
         other = player;
     else
-        other = gameHandler->getCharacterByNameSlow(character);
+        other = gameHandler->getCharacterByName(character);
 
     if (!other)
     {
@@ -1709,7 +1721,7 @@ static void handleListAbility(Entity *player, std::string &args)
     if (character == "#")
         other = player;
     else
-        other = gameHandler->getCharacterByNameSlow(character);
+        other = gameHandler->getCharacterByName(character);
 
     if (!other)
     {
@@ -1745,7 +1757,7 @@ static void handleSetAttributePoints(Entity *player, std::string &args)
     if (character == "#")
         other = player;
     else
-        other = gameHandler->getCharacterByNameSlow(character);
+        other = gameHandler->getCharacterByName(character);
 
     if (!other)
     {
@@ -1779,7 +1791,7 @@ static void handleSetCorrectionPoints(Entity *player, std::string &args)
     if (character == "#")
         other = player;
     else
-        other = gameHandler->getCharacterByNameSlow(character);
+        other = gameHandler->getCharacterByName(character);
 
     if (!other)
     {
@@ -1798,6 +1810,85 @@ static void handleSetCorrectionPoints(Entity *player, std::string &args)
     characterComponent->setCorrectionPoints(utils::stringToInt(correctionPoints));
 }
 
+static void handleTrace(Entity *player, std::string &args)
+{
+    std::string action = getArgument(args);
+
+    if (action == "on")
+    {
+        utils::Tracer::setEnabled(true,
+                Configuration::getValue("log_traceBufferSize", 65536));
+        say("Tracing enabled.", player);
+    }
+    else if (action == "off")
+    {
+        utils::Tracer::setEnabled(false);
+        say("Tracing disabled.", player);
+    }
+    else if (action == "dump")
+    {
+        if (utils::Tracer::dump())
+            say("Trace written to " + utils::Tracer::getTraceFile(), player);
+        else
+            say("Unable to write the trace.", player);
+    }
+    else
+    {
+        say("Invalid argument given.", player);
+        say("Usage: @trace on|off|dump", player);
+    }
+}
+
+static void handleScriptProfile(Entity *player, std::string &args)
+{
+    std::string action = getArgument(args);
+
+    if (action == "on")
+    {
+        ScriptProfiler::setEnabled(true);
+        say("Script profiling enabled.", player);
+    }
+    else if (action == "sample")
+    {
+        ScriptProfiler::setEnabled(true, true);
+        say("Script profiling with line sampling enabled.", player);
+    }
+    else if (action == "off")
+    {
+        ScriptProfiler::setEnabled(false);
+        say("Script profiling disabled.", player);
+    }
+    else if (action == "dump")
+    {
+        // The most expensive functions, the dump has all of them
+        for (const ScriptProfiler::Entry &entry :
+             ScriptProfiler::getEntries(5))
+        {
+            std::stringstream str;
+            str << entry.location << ": " << entry.calls << " calls, "
+                << entry.selfTime / 1000 << " us self, "
+                << entry.maxTime / 1000 << " us max";
+            say(str.str(), player);
+        }
+
+        const std::string fileName = ScriptProfiler::dumpStatistics();
+        if (fileName.empty())
+            say("Script profile written to the log.", player);
+        else
+            say("Script profile written to " + fileName, player);
+    }
+    else if (action == "reset")
+    {
+        ScriptProfiler::reset();
+        say("Script profile reset.", player);
+    }
+    else
+    {
+        say("Invalid argument given.", player);
+        say("Usage: @scriptprofile on|sample|off|dump|reset", player);
+    }
+}
+
 void CommandHandler::handleCommand(Entity *player,
                                    const std::string &command)
 {
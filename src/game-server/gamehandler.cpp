@@ -23,23 +23,25 @@
 
 #include "game-server/gamehandler.h"
 
-#include "common/configuration.h"
 #include "common/transaction.h"
 #include "game-server/accountconnection.h"
 #include "game-server/buysell.h"
 #include "game-server/commandhandler.h"
 #include "game-server/emotemanager.h"
+#include "game-server/inputlog.h"
 #include "game-server/inventory.h"
 #include "game-server/item.h"
 #include "game-server/itemmanager.h"
 #include "game-server/map.h"
 #include "game-server/mapcomposite.h"
 #include "game-server/npc.h"
+#include "game-server/overloadcontroller.h"
 #include "game-server/postman.h"
 #include "game-server/state.h"
 #include "game-server/trade.h"
 #include "net/messagein.h"
 #include "net/messageout.h"
+#include "net/messageschema.h"
 #include "net/netcomputer.h"
 #include "utils/logger.h"
 #include "utils/tokendispenser.h"
@@ -59,19 +61,35 @@ bool GameHandler::startListen(enet_uint16 port)
 
 NetComputer *GameHandler::computerConnected(ENetPeer *peer)
 {
-    return new GameClient(peer);
+    GameClient *client = new GameClient(peer);
+    InputLog::recordClientConnected(client);
+    return client;
 }
 
 void GameHandler::computerDisconnected(NetComputer *comp)
 {
+    InputLog::recordClientDisconnected(comp);
+
     GameClient &computer = *static_cast< GameClient * >(comp);
 
     if (computer.status == CLIENT_QUEUED)
     {
         mTokenCollector.deletePendingClient(&computer);
+
+        for (auto it = mDeferredLogins.begin(),
+             it_end = mDeferredLogins.end(); it != it_end; ++it)
+        {
+            if (it->first == &computer)
+            {
+                delete it->second;
+                mDeferredLogins.erase(it);
+                break;
+            }
+        }
     }
     else if (Entity *ch = computer.character)
     {
+        unregisterCharacter(&computer);
         accountHandler->sendCharacterData(ch);
         ch->getComponent<CharacterComponent>()->disconnected(*ch);
         delete ch;
@@ -84,6 +102,7 @@ void GameHandler::detachClient(Entity *ch)
     auto *component = ch->getComponent<CharacterComponent>();
     GameClient *client = component->getClient();
     assert(client);
+    unregisterCharacter(client);
     client->character = nullptr;
     client->status = CLIENT_LOGIN;
     component->setClient(nullptr);
@@ -99,40 +118,28 @@ void GameHandler::prepareServerChange(Entity *ch)
 void GameHandler::completeServerChange(int id, const std::string &token,
                                        const std::string &address, int port)
 {
-    for (NetComputers::const_iterator i = clients.begin(),
-         i_end = clients.end(); i != i_end; ++i)
-    {
-        GameClient *c = static_cast< GameClient * >(*i);
-        if (c->status == CLIENT_CHANGE_SERVER &&
-            c->character->getComponent<CharacterComponent>()
-                ->getDatabaseID() == id)
-        {
-            MessageOut msg(GPMSG_PLAYER_SERVER_CHANGE);
-            msg.writeString(token, MAGIC_TOKEN_LENGTH);
-            msg.writeString(address);
-            msg.writeInt16(port);
-            c->send(msg);
-            c->character->getComponent<CharacterComponent>()->disconnected(
-                    *c->character);
-            delete c->character;
-            c->character = nullptr;
-            c->status = CLIENT_LOGIN;
-            return;
-        }
-    }
+    GameClient *c = getClientByDatabaseId(id);
+    if (!c || c->status != CLIENT_CHANGE_SERVER)
+        return;
+
+    MessageOut msg(GPMSG_PLAYER_SERVER_CHANGE);
+    msg.writeString(token, MAGIC_TOKEN_LENGTH);
+    msg.writeString(address);
+    msg.writeInt16(port);
+    c->send(msg);
+    unregisterCharacter(c);
+    c->character->getComponent<CharacterComponent>()->disconnected(
+            *c->character);
+    delete c->character;
+    c->character = nullptr;
+    c->status = CLIENT_LOGIN;
 }
 
 void GameHandler::updateCharacter(int charid, int partyid)
 {
-    for (NetComputers::const_iterator i = clients.begin(),
-         i_end = clients.end(); i != i_end; ++i)
+    if (GameClient *c = getClientByDatabaseId(charid))
     {
-        GameClient *c = static_cast< GameClient * >(*i);
-        auto *characterComponent =
-                c->character->getComponent<CharacterComponent>();
-
-        if (characterComponent->getDatabaseID() == charid)
-            characterComponent->setParty(partyid);
+        c->character->getComponent<CharacterComponent>()->setParty(partyid);
     }
 }
 
@@ -164,15 +171,24 @@ static Entity *findBeingNear(Entity *p, int id)
 
 static Entity *findCharacterNear(Entity *p, int id)
 {
-    if (Entity *e = findActorNear(p, id))
-        if (e->getType() == OBJECT_CHARACTER)
+    if (Entity *e = gameHandler->getCharacterByPublicId(p->getMap(), id))
+    {
+        const Point &ppos = p->getComponent<ActorComponent>()->getPosition();
+        const Point &epos = e->getComponent<ActorComponent>()->getPosition();
+
+        // See map.h for tiles constants
+        const int pixelDist = DEFAULT_TILE_LENGTH * TILES_TO_BE_NEAR;
+        if (ppos.inRangeOf(epos, pixelDist))
             return e;
+    }
 
     return 0;
 }
 
 void GameHandler::processMessage(NetComputer *computer, MessageIn &message)
 {
+    InputLog::recordClientMessage(computer, message);
+
     GameClient &client = *static_cast<GameClient *>(computer);
 
     if (client.status == CLIENT_LOGIN)
@@ -181,6 +197,16 @@ void GameHandler::processMessage(NetComputer *computer, MessageIn &message)
             return;
 
         std::string magic_token = message.readString(MAGIC_TOKEN_LENGTH);
+
+        // Older clients do not send any capabilities
+        if (message.getUnreadLength() > 0)
+        {
+            client.capabilities = message.readInt16() & SUPPORTED_CAPABILITIES;
+            client.capabilitiesNegotiated = true;
+            client.setCompressionEnabled(
+                    client.capabilities & CAPABILITY_COMPRESSION);
+        }
+
         client.status = CLIENT_QUEUED; // Before the addPendingClient
         mTokenCollector.addPendingClient(magic_token, &client);
         return;
@@ -311,6 +337,7 @@ void GameHandler::sendTo(Entity *beingPtr, MessageOut &msg)
 void GameHandler::sendTo(GameClient *client, MessageOut &msg)
 {
     assert(client && client->status == CLIENT_CONNECTED);
+    client->sendScheduler.consume(msg.getLength());
     client->send(msg);
 }
 
@@ -322,35 +349,30 @@ void GameHandler::addPendingCharacter(const std::string &token, Entity *ch)
 
     int id = ch->getComponent<CharacterComponent>()->getDatabaseID();
 
-    for (NetComputer *i : clients)
+    if (GameClient *c = getClientByDatabaseId(id))
     {
-        GameClient *c = static_cast< GameClient * >(i);
-        Entity *old_ch = c->character;
-        if (old_ch && id == old_ch->getComponent<CharacterComponent>()->getDatabaseID())
+        if (c->status != CLIENT_CONNECTED)
         {
-            if (c->status != CLIENT_CONNECTED)
-            {
-                /* Either the server is confused, or the client is up to no
-                   good. So ignore the request, and wait for the connections
-                   to properly time out. */
-                return;
-            }
+            /* Either the server is confused, or the client is up to no
+               good. So ignore the request, and wait for the connections
+               to properly time out. */
+            return;
+        }
 
-            /* As the connection was not properly closed, the account server
-               has not yet updated its data, so ignore them. Instead, take the
-               already present character, kill its current connection, and make
-               it available for a new connection. */
-            delete ch;
+        /* As the connection was not properly closed, the account server
+           has not yet updated its data, so ignore them. Instead, take the
+           already present character, kill its current connection, and make
+           it available for a new connection. */
+        Entity *old_ch = c->character;
+        delete ch;
 
-            GameState::remove(old_ch);
-            detachClient(old_ch);
-            MessageOut msg(GPMSG_CONNECT_RESPONSE);
-            msg.writeInt8(ERRMSG_LOGIN_WAS_TAKEN_OVER);
-            c->disconnect(msg);
+        GameState::remove(old_ch);
+        detachClient(old_ch);
+        MessageOut msg(GPMSG_CONNECT_RESPONSE);
+        msg.writeInt8(ERRMSG_LOGIN_WAS_TAKEN_OVER);
+        c->disconnect(msg);
 
-            ch = old_ch;
-            break;
-        }
+        ch = old_ch;
     }
 
     // Mark the character as pending a connection.
@@ -358,6 +380,28 @@ void GameHandler::addPendingCharacter(const std::string &token, Entity *ch)
 }
 
 void GameHandler::tokenMatched(GameClient *computer, Entity *character)
+{
+    // Logins enter the world in order
+    if (!mDeferredLogins.empty() || !OverloadController::admitLogin())
+    {
+        mDeferredLogins.push_back(DeferredLogin(computer, character));
+        return;
+    }
+
+    completeLogin(computer, character);
+}
+
+void GameHandler::processDeferredLogins()
+{
+    while (!mDeferredLogins.empty() && OverloadController::admitLogin())
+    {
+        const DeferredLogin login = mDeferredLogins.front();
+        mDeferredLogins.pop_front();
+        completeLogin(login.first, login.second);
+    }
+}
+
+void GameHandler::completeLogin(GameClient *computer, Entity *character)
 {
     computer->character = character;
     computer->status = CLIENT_CONNECTED;
@@ -377,10 +421,14 @@ void GameHandler::tokenMatched(GameClient *computer, Entity *character)
         computer->disconnect(result);
         return;
     }
+    registerCharacter(computer);
+
     // Trigger login script bind
     characterComponent->triggerLoginCallback(*character);
 
     result.writeInt8(ERRMSG_OK);
+    if (computer->capabilitiesNegotiated)
+        result.writeInt16(computer->capabilities);
     computer->send(result);
 
     Inventory(character).sendFull();
@@ -405,31 +453,114 @@ void GameHandler::deletePendingConnect(Entity *character)
     delete character;
 }
 
-Entity *GameHandler::getCharacterByNameSlow(const std::string &name) const
+/**
+ * Public IDs are only unique per map, so the index combines them with the
+ * map ID. Public IDs fit in 16 bits.
+ */
+static int publicIdKey(const MapComposite *map, int publicId)
+{
+    return (map->getID() << 16) | (publicId & 0xffff);
+}
+
+void GameHandler::registerCharacter(GameClient *client)
+{
+    Entity *ch = client->character;
+    auto *characterComponent = ch->getComponent<CharacterComponent>();
+
+    mClientsByName[ch->getComponent<BeingComponent>()->getName()] = client;
+    mClientsByDatabaseId[characterComponent->getDatabaseID()] = client;
+}
+
+/**
+ * Removes the entry for the key from an index, as long as it still refers
+ * to the given client.
+ */
+template<typename Index, typename Key>
+static void eraseIfMatches(Index &index, const Key &key, GameClient *client)
+{
+    typename Index::iterator it = index.find(key);
+    if (it != index.end() && it->second == client)
+        index.erase(it);
+}
+
+void GameHandler::unregisterCharacter(GameClient *client)
 {
-    for (NetComputers::const_iterator i = clients.begin(),
-         i_end = clients.end(); i != i_end; ++i)
+    Entity *ch = client->character;
+    if (!ch)
+        return;
+
+    auto *characterComponent = ch->getComponent<CharacterComponent>();
+    eraseIfMatches(mClientsByName,
+                   ch->getComponent<BeingComponent>()->getName(), client);
+    eraseIfMatches(mClientsByDatabaseId,
+                   characterComponent->getDatabaseID(), client);
+
+    if (ch->getMap())
     {
-        GameClient *c = static_cast< GameClient * >(*i);
-        Entity *ch = c->character;
-        if (ch && ch->getComponent<BeingComponent>()->getName() == name &&
-                c->status == CLIENT_CONNECTED)
-        {
-            return ch;
-        }
+        eraseIfMatches(mClientsByPublicId,
+                       publicIdKey(ch->getMap(),
+                           ch->getComponent<ActorComponent>()->getPublicID()),
+                       client);
     }
-    return 0;
+}
+
+void GameHandler::characterInserted(Entity *ch)
+{
+    GameClient *client = ch->getComponent<CharacterComponent>()->getClient();
+    if (!client || client->character != ch)
+        return;
+
+    const int publicId = ch->getComponent<ActorComponent>()->getPublicID();
+    mClientsByPublicId[publicIdKey(ch->getMap(), publicId)] = client;
+}
+
+void GameHandler::characterRemoved(Entity *ch)
+{
+    GameClient *client = ch->getComponent<CharacterComponent>()->getClient();
+    if (!client)
+        return;
+
+    const int publicId = ch->getComponent<ActorComponent>()->getPublicID();
+    eraseIfMatches(mClientsByPublicId,
+                   publicIdKey(ch->getMap(), publicId), client);
+}
+
+Entity *GameHandler::getCharacterByName(const std::string &name) const
+{
+    ClientsByName::const_iterator it = mClientsByName.find(name);
+    if (it == mClientsByName.end() || it->second->status != CLIENT_CONNECTED)
+        return 0;
+
+    return it->second->character;
+}
+
+GameClient *GameHandler::getClientByDatabaseId(int id) const
+{
+    ClientsById::const_iterator it = mClientsByDatabaseId.find(id);
+    return it != mClientsByDatabaseId.end() ? it->second : 0;
+}
+
+Entity *GameHandler::getCharacterByPublicId(const MapComposite *map,
+                                            int publicId) const
+{
+    ClientsById::const_iterator it =
+            mClientsByPublicId.find(publicIdKey(map, publicId));
+    if (it == mClientsByPublicId.end() || it->second->status != CLIENT_CONNECTED)
+        return 0;
+
+    return it->second->character;
 }
 
 void GameHandler::handleSay(GameClient &client, MessageIn &message)
 {
-    const std::string say = message.readString();
+    // The view is only valid until this message was processed
+    const utils::StringView say = message.readStringView();
     if (say.empty())
         return;
 
     if (say[0] == '@')
     {
-        CommandHandler::handleCommand(client.character, say);
+        CommandHandler::handleCommand(client.character, say.str());
         return;
     }
     if (!client.character->getComponent<CharacterComponent>()->isMuted())
@@ -503,7 +634,7 @@ void GameHandler::handlePickup(GameClient &client, MessageIn &message)
 
                     // We only do this when items are to be kept in memory
                     // between two server restart.
-                    if (!Configuration::getValue("game_floorItemDecayTime", 0))
+                    if (!ItemComponent::getFloorItemLifetime())
                     {
                         // Remove the floor item from map
                         accountHandler->removeFloorItems(map->getID(),
@@ -578,7 +709,7 @@ void GameHandler::handleDrop(GameClient &client, MessageIn &message)
 
         // We store the item in database only when the floor items are meant
         // to be persistent between two server restarts.
-        if (!Configuration::getValue("game_floorItemDecayTime", 0))
+        if (!ItemComponent::getFloorItemLifetime())
         {
             // Create the floor item on map
             accountHandler->createFloorItems(client.character->getMap()->getID(),
@@ -599,10 +730,11 @@ void GameHandler::handleDrop(GameClient &client, MessageIn &message)
 
 void GameHandler::handleWalk(GameClient &client, MessageIn &message)
 {
-    const int x = message.readInt16();
-    const int y = message.readInt16();
+    schema::Walk walk;
+    if (!message.read(walk))
+        return;
 
-    Point dst(x, y);
+    Point dst(walk[0], walk[1]);
     client.character->getComponent<BeingComponent>()->setDestination(
             *client.character, dst);
 }
@@ -759,6 +891,7 @@ void GameHandler::handleDisconnect(GameClient &client, MessageIn &message)
     }
     accountHandler->sendCharacterData(client.character);
 
+    unregisterCharacter(&client);
     characterComponent->disconnected(*client.character);
     delete client.character;
     client.character = 0;
@@ -935,7 +1068,7 @@ void GameHandler::handleNpcPostSend(GameClient &client, MessageIn &message)
 void GameHandler::handlePartyInvite(GameClient &client, MessageIn &message)
 {
     MapComposite *map = client.character->getMap();
-    const int visualRange = Configuration::getValue("game_visualRange", 448);
+    const int visualRange = GameState::getVisualRange();
     std::string invitee = message.readString();
 
     if (invitee == client.character->getComponent<BeingComponent>()->getName())
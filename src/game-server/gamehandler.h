@@ -21,11 +21,17 @@
 #ifndef SERVER_GAMEHANDLER_H
 #define SERVER_GAMEHANDLER_H
 
+#include "game-server/sendscheduler.h"
 #include "net/connectionhandler.h"
 #include "net/netcomputer.h"
+#include "utils/point.h"
 #include "utils/tokencollector.h"
 
+#include <deque>
+#include <unordered_map>
+
 class Entity;
+class MapComposite;
 
 enum
 {
@@ -35,12 +41,33 @@ enum
     CLIENT_QUEUED
 };
 
+/**
+ * What a client was last told about the movement of a being. Used as the
+ * base of the deltas in GPMSG_BEINGS_MOVE_COMPACT. Movement is sent reliably
+ * and in order, so whatever was sent last is also what the client will have
+ * applied by the time it reads the next delta.
+ */
+struct MovementBaseline
+{
+    MovementBaseline() : speed(-1) {}
+    Point destination;
+    int speed;      /**< Last speed sent, or -1 when none was sent yet. */
+};
+
+typedef std::unordered_map<int, MovementBaseline> MovementBaselines;
+
 struct GameClient: NetComputer
 {
     GameClient(ENetPeer *peer)
-      : NetComputer(peer), character(nullptr), status(CLIENT_LOGIN) {}
+      : NetComputer(peer), character(nullptr), status(CLIENT_LOGIN),
+        capabilities(0), capabilitiesNegotiated(false), visualRange(0) {}
     Entity *character;
     int status;
+    int capabilities;               /**< Accepted CAPABILITY_* flags. */
+    bool capabilitiesNegotiated;    /**< Client sent its capabilities. */
+    int visualRange;                /**< Range of the last update, or 0. */
+    MovementBaselines movementBaselines; /**< Indexed by public being id. */
+    SendScheduler sendScheduler;
 };
 
 /**
@@ -90,11 +117,24 @@ class GameHandler: public ConnectionHandler
         void addPendingCharacter(const std::string &token, Entity *);
 
         /**
-         * Combines a client with its character.
+         * Combines a client with its character. While logins are
+         * throttled, the login is deferred instead.
          * (Needed for TokenCollector)
          */
         void tokenMatched(GameClient *computer, Entity *character);
 
+        /**
+         * Lets the deferred logins enter the world, as far as the overload
+         * controller admits them.
+         */
+        void processDeferredLogins();
+
+        /**
+         * Returns the number of logins waiting to enter the world.
+         */
+        unsigned getDeferredLoginCount() const
+        { return mDeferredLogins.size(); }
+
         /**
          * Deletes a pending client's data.
          * (Needed for TokenCollector)
@@ -108,10 +148,41 @@ class GameHandler: public ConnectionHandler
         void deletePendingConnect(Entity *character);
 
         /**
-         * Gets the character associated to a character name. This method is
-         * slow, so it should never be called for regular operations.
+         * Gets the connected character with the given name, or null.
+         */
+        Entity *getCharacterByName(const std::string &) const;
+
+        /**
+         * Gets the client whose character has the given database ID, or
+         * null. The client may be changing server.
          */
-        Entity *getCharacterByNameSlow(const std::string &) const;
+        GameClient *getClientByDatabaseId(int id) const;
+
+        /**
+         * Gets the connected character with the given public ID on the
+         * given map, or null.
+         */
+        Entity *getCharacterByPublicId(const MapComposite *map,
+                                       int publicId) const;
+
+        /**
+         * Updates the public ID index when a character was inserted on a
+         * map or is about to be removed from it. Called by GameState.
+         */
+        void characterInserted(Entity *);
+        void characterRemoved(Entity *);
+
+        /**
+         * Gets the counters of matched and expired connection tokens.
+         */
+        const TokenStatistics &getTokenStatistics() const
+        { return mTokenCollector.getStatistics(); }
+
+        /**
+         * Removes the connection tokens that timed out.
+         */
+        void removeExpiredTokens()
+        { mTokenCollector.removeExpired(); }
 
     protected:
         NetComputer *computerConnected(ENetPeer *);
@@ -159,10 +230,36 @@ class GameHandler: public ConnectionHandler
         void sendNpcError(GameClient &client, int id,
                           const std::string &errorMsg);
 
+        /**
+         * Inserts the character of a matched login into the world.
+         */
+        void completeLogin(GameClient *computer, Entity *character);
+
+        /**
+         * Adds the character of a client to the name and database ID
+         * indices, or removes it from all indices.
+         */
+        void registerCharacter(GameClient *client);
+        void unregisterCharacter(GameClient *client);
+
+        typedef std::unordered_map<std::string, GameClient *> ClientsByName;
+        typedef std::unordered_map<int, GameClient *> ClientsById;
+
+        ClientsByName mClientsByName;
+        ClientsById mClientsByDatabaseId;
+
+        /** Indexed by map ID and public ID, see publicIdKey(). */
+        ClientsById mClientsByPublicId;
+
         /**
          * Container for pending clients and pending connections.
          */
         TokenCollector<GameHandler, GameClient *, Entity *> mTokenCollector;
+
+        typedef std::pair<GameClient *, Entity *> DeferredLogin;
+
+        /** Matched logins waiting to enter the world, oldest first. */
+        std::deque<DeferredLogin> mDeferredLogins;
 };
 
 extern GameHandler *gameHandler;
@@ -0,0 +1,535 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "game-server/inputlog.h"
+
+#include "game-server/accountconnection.h"
+#include "game-server/gamehandler.h"
+#include "game-server/overloadcontroller.h"
+#include "game-server/state.h"
+#include "game-server/tickprofiler.h"
+#include "net/messagein.h"
+#include "net/netcomputer.h"
+#include "utils/logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+#include <zlib.h>
+
+/**
+ * The log starts with a header of the magic bytes, the version, the random
+ * seed and the tick length in milliseconds. Each event follows as the number of ticks since the previous
+ * event, its type, the client it belongs to and the message data or the
+ * overload level, where present. Numbers are stored as LEB128 varints.
+ */
+static const char LOG_MAGIC[4] = { 'M', 'S', 'I', 'L' };
+static const int LOG_VERSION = 3;
+
+/** Ticks between flushes of the log, limiting what a crash loses. */
+static const int FLUSH_INTERVAL = 100;
+
+enum EventType
+{
+    EVENT_CLIENT_CONNECTED = 1,
+    EVENT_CLIENT_MESSAGE,
+    EVENT_CLIENT_DISCONNECTED,
+    EVENT_ACCOUNT_CONNECTED,
+    EVENT_ACCOUNT_MESSAGE,
+    EVENT_ACCOUNT_LOST,
+    EVENT_OVERLOAD_LEVEL,
+    EVENT_END
+};
+
+static gzFile recordFile = nullptr;
+static int currentTick = 0;         /**< Tick of the input being handled. */
+static int lastRecordedTick = 0;    /**< Tick of the last recorded event. */
+
+/** Identifies the clients in the log. */
+static std::unordered_map<const NetComputer *, unsigned> clientIds;
+static unsigned nextClientId = 0;
+
+static void writeVarInt(unsigned value)
+{
+    unsigned char buffer[5];
+    int length = 0;
+    do
+    {
+        buffer[length] = value & 0x7f;
+        value >>= 7;
+        if (value)
+            buffer[length] |= 0x80;
+        ++length;
+    } while (value);
+
+    gzwrite(recordFile, buffer, length);
+}
+
+static void writeEvent(EventType type, int tick = currentTick)
+{
+    // Events are stored in order, even when one was recorded ahead
+    tick = std::max(tick, lastRecordedTick);
+    writeVarInt(tick - lastRecordedTick);
+    gzputc(recordFile, type);
+    lastRecordedTick = tick;
+}
+
+static void writeMessage(const MessageIn &msg)
+{
+    writeVarInt(msg.getLength());
+    gzwrite(recordFile, msg.getData(), msg.getLength());
+}
+
+bool InputLog::startRecording(const std::string &path, unsigned seed)
+{
+    stopRecording();
+
+    // Favour speed over compression ratio, the server is busy enough
+    recordFile = gzopen(path.c_str(), "wb1");
+    if (!recordFile)
+        return false;
+
+    gzwrite(recordFile, LOG_MAGIC, sizeof(LOG_MAGIC));
+    gzputc(recordFile, LOG_VERSION);
+    writeVarInt(seed);
+    writeVarInt(GameState::getTickLength());
+
+    lastRecordedTick = currentTick;
+    clientIds.clear();
+    nextClientId = 0;
+
+    LOG_INFO("Recording the input to " << path);
+    return true;
+}
+
+void InputLog::stopRecording()
+{
+    if (!recordFile)
+        return;
+
+    writeEvent(EVENT_END);
+    gzclose(recordFile);
+    recordFile = nullptr;
+    clientIds.clear();
+}
+
+bool InputLog::isRecording()
+{
+    return recordFile;
+}
+
+void InputLog::startTick(int tick)
+{
+    currentTick = tick;
+
+    if (!recordFile || tick % FLUSH_INTERVAL != 0)
+        return;
+
+    int error;
+    if (gzflush(recordFile, Z_SYNC_FLUSH) != Z_OK)
+    {
+        LOG_ERROR("Stopped recording the input: "
+                  << gzerror(recordFile, &error));
+        gzclose(recordFile);
+        recordFile = nullptr;
+        clientIds.clear();
+    }
+}
+
+void InputLog::recordClientConnected(const NetComputer *computer)
+{
+    if (!recordFile)
+        return;
+
+    const unsigned id = nextClientId++;
+    clientIds[computer] = id;
+    writeEvent(EVENT_CLIENT_CONNECTED);
+    writeVarInt(id);
+}
+
+void InputLog::recordClientMessage(const NetComputer *computer,
+                                   const MessageIn &msg)
+{
+    if (!recordFile)
+        return;
+
+    // Clients connected before the recording started are left out
+    auto it = clientIds.find(computer);
+    if (it == clientIds.end())
+        return;
+
+    writeEvent(EVENT_CLIENT_MESSAGE);
+    writeVarInt(it->second);
+    writeMessage(msg);
+}
+
+void InputLog::recordClientDisconnected(const NetComputer *computer)
+{
+    if (!recordFile)
+        return;
+
+    auto it = clientIds.find(computer);
+    if (it == clientIds.end())
+        return;
+
+    writeEvent(EVENT_CLIENT_DISCONNECTED);
+    writeVarInt(it->second);
+    clientIds.erase(it);
+}
+
+void InputLog::recordAccountConnected()
+{
+    if (recordFile)
+        writeEvent(EVENT_ACCOUNT_CONNECTED);
+}
+
+void InputLog::recordAccountMessage(const MessageIn &msg)
+{
+    if (!recordFile)
+        return;
+
+    writeEvent(EVENT_ACCOUNT_MESSAGE);
+    writeMessage(msg);
+}
+
+void InputLog::recordAccountLost()
+{
+    if (recordFile)
+        writeEvent(EVENT_ACCOUNT_LOST);
+}
+
+void InputLog::recordOverloadLevel(int level)
+{
+    if (!recordFile)
+        return;
+
+    writeEvent(EVENT_OVERLOAD_LEVEL, currentTick + 1);
+    writeVarInt(level);
+}
+
+namespace {
+
+struct Event
+{
+    EventType type;
+    int tick;
+    unsigned client;        /**< Or the overload level. */
+    std::vector<char> data;
+};
+
+/**
+ * Reads the events of a recorded log one by one.
+ */
+class LogReader
+{
+    public:
+        LogReader():
+            mFile(nullptr),
+            mTick(0),
+            mEnded(false)
+        {}
+
+        ~LogReader()
+        {
+            if (mFile)
+                gzclose(mFile);
+        }
+
+        bool open(const std::string &path, unsigned &seed,
+                  unsigned &tickLength)
+        {
+            mFile = gzopen(path.c_str(), "rb");
+            if (!mFile)
+                return false;
+
+            char magic[sizeof(LOG_MAGIC)];
+            return gzread(mFile, magic, sizeof(magic)) == sizeof(magic) &&
+                   memcmp(magic, LOG_MAGIC, sizeof(magic)) == 0 &&
+                   gzgetc(mFile) == LOG_VERSION &&
+                   readVarInt(seed) &&
+                   readVarInt(tickLength);
+        }
+
+        /**
+         * Reads the next event. Returns false at the end of the log.
+         */
+        bool next(Event &event)
+        {
+            unsigned ticks;
+            if (mEnded || !readVarInt(ticks))
+                return false;
+
+            const int type = gzgetc(mFile);
+            if (type < EVENT_CLIENT_CONNECTED || type > EVENT_END)
+                return false;
+
+            mTick += ticks;
+            event.type = static_cast<EventType>(type);
+            event.tick = mTick;
+
+            switch (event.type)
+            {
+                case EVENT_CLIENT_CONNECTED:
+                case EVENT_CLIENT_DISCONNECTED:
+                    return readVarInt(event.client);
+                case EVENT_OVERLOAD_LEVEL:
+                    return readVarInt(event.client) &&
+                           event.client < OVERLOAD_LEVEL_COUNT;
+                case EVENT_CLIENT_MESSAGE:
+                    return readVarInt(event.client) && readData(event.data);
+                case EVENT_ACCOUNT_MESSAGE:
+                    return readData(event.data);
+                case EVENT_END:
+                    mEnded = true;
+                    return true;
+                default:
+                    return true;
+            }
+        }
+
+        /**
+         * Returns whether the end of the log was recorded, which is missing
+         * when the server did not shut down properly.
+         */
+        bool hasEnded() const
+        { return mEnded; }
+
+    private:
+        bool readVarInt(unsigned &value)
+        {
+            value = 0;
+            for (int shift = 0; shift < 35; shift += 7)
+            {
+                const int byte = gzgetc(mFile);
+                if (byte < 0)
+                    return false;
+
+                value |= (byte & 0x7f) << shift;
+                if (!(byte & 0x80))
+                    return true;
+            }
+            return false;
+        }
+
+        bool readData(std::vector<char> &data)
+        {
+            unsigned length;
+            if (!readVarInt(length) || length < 2 || length > 0xffff)
+                return false;
+
+            data.resize(length);
+            return gzread(mFile, &data[0], length) == (int) length;
+        }
+
+        gzFile mFile;
+        int mTick;
+        bool mEnded;
+};
+
+} // anonymous namespace
+
+typedef std::unordered_map<unsigned, NetComputer *> ReplayedClients;
+
+static void replayEvent(const Event &event, ReplayedClients &clients)
+{
+    switch (event.type)
+    {
+        case EVENT_CLIENT_CONNECTED:
+            if (!clients.count(event.client))
+                clients[event.client] = gameHandler->connectDetached();
+            break;
+
+        case EVENT_CLIENT_MESSAGE:
+        {
+            auto it = clients.find(event.client);
+            if (it != clients.end())
+            {
+                MessageIn msg(&event.data[0], event.data.size());
+                gameHandler->processDetached(it->second, msg);
+            }
+        } break;
+
+        case EVENT_CLIENT_DISCONNECTED:
+        {
+            auto it = clients.find(event.client);
+            if (it != clients.end())
+            {
+                gameHandler->disconnectDetached(it->second);
+                clients.erase(it);
+            }
+        } break;
+
+        case EVENT_ACCOUNT_CONNECTED:
+            accountHandler->startDetached();
+            break;
+
+        case EVENT_ACCOUNT_MESSAGE:
+        {
+            MessageIn msg(&event.data[0], event.data.size());
+            accountHandler->processDetached(msg);
+        } break;
+
+        case EVENT_ACCOUNT_LOST:
+            accountHandler->stop();
+            break;
+
+        case EVENT_OVERLOAD_LEVEL:
+            OverloadController::setLevel(
+                    static_cast<OverloadLevel>(event.client));
+            break;
+
+        case EVENT_END:
+            break;
+    }
+}
+
+static bool isAccountEvent(EventType type)
+{
+    return type == EVENT_ACCOUNT_CONNECTED ||
+           type == EVENT_ACCOUNT_MESSAGE ||
+           type == EVENT_ACCOUNT_LOST;
+}
+
+bool InputLog::replay(const std::string &path)
+{
+    LogReader reader;
+    unsigned seed;
+    unsigned tickLength;
+    if (!reader.open(path, seed, tickLength))
+    {
+        LOG_ERROR("Could not read the input recording " << path);
+        return false;
+    }
+
+    // Movement advances by the tick length, so it has to be the same
+    if ((int) tickLength != GameState::getTickLength())
+    {
+        LOG_ERROR("The input was recorded with a tick length of "
+                  << tickLength << " ms, set game_tickLength to match.");
+        return false;
+    }
+
+    LOG_INFO("Replaying the input recorded in " << path);
+    std::srand(seed);
+
+    ReplayedClients clients;
+    unsigned clientEvents = 0;
+    unsigned accountEvents = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    Event event;
+    bool pending = reader.next(event);
+
+    // The input handled before the first tick, like the initial connection
+    // to the account server
+    while (pending && event.tick == 0 && event.type != EVENT_END)
+    {
+        replayEvent(event, clients);
+        ++(isAccountEvent(event.type) ? accountEvents : clientEvents);
+        pending = reader.next(event);
+    }
+
+    const int statisticsInterval = GameState::ticksFromMilliseconds(30 * 1000);
+
+    // Each tick handles its input in the phases the live server does
+    int tick = 0;
+    while (pending && event.type != EVENT_END)
+    {
+        ++tick;
+        TickProfiler::startTick();
+
+        while (pending && event.tick == tick &&
+               event.type == EVENT_OVERLOAD_LEVEL)
+        {
+            replayEvent(event, clients);
+            pending = reader.next(event);
+        }
+
+        bool connectionChanged = false;
+        {
+            TickProfiler::Scope profile(TICK_ACCOUNT);
+            while (pending && event.tick == tick &&
+                   isAccountEvent(event.type))
+            {
+                connectionChanged |= event.type != EVENT_ACCOUNT_MESSAGE;
+                replayEvent(event, clients);
+                ++accountEvents;
+                pending = reader.next(event);
+            }
+        }
+
+        if (!connectionChanged && accountHandler->isConnected())
+        {
+            if (tick % OverloadController::getSyncInterval() == 0)
+                accountHandler->syncChanges(true);
+            if (tick % statisticsInterval == 0)
+                accountHandler->sendStatistics();
+        }
+
+        {
+            TickProfiler::Scope profile(TICK_CLIENTS);
+            while (pending && event.tick == tick && event.type != EVENT_END)
+            {
+                replayEvent(event, clients);
+                ++clientEvents;
+                pending = reader.next(event);
+            }
+            gameHandler->processDeferredLogins();
+        }
+
+        GameState::update(tick);
+
+        TickProfiler::endTick();
+    }
+
+    // Let the recorded ticks without input after the last event pass
+    while (pending && tick < event.tick)
+    {
+        ++tick;
+        TickProfiler::startTick();
+        GameState::update(tick);
+        TickProfiler::endTick();
+    }
+
+    const double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+
+    if (!reader.hasEnded())
+        LOG_WARN("The input recording " << path << " ends unexpectedly.");
+
+    std::cout << "Replayed " << tick << " ticks with " << clientEvents
+              << " client and " << accountEvents << " account server events"
+              << " in " << seconds << " s";
+    if (seconds > 0)
+        std::cout << " (" << tick / seconds << " ticks/s)";
+    std::cout << std::endl;
+
+    if (TickProfiler::isEnabled())
+        TickProfiler::dumpStatistics(std::cout);
+
+    LOG_INFO("Replayed " << tick << " ticks in " << seconds << " s.");
+    return true;
+}
@@ -0,0 +1,96 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef INPUTLOG_H
+#define INPUTLOG_H
+
+#include <string>
+
+class MessageIn;
+class NetComputer;
+
+/**
+ * Records the input of the game server and replays it without networking.
+ *
+ * While recording, every connect, message and disconnect of the game
+ * clients and every message from the account server is written to a gzip
+ * compressed log, along with the tick it was handled in and the seed of the
+ * random number generator. A replay feeds the log back into the game
+ * handler and the account connection in the same order and ticks, as fast
+ * as possible, so that real traffic can be profiled and compared offline.
+ * The overload level is replayed as recorded, since the replay runs at a
+ * different speed than the recorded server.
+ *
+ * The replay is as deterministic as the server itself: scripts reading the
+ * clock and connection tokens expiring by wall time may still diverge.
+ */
+namespace InputLog
+{
+    /**
+     * Starts recording to the given file. The seed is the one the random
+     * number generator was initialized with.
+     */
+    bool startRecording(const std::string &path, unsigned seed);
+
+    /**
+     * Writes the end of the log and closes it.
+     */
+    void stopRecording();
+
+    bool isRecording();
+
+    /**
+     * Sets the tick the following input is handled in.
+     */
+    void startTick(int tick);
+
+    /**
+     * Records the input of a game client.
+     */
+    void recordClientConnected(const NetComputer *computer);
+    void recordClientMessage(const NetComputer *computer,
+                             const MessageIn &msg);
+    void recordClientDisconnected(const NetComputer *computer);
+
+    /**
+     * Records the connection to the account server and its messages.
+     */
+    void recordAccountConnected();
+    void recordAccountMessage(const MessageIn &msg);
+    void recordAccountLost();
+
+    /**
+     * Records a change of the overload level, which takes effect from the
+     * next tick. The replay applies it instead of measuring its own load.
+     */
+    void recordOverloadLevel(int level);
+
+    /**
+     * Replays a recorded log through the game world, with the random number
+     * generator seeded like when it was recorded. Writes a summary of the
+     * replay to the standard output.
+     *
+     * @return false when the log could not be read.
+     */
+    bool replay(const std::string &path);
+}
+
+#endif // INPUTLOG_H
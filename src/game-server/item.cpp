@@ -31,6 +31,10 @@
 #include <map>
 #include <string>
 
+/** Seconds items stay on the floor, or 0 to keep them in the database. */
+static Configuration::Setting<int> floorItemDecayTime(
+        "game_floorItemDecayTime", 0);
+
 bool ItemEffectAttrMod::apply(Entity *itemUser)
 {
     LOG_DEBUG("Applying modifier.");
@@ -135,7 +139,13 @@ ItemComponent::ItemComponent(ItemClass *type, int amount) :
     mType(type),
     mAmount(amount)
 {
-    mLifetime = Configuration::getValue("game_floorItemDecayTime", 0) * 10;
+    mLifetime = getFloorItemLifetime();
+}
+
+int ItemComponent::getFloorItemLifetime()
+{
+    const int seconds = floorItemDecayTime.get();
+    return seconds > 0 ? GameState::ticksFromMilliseconds(seconds * 1000) : 0;
 }
 
 void ItemComponent::update(Entity &entity)
@@ -266,6 +266,13 @@ class ItemComponent : public Component
 
         void update(Entity &entity);
 
+        /**
+         * Returns the number of ticks items stay on the floor, as configured
+         * by game_floorItemDecayTime. When 0, floor items do not decay and
+         * are stored in the database instead.
+         */
+        static int getFloorItemLifetime();
+
     private:
         ItemClass *mType;
         unsigned char mAmount;
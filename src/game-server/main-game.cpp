@@ -27,24 +27,31 @@
 #include "game-server/attributemanager.h"
 #include "game-server/gamehandler.h"
 #include "game-server/emotemanager.h"
+#include "game-server/inputlog.h"
 #include "game-server/itemmanager.h"
 #include "game-server/mapmanager.h"
 #include "game-server/monstermanager.h"
+#include "game-server/overloadcontroller.h"
 #include "game-server/abilitymanager.h"
 #include "game-server/statusmanager.h"
 #include "game-server/postman.h"
+#include "game-server/sendscheduler.h"
 #include "game-server/state.h"
 #include "game-server/settingsmanager.h"
+#include "game-server/tickprofiler.h"
 #include "net/bandwidth.h"
 #include "net/connectionhandler.h"
 #include "net/messageout.h"
+#include "net/netcomputer.h"
 #include "scripting/scriptmanager.h"
 #include "utils/logger.h"
 #include "utils/processorutils.h"
 #include "utils/stringfilter.h"
 #include "utils/timer.h"
+#include "utils/tracer.h"
 #include "utils/mathutils.h"
 
+#include <chrono>
 #include <cstdlib>
 #include <getopt.h>
 #include <iostream>
@@ -64,8 +71,10 @@
 #endif
 
 using utils::Logger;
+using utils::Tracer;
 
 #define DEFAULT_LOG_FILE                    "manaserv-game.log"
+#define DEFAULT_TRACE_FILE                  "manaserv-game.trace.json"
 #define DEFAULT_MAIN_SCRIPT_FILE            "scripts/main.lua"
 
 static int const WORLD_TICK_SKIP = 2; /** tolerance for lagging behind in world calculation) **/
@@ -74,6 +83,10 @@ static int const WORLD_TICK_SKIP = 2; /** tolerance for lagging behind in world
 static utils::Timer worldTimer(WORLD_TICK_MS);
 static int currentTick = 0;     /**< Current world time in ticks */
 static bool running = true;     /**< Whether the server keeps running */
+static unsigned randomSeed;     /**< Seed of the random number generator */
+
+/** File receiving the network statistics, none when empty. */
+static std::string networkStatisticsFile;
 
 utils::StringFilter *stringFilter; /**< Slang's Filter */
 
@@ -103,6 +116,12 @@ static void closeGracefully(int)
     running = false;
 }
 
+/** Callback used when SIGUSR1 signal is received. */
+static void dumpTrace(int)
+{
+    Tracer::requestDump();
+}
+
 static void initializeServer()
 {
     // Used to close via process signals
@@ -111,6 +130,9 @@ static void initializeServer()
 #endif
     signal(SIGINT, closeGracefully);
     signal(SIGTERM, closeGracefully);
+#ifndef _WIN32
+    signal(SIGUSR1, dumpTrace);
+#endif
 
     std::string logFile = Configuration::getValue("log_gameServerFile",
                                                   DEFAULT_LOG_FILE);
@@ -120,6 +142,9 @@ static void initializeServer()
 
     Logger::initialize(logFile);
 
+    Tracer::initialize(Configuration::getValue("log_gameTraceFile",
+                                               DEFAULT_TRACE_FILE));
+
     // --- Initialize the managers
     // Initialize the slang's and double quotes filter.
     stringFilter = new utils::StringFilter;
@@ -132,6 +157,15 @@ static void initializeServer()
 
     PermissionManager::initialize(DEFAULT_PERMISSION_FILE);
 
+    SendScheduler::initialize();
+
+    TickProfiler::initialize();
+
+    OverloadController::initialize();
+
+    networkStatisticsFile =
+            Configuration::getValue("log_gameNetworkStatisticsFile",
+                                    std::string());
 
     std::string mainScript = Configuration::getValue("script_mainFile",
                                                      DEFAULT_MAIN_SCRIPT_FILE);
@@ -144,6 +178,8 @@ static void initializeServer()
     accountHandler = new AccountConnection;
     postMan = new PostMan;
     gBandwidth = new BandwidthMonitor;
+    NetComputer::setCompressionThreshold(
+            Configuration::getValue("net_compressionThreshold", 256));
 
     // --- Initialize enet.
     if (enet_initialize() != 0)
@@ -159,7 +195,8 @@ static void initializeServer()
     utils::processor::init();
 
     // Seed the random number generator
-    std::srand( time(nullptr) );
+    randomSeed = time(nullptr);
+    std::srand(randomSeed);
 }
 
 
@@ -192,6 +229,9 @@ static void deinitializeServer()
     ScriptManager::deinitialize();
 
     PHYSFS_deinit();
+
+    // Write the pending log messages
+    Logger::deinitialize();
 }
 
 
@@ -212,7 +252,11 @@ static void printHelp()
               << "                        - 3. Plus standard information." << std::endl
               << "                        - 4. Plus debugging information." << std::endl
               << "     --port <n>      : Set the default port to listen on."
-              << std::endl;
+              << std::endl
+              << "     --record <path> : Record the input of the server."
+              << std::endl
+              << "     --replay <path> : Replay recorded input without"
+              << " networking and exit." << std::endl;
     exit(EXIT_NORMAL);
 }
 
@@ -232,6 +276,9 @@ struct CommandLineOptions
 
     int port;
     bool portChanged;
+
+    std::string recordPath;
+    std::string replayPath;
 };
 
 /**
@@ -247,6 +294,8 @@ static void parseOptions(int argc, char *argv[], CommandLineOptions &options)
         { "config",     required_argument, 0, 'c' },
         { "verbosity",  required_argument, 0, 'v' },
         { "port",       required_argument, 0, 'p' },
+        { "record",     required_argument, 0, 'r' },
+        { "replay",     required_argument, 0, 'R' },
         { 0, 0, 0, 0 }
     };
 
@@ -277,6 +326,12 @@ static void parseOptions(int argc, char *argv[], CommandLineOptions &options)
                 options.port = atoi(optarg);
                 options.portChanged = true;
                 break;
+            case 'r':
+                options.recordPath = optarg;
+                break;
+            case 'R':
+                options.replayPath = optarg;
+                break;
         }
     }
 }
@@ -298,7 +353,8 @@ int main(int argc, char *argv[])
     }
 
     // Check inter-server password.
-    if (Configuration::getValue("net_password", std::string()).empty())
+    if (options.replayPath.empty() &&
+        Configuration::getValue("net_password", std::string()).empty())
     {
         LOG_FATAL("SECURITY WARNING: 'net_password' not set!");
         exit(EXIT_BAD_CONFIG_PARAMETER);
@@ -341,6 +397,21 @@ int main(int argc, char *argv[])
     bool debugNetwork = Configuration::getBoolValue("net_debugMode", false);
     MessageOut::setDebugModeEnabled(debugNetwork);
 
+    // Replay recorded input instead of serving clients
+    if (!options.replayPath.empty())
+    {
+        const bool replayed = InputLog::replay(options.replayPath);
+        deinitializeServer();
+        return replayed ? EXIT_NORMAL : EXIT_OTHER_EXCEPTION;
+    }
+
+    if (!options.recordPath.empty() &&
+        !InputLog::startRecording(options.recordPath, randomSeed))
+    {
+        LOG_FATAL("Unable to record the input to " << options.recordPath);
+        return EXIT_OTHER_EXCEPTION;
+    }
+
     // Make an initial attempt to connect to the account server
     // Try again after longer and longer intervals when connection fails.
     bool isConnected = false;
@@ -363,13 +434,21 @@ int main(int argc, char *argv[])
     }
 
     // Initialize world timer
+    worldTimer.changeInterval(GameState::getTickLength());
     worldTimer.start();
 
+    // Housekeeping happens at fixed wall clock intervals, whatever the tick
+    const int aliveInterval = GameState::ticksFromMilliseconds(10 * 1000);
+    const int statisticsInterval = GameState::ticksFromMilliseconds(30 * 1000);
+    const int reconnectInterval = GameState::ticksFromMilliseconds(20 * 1000);
+
     // Account connection lost flag
     bool accountServerLost = false;
 
     while (running)
     {
+        Tracer::update();
+
         int elapsedTicks = worldTimer.poll();
 
         if (elapsedTicks == 0)
@@ -381,6 +460,8 @@ int main(int argc, char *argv[])
         if (elapsedTicks > WORLD_TICK_SKIP)
         {
             LOG_WARN("Skipping "<< elapsedTicks - 1 << " ticks.");
+            TickProfiler::logLastTick();
+            OverloadController::ticksSkipped(elapsedTicks - 1);
             elapsedTicks = 1;
         }
 
@@ -389,8 +470,14 @@ int main(int argc, char *argv[])
             currentTick++;
             elapsedTicks--;
 
+            InputLog::startTick(currentTick);
+
+            const auto tickStart = std::chrono::steady_clock::now();
+
+            TickProfiler::startTick();
+
             // Print world time at 10 second intervals to show we're alive
-            if (currentTick % 100 == 0)
+            if (currentTick % aliveInterval == 0)
                 LOG_INFO("World time: " << currentTick);
 
             if (accountHandler->isConnected())
@@ -398,20 +485,46 @@ int main(int argc, char *argv[])
                 accountServerLost = false;
 
                 // Handle all messages that are in the message queues
-                accountHandler->process();
+                {
+                    TickProfiler::Scope profile(TICK_ACCOUNT);
+                    accountHandler->process();
+                }
 
-                if (currentTick % 100 == 0) {
+                // Force sending changes to the account server every 10 secs,
+                // or less often when overloaded.
+                if (currentTick % OverloadController::getSyncInterval() == 0)
                     accountHandler->syncChanges(true);
-                    // force sending changes to the account server every 10 secs.
-                }
 
-                if (currentTick % 300 == 0)
+                if (currentTick % statisticsInterval == 0)
                 {
                     accountHandler->sendStatistics();
                     LOG_INFO("Total Account Output: " << gBandwidth->totalInterServerOut() << " Bytes");
                     LOG_INFO("Total Account Input: " << gBandwidth->totalInterServerIn() << " Bytes");
                     LOG_INFO("Total Client Output: " << gBandwidth->totalClientOut() << " Bytes");
                     LOG_INFO("Total Client Input: " << gBandwidth->totalClientIn() << " Bytes");
+                    LOG_INFO("Total Client Output Compressed: "
+                             << gBandwidth->totalUncompressedOut() << " -> "
+                             << gBandwidth->totalCompressedOut() << " Bytes");
+                    LOG_INFO("Deferred Client Updates: " << SendScheduler::getTotalDeferred());
+
+                    const TokenStatistics &tokens =
+                            gameHandler->getTokenStatistics();
+                    LOG_INFO("Tokens Matched: " << tokens.matched
+                             << " (max latency " << tokens.maxMatchLatency
+                             << " ms), Expired: " << tokens.expiredClients
+                             << " clients, " << tokens.expiredConnects
+                             << " characters");
+                    LOG_INFO("Overload Level: " << OverloadController::getLevel()
+                             << " (" << OverloadController::getLevelName(
+                                     OverloadController::getLevel())
+                             << "), Deferred Logins: "
+                             << gameHandler->getDeferredLoginCount());
+                    LOG_INFO("Dropped Log Messages: "
+                             << Logger::getDroppedMessages());
+                    LOG_INFO("Unacknowledged Sync Batches: "
+                             << accountHandler->getUnacknowledgedSyncCount()
+                             << (accountHandler->isSyncBackpressured()
+                                 ? " (holding back changes)" : ""));
                 }
             }
             else
@@ -421,26 +534,62 @@ int main(int argc, char *argv[])
                 if (!accountServerLost)
                 {
                     LOG_WARN("The connection to the account server was lost.");
+                    InputLog::recordAccountLost();
                     accountServerLost = true;
                 }
 
-                // Try to reconnect every 200 ticks
-                if (currentTick % 200 == 0)
+                // Try to reconnect every 20 seconds
+                if (currentTick % reconnectInterval == 0)
                 {
                     accountHandler->start(options.port);
                 }
             }
-            gameHandler->process();
+
+            if (currentTick % statisticsInterval == 0 &&
+                !networkStatisticsFile.empty())
+                gBandwidth->dumpStatistics(networkStatisticsFile);
+
+            if (currentTick % statisticsInterval == 0)
+            {
+                TickProfiler::dumpStatistics();
+
+                const utils::Histogram &lateness = worldTimer.getLateness();
+                LOG_INFO("Tick Jitter: mean " << lateness.getMean()
+                         << " us, 99% " << lateness.getPercentile(99)
+                         << " us, max " << lateness.getMax() << " us ("
+                         << GameState::getTickLength() << " ms ticks)");
+                worldTimer.resetLateness();
+
+                LOG_INFO("Scheduled Script Jobs: "
+                         << ScriptManager::getScheduledJobCount());
+            }
+
+            {
+                TickProfiler::Scope profile(TICK_CLIENTS);
+                gameHandler->process();
+                gameHandler->processDeferredLogins();
+                gameHandler->removeExpiredTokens();
+            }
             // Update all active objects/beings
             GameState::update(currentTick);
             // Send potentially urgent outgoing messages
-            gameHandler->flush();
+            {
+                TickProfiler::Scope profile(TICK_FLUSH);
+                gameHandler->flush();
+            }
+
+            TickProfiler::endTick();
+
+            using namespace std::chrono;
+            OverloadController::tickFinished(duration_cast<microseconds>(
+                    steady_clock::now() - tickStart).count());
         }
     }
 
     LOG_INFO("Received: Quit signal, closing down...");
     gameHandler->stopListen();
     accountHandler->stop();
+    InputLog::stopRecording();
     deinitializeServer();
 
     return EXIT_NORMAL;
@@ -31,7 +31,10 @@
 #include "game-server/mapmanager.h"
 #include "game-server/mapreader.h"
 #include "game-server/monstermanager.h"
+#include "game-server/overloadcontroller.h"
 #include "game-server/spawnareacomponent.h"
+#include "game-server/state.h"
+#include "game-server/tickprofiler.h"
 #include "game-server/triggerareacomponent.h"
 #include "scripting/script.h"
 #include "scripting/scriptmanager.h"
@@ -150,12 +153,21 @@ bool ObjectBucket::isAllocated(int i) const
    in dealing with zone changes. */
 static int const zoneDiam = 256;
 
+/** Ticks between the updates of beings out of sight of all characters. */
+static Configuration::Setting<int> lodInterval("game_lodInterval", 4);
+
+/** Larger intervals would make the catching up of unseen beings too coarse. */
+static const int MAX_LOD_INTERVAL = 20;
+
 /**
  * Part of a map.
  */
 struct MapZone
 {
     unsigned short nbCharacters, nbMovingObjects;
+
+    /** Whether a character is close enough to see into this zone. */
+    bool watched;
     /**
      * Objects present in this zone.
      * Characters are stored first, then the remaining MovingObjects, then the
@@ -170,7 +182,7 @@ struct MapZone
      */
     MapRegion destinations;
 
-    MapZone(): nbCharacters(0), nbMovingObjects(0) {}
+    MapZone(): nbCharacters(0), nbMovingObjects(0), watched(true) {}
     void insert(Entity *);
     void remove(Entity *);
 };
@@ -302,6 +314,12 @@ struct MapContent
      */
     MapZone &getZone(const Point &pos) const;
 
+    /**
+     * Marks the zones within the given range of a zone with characters as
+     * watched.
+     */
+    void updateWatchedZones(int radius);
+
     /**
      * Entities (items, characters, monsters, etc) located on the map.
      */
@@ -456,6 +474,31 @@ MapZone& MapContent::getZone(const Point &pos) const
     return zones[(pos.x / zoneDiam) + (pos.y / zoneDiam) * mapWidth];
 }
 
+void MapContent::updateWatchedZones(int radius)
+{
+    const int zoneCount = mapWidth * mapHeight;
+    for (int i = 0; i < zoneCount; ++i)
+        zones[i].watched = false;
+
+    const int range = (radius + zoneDiam - 1) / zoneDiam;
+    for (int y = 0; y < mapHeight; ++y)
+    {
+        for (int x = 0; x < mapWidth; ++x)
+        {
+            if (!zones[x + y * mapWidth].nbCharacters)
+                continue;
+
+            const int ax = std::max(x - range, 0),
+                      ay = std::max(y - range, 0),
+                      bx = std::min(x + range, mapWidth - 1),
+                      by = std::min(y + range, mapHeight - 1);
+            for (int wy = ay; wy <= by; ++wy)
+                for (int wx = ax; wx <= bx; ++wx)
+                    zones[wx + wy * mapWidth].watched = true;
+        }
+    }
+}
+
 
 /******************************************************************************
  * ZoneIterator
@@ -587,7 +630,6 @@ void ActorIterator::operator++()
  * MapComposite
  *****************************************************************************/
 
-Script::Ref MapComposite::mInitializeCallback;
 Script::Ref MapComposite::mUpdateCallback;
 
 MapComposite::MapComposite(int id, const std::string &name):
@@ -596,6 +638,8 @@ MapComposite::MapComposite(int id, const std::string &name):
     mContent(0),
     mName(name),
     mID(id),
+    mUpdateTick(0),
+    mLodInterval(1),
     mPvPRules(PVP_NONE)
 {
 }
@@ -634,16 +678,7 @@ bool MapComposite::activate()
 
     mActive = true;
 
-    if (!mInitializeCallback.isValid())
-    {
-        LOG_WARN("No callback for map initialization found");
-    }
-    else
-    {
-        Script *s = ScriptManager::currentState();
-        s->prepare(mInitializeCallback);
-        s->execute(this);
-    }
+    ScriptManager::getState(this)->initializeMap(this);
 
     return true;
 }
@@ -747,12 +782,38 @@ Entity *MapComposite::findEntityById(int publicId) const
 
 void MapComposite::update()
 {
-    // Update object status
+    TickProfiler::Scope profile(TICK_MAP_UPDATE, mID);
+
+    // Find the zones characters can see into. One zone is added to the
+    // visual range, so beings walking in from afar are updated every tick
+    // before they come into sight.
+    mUpdateTick = GameState::getCurrentTick();
+    mLodInterval = std::max(1, (int) lodInterval);
+    if (mLodInterval > 1)
+        mLodInterval *= OverloadController::getUnseenUpdateFactor();
+    mLodInterval = std::min(mLodInterval, MAX_LOD_INTERVAL);
     const std::vector< Entity * > &entities = getEverything();
+    if (mLodInterval > 1)
+    {
+        mContent->updateWatchedZones(GameState::getVisualRange() + zoneDiam);
+
+        // Decided once before anything moves, so a being leaving the watched
+        // zones is still moved and transferred between zones in this tick
+        for (std::vector< Entity * >::const_iterator it = entities.begin(),
+             it_end = entities.end(); it != it_end; ++it)
+        {
+            if (isUpdateDeferred(*it))
+                (*it)->getComponent<ActorComponent>()->setSkippedTick(
+                        mUpdateTick);
+        }
+    }
+
+    // Update object status
     for (std::vector< Entity * >::const_iterator it = entities.begin(),
          it_end = entities.end(); it != it_end; ++it)
     {
-        (*it)->update();
+        if (!skipsUpdate(*it))
+            (*it)->update();
     }
 
     if (mUpdateCallback.isValid())
@@ -764,11 +825,14 @@ void MapComposite::update()
     }
 
     // Move objects around and update zones.
+    profile.enter(TICK_MOVEMENT);
     for (BeingIterator it(getWholeMapIterator()); it; ++it)
     {
-        (*it)->getComponent<BeingComponent>()->move(**it);
+        if (!skipsUpdate(*it))
+            (*it)->getComponent<BeingComponent>()->move(**it);
     }
 
+    profile.enter(TICK_ZONES);
     for (int i = 0; i < mContent->mapHeight * mContent->mapWidth; ++i)
     {
         mContent->zones[i].destinations.clear();
@@ -778,7 +842,8 @@ void MapComposite::update()
     for (std::vector< Entity * >::iterator i = mContent->entities.begin(),
          i_end = mContent->entities.end(); i != i_end; ++i)
     {
-        if (!(*i)->canMove())
+        // Beings whose update was skipped did not move
+        if (!(*i)->canMove() || skipsUpdate(*i))
             continue;
 
         const Point &pos1 =
@@ -797,6 +862,26 @@ void MapComposite::update()
     }
 }
 
+bool MapComposite::skipsUpdate(const Entity *entity) const
+{
+    return mLodInterval > 1 && entity->canMove() &&
+           entity->getComponent<ActorComponent>()->getSkippedTick() ==
+                   mUpdateTick;
+}
+
+bool MapComposite::isUpdateDeferred(const Entity *entity) const
+{
+    if (!entity->canMove() || entity->getType() == OBJECT_CHARACTER)
+        return false;
+
+    auto *actorComponent = entity->getComponent<ActorComponent>();
+    if (mContent->getZone(actorComponent->getPosition()).watched)
+        return false;
+
+    // Spread the updates of unseen beings over the ticks
+    return (mUpdateTick + actorComponent->getPublicID()) % mLodInterval != 0;
+}
+
 const std::vector< Entity * > &MapComposite::getEverything() const
 {
     return mContent->entities;
@@ -831,7 +916,7 @@ static void callVariableCallback(Script::Ref &function, const std::string &key,
 {
     if (function.isValid())
     {
-        Script *s = ScriptManager::currentState();
+        Script *s = ScriptManager::getState(map);
         s->prepare(function);
         s->push(key);
         s->push(value);
@@ -1063,7 +1148,7 @@ void MapComposite::initializeContent()
 
             if (npcId && !scriptText.empty())
             {
-                Script *script = ScriptManager::currentState();
+                Script *script = ScriptManager::getState(this);
                 script->loadNPC(object->getName(), npcId,
                                 ManaServ::getGender(gender),
                                 object->getX(), object->getY(),
@@ -1079,7 +1164,7 @@ void MapComposite::initializeContent()
             std::string scriptFilename = object->getProperty("FILENAME");
             std::string scriptText = object->getProperty("TEXT");
 
-            Script *script = ScriptManager::currentState();
+            Script *script = ScriptManager::getState(this);
             Script::Context context;
             context.map = this;
 
@@ -191,6 +191,17 @@ class MapComposite
          */
         void update();
 
+        /**
+         * Returns whether the update of the being is skipped in the current
+         * tick. Beings out of sight of all characters are only updated
+         * every game_lodInterval ticks, and catch up with the missed ticks
+         * then. Always false for characters and other entities.
+         *
+         * Decided once at the start of update(), so the answer stays the
+         * same for the rest of the tick even when the being moves.
+         */
+        bool skipsUpdate(const Entity *entity) const;
+
         /**
          * Gets the PvP rules on the map.
          */
@@ -262,9 +273,6 @@ class MapComposite
         void callWorldVariableCallback(const std::string &key,
                                        const std::string &value);
 
-        static void setInitializeCallback(Script *script)
-        { script->assignCallback(mInitializeCallback); }
-
         static void setUpdateCallback(Script *script)
         { script->assignCallback(mUpdateCallback); }
 
@@ -273,6 +281,12 @@ class MapComposite
 
     private:
         void initializeContent();
+
+        /**
+         * Returns whether the update of the being should be skipped in the
+         * current tick, given where it stands now.
+         */
+        bool isUpdateDeferred(const Entity *entity) const;
         void callMapVariableCallback(const std::string &key,
                                      const std::string &value);
 
@@ -281,13 +295,14 @@ class MapComposite
         MapContent *mContent; /**< Entities on the map. */
         std::string mName;    /**< Name of the map. */
         unsigned short mID;   /**< ID of the map. */
+        int mUpdateTick;      /**< Tick of the last update. */
+        int mLodInterval;     /**< Ticks between updates of unseen beings. */
         /** Cached persistent variables */
         std::map<std::string, std::string> mScriptVariables;
         PvPRules mPvPRules;
         std::map<const std::string, Script::Ref> mMapVariableCallbacks;
         std::map<const std::string, Script::Ref> mWorldVariableCallbacks;
 
-        static Script::Ref mInitializeCallback;
         static Script::Ref mUpdateCallback;
 };
 
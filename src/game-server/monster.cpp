@@ -113,6 +113,6 @@ void MonsterComponent::update(Entity &entity)
 
 void MonsterComponent::monsterDied(Entity *monster)
 {
-    mDecayTimeout.set(DECAY_TIME);
+    mDecayTimeout.set(GameState::ticksFromMilliseconds(DECAY_TIME));
 }
 
@@ -181,7 +181,8 @@ class MonsterComponent : public Component
         void monsterDied(Entity *monster);
 
     private:
-        static const int DECAY_TIME = 50;
+        /** Milliseconds a dead monster stays before it is removed. */
+        static const int DECAY_TIME = 5 * 1000;
 
         MonsterClass *mSpecy;
 
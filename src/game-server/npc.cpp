@@ -26,19 +26,18 @@
 #include "game-server/map.h"
 #include "net/messageout.h"
 #include "scripting/script.h"
-#include "scripting/scriptmanager.h"
 
-NpcComponent::NpcComponent(int npcId):
+NpcComponent::NpcComponent(int npcId, Script *script):
     mNpcId(npcId),
-    mEnabled(true)
+    mEnabled(true),
+    mScript(script)
 {
 }
 
 NpcComponent::~NpcComponent()
 {
-    Script *script = ScriptManager::currentState();
-    script->unref(mTalkCallback);
-    script->unref(mUpdateCallback);
+    mScript->unref(mTalkCallback);
+    mScript->unref(mUpdateCallback);
 }
 
 void NpcComponent::setEnabled(bool enabled)
@@ -51,21 +50,20 @@ void NpcComponent::update(Entity &entity)
     if (!mEnabled || !mUpdateCallback.isValid())
         return;
 
-    Script *script = ScriptManager::currentState();
-    script->prepare(mUpdateCallback);
-    script->push(&entity);
-    script->execute(entity.getMap());
+    mScript->prepare(mUpdateCallback);
+    mScript->push(&entity);
+    mScript->execute(entity.getMap());
 }
 
 void NpcComponent::setTalkCallback(Script::Ref function)
 {
-    ScriptManager::currentState()->unref(mTalkCallback);
+    mScript->unref(mTalkCallback);
     mTalkCallback = function;
 }
 
 void NpcComponent::setUpdateCallback(Script::Ref function)
 {
-    ScriptManager::currentState()->unref(mUpdateCallback);
+    mScript->unref(mUpdateCallback);
     mUpdateCallback = function;
 }
 
@@ -78,7 +76,7 @@ static Script *prepareResume(Entity *ch, Script::ThreadState expectedState)
     if (!thread || thread->mState != expectedState)
         return 0;
 
-    Script *script = ScriptManager::currentState();
+    Script *script = thread->mScript;
     script->prepareResume(thread);
     return script;
 }
@@ -87,7 +85,7 @@ void Npc::start(Entity *npc, Entity *ch)
 {
     NpcComponent *npcComponent = npc->getComponent<NpcComponent>();
 
-    Script *script = ScriptManager::currentState();
+    Script *script = npcComponent->getScript();
     Script::Ref talkCallback = npcComponent->getTalkCallback();
 
     if (npcComponent->isEnabled() && talkCallback.isValid())
@@ -0,0 +1,193 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "game-server/overloadcontroller.h"
+
+#include "common/configuration.h"
+#include "game-server/inputlog.h"
+#include "game-server/state.h"
+#include "utils/logger.h"
+
+#include <algorithm>
+
+static Configuration::Setting<int> overloadThreshold(
+        "game_overloadThreshold", 80);
+static Configuration::Setting<int> recoveryThreshold(
+        "game_overloadRecoveryThreshold", 50);
+
+/** Milliseconds the load has to stay high before the next level is
+    entered. */
+static const int ESCALATION_TIME = 1000;
+
+/** Milliseconds the load has to stay low before a level is left. */
+static const int RECOVERY_TIME = 10 * 1000;
+
+/** Milliseconds between logins admitted while logins are throttled. */
+static const int LOGIN_INTERVAL = 500;
+
+/** Milliseconds between the forced account syncs, normally and under load. */
+static const int SYNC_INTERVAL = 10 * 1000;
+static const int DEFERRED_SYNC_INTERVAL = 30 * 1000;
+
+static const char *levelNames[OVERLOAD_LEVEL_COUNT] =
+{
+    "none",
+    "reduced visual range",
+    "fewer updates of unseen beings",
+    "deferred account sync",
+    "throttled logins"
+};
+
+static OverloadLevel level = OVERLOAD_NONE;
+
+/** Moving average of the tick durations in microseconds. */
+static unsigned averageTickTime = 0;
+
+/** Consecutive ticks with a high or a low average. */
+static int highTicks = 0;
+static int lowTicks = 0;
+
+static int lastChangeTick = 0;          /**< Tick of the last level change. */
+static int lastLoginTick = 0;           /**< Tick of the last admitted login. */
+
+static void changeLevel(OverloadLevel newLevel)
+{
+    if (newLevel > level)
+        LOG_WARN("Game server overloaded, entering overload level "
+                 << newLevel << ": " << levelNames[newLevel] << ".");
+    else
+        LOG_INFO("Game server load went down, returning to overload level "
+                 << newLevel << ": " << levelNames[newLevel] << ".");
+
+    OverloadController::setLevel(newLevel);
+
+    // The new level takes effect from the next tick
+    InputLog::recordOverloadLevel(newLevel);
+}
+
+void OverloadController::initialize()
+{
+    if (overloadThreshold <= 0)
+        LOG_INFO("Overload control disabled.");
+}
+
+void OverloadController::tickFinished(unsigned microseconds)
+{
+    const int threshold = overloadThreshold;
+    if (threshold <= 0)
+    {
+        if (level != OVERLOAD_NONE)
+            changeLevel(OVERLOAD_NONE);
+        return;
+    }
+
+    // Average over roughly the last eight ticks
+    averageTickTime = averageTickTime - averageTickTime / 8 + microseconds / 8;
+
+    const unsigned tickLength = GameState::getTickLength() * 1000;
+    const unsigned high = tickLength / 100 * threshold;
+    const unsigned low = tickLength / 100 *
+            std::min<int>(recoveryThreshold, threshold);
+
+    if (averageTickTime > high)
+    {
+        lowTicks = 0;
+        if (++highTicks >= GameState::ticksFromMilliseconds(ESCALATION_TIME) &&
+            level < OVERLOAD_LOGINS)
+            changeLevel(static_cast<OverloadLevel>(level + 1));
+    }
+    else if (averageTickTime < low)
+    {
+        highTicks = 0;
+        if (++lowTicks >= GameState::ticksFromMilliseconds(RECOVERY_TIME) &&
+            level > OVERLOAD_NONE)
+            changeLevel(static_cast<OverloadLevel>(level - 1));
+    }
+    else
+    {
+        highTicks = 0;
+        lowTicks = 0;
+    }
+}
+
+void OverloadController::ticksSkipped(int count)
+{
+    if (count <= 0 || overloadThreshold <= 0 || level == OVERLOAD_LOGINS)
+        return;
+
+    // Falling behind is worse than any average, so act at once, but give
+    // the previous level some time to take effect
+    if (GameState::getCurrentTick() - lastChangeTick <
+            GameState::ticksFromMilliseconds(ESCALATION_TIME))
+        return;
+
+    changeLevel(static_cast<OverloadLevel>(level + 1));
+}
+
+OverloadLevel OverloadController::getLevel()
+{
+    return level;
+}
+
+void OverloadController::setLevel(OverloadLevel newLevel)
+{
+    level = newLevel;
+    lastChangeTick = GameState::getCurrentTick();
+    highTicks = 0;
+    lowTicks = 0;
+}
+
+const char *OverloadController::getLevelName(OverloadLevel level)
+{
+    return levelNames[level];
+}
+
+int OverloadController::getVisualRange(int visualRange)
+{
+    if (level >= OVERLOAD_LOGINS)
+        return visualRange / 2;
+    if (level >= OVERLOAD_VISUAL_RANGE)
+        return visualRange * 3 / 4;
+    return visualRange;
+}
+
+int OverloadController::getUnseenUpdateFactor()
+{
+    return level >= OVERLOAD_UNSEEN_BEINGS ? 2 : 1;
+}
+
+int OverloadController::getSyncInterval()
+{
+    return GameState::ticksFromMilliseconds(
+            level >= OVERLOAD_ACCOUNT_SYNC ? DEFERRED_SYNC_INTERVAL
+                                           : SYNC_INTERVAL);
+}
+
+bool OverloadController::admitLogin()
+{
+    const int tick = GameState::getCurrentTick();
+    if (level >= OVERLOAD_LOGINS &&
+        tick - lastLoginTick < GameState::ticksFromMilliseconds(LOGIN_INTERVAL))
+        return false;
+
+    lastLoginTick = tick;
+    return true;
+}
@@ -0,0 +1,109 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef OVERLOADCONTROLLER_H
+#define OVERLOADCONTROLLER_H
+
+/**
+ * How far the game server degrades its service to keep up with its ticks.
+ * Each level also applies the measures of the levels below it.
+ */
+enum OverloadLevel
+{
+    OVERLOAD_NONE,
+    OVERLOAD_VISUAL_RANGE,  /**< Characters see three quarters as far. */
+    OVERLOAD_UNSEEN_BEINGS, /**< Beings out of sight are updated half as
+                                 often. */
+    OVERLOAD_ACCOUNT_SYNC,  /**< Character changes are forced to the account
+                                 server every 30 instead of 10 seconds. */
+    OVERLOAD_LOGINS,        /**< New logins are admitted one at a time and
+                                 characters see half as far. */
+    OVERLOAD_LEVEL_COUNT
+};
+
+/**
+ * Degrades the service of the game server step by step while its ticks
+ * take too long, and restores it when the load goes down.
+ *
+ * The tick durations are averaged. When the average stays above
+ * game_overloadThreshold percent of the tick length for a second, or when
+ * ticks had to be skipped, the next level is entered. When it stays below
+ * game_overloadRecoveryThreshold percent for ten seconds, the level goes
+ * down again.
+ */
+namespace OverloadController
+{
+    /**
+     * Logs when overload control is disabled by the configuration. The
+     * thresholds themselves are read on every tick, so they can be changed
+     * while the server runs.
+     */
+    void initialize();
+
+    /**
+     * Accounts for the duration of a tick in microseconds.
+     */
+    void tickFinished(unsigned microseconds);
+
+    /**
+     * Accounts for ticks that were skipped because the server fell behind.
+     */
+    void ticksSkipped(int count);
+
+    OverloadLevel getLevel();
+
+    /**
+     * Enters the given level directly, without measuring the load. Used by
+     * the replay of an input recording, which applies the recorded levels.
+     */
+    void setLevel(OverloadLevel level);
+
+    /**
+     * Returns a short description of the given level.
+     */
+    const char *getLevelName(OverloadLevel level);
+
+    /**
+     * Returns the visual range characters are informed about, given the
+     * configured one.
+     */
+    int getVisualRange(int visualRange);
+
+    /**
+     * Returns the factor by which updates of beings out of sight are
+     * spread further.
+     */
+    int getUnseenUpdateFactor();
+
+    /**
+     * Returns the number of ticks between the forced syncs of character
+     * changes with the account server.
+     */
+    int getSyncInterval();
+
+    /**
+     * Returns whether a new login may enter the world now, and counts it
+     * when it may.
+     */
+    bool admitLogin();
+}
+
+#endif // OVERLOADCONTROLLER_H
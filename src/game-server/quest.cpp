@@ -85,12 +85,11 @@ void QuestRefCallback::triggerCallback(Entity *ch,
     if (!mRef.isValid())
         return;
 
-    Script *s = ScriptManager::currentState();
-    s->prepare(mRef);
-    s->push(ch);
-    s->push(mQuestName);
-    s->push(value);
-    s->execute(ch->getMap());
+    mScript->prepare(mRef);
+    mScript->push(ch);
+    mScript->push(mQuestName);
+    mScript->push(value);
+    mScript->execute(ch->getMap());
 }
 
 static void partialRemove(Entity *t)
@@ -64,12 +64,14 @@ class QuestRefCallback : public QuestCallback
 {
     public:
         QuestRefCallback(Script *script, const std::string &questName) :
+            mScript(script),
             mQuestName(questName)
         { script->assignCallback(mRef); }
 
         void triggerCallback(Entity *ch, const std::string &value) const;
 
     private:
+        Script *mScript;
         Script::Ref mRef;
         std::string mQuestName;
 };
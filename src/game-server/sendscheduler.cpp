@@ -0,0 +1,118 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "game-server/sendscheduler.h"
+
+#include "common/configuration.h"
+#include "game-server/state.h"
+#include "utils/logger.h"
+
+#include <algorithm>
+
+static Configuration::Setting<int> clientSendBudget("net_clientSendBudget", 0);
+static Configuration::Setting<int> farMovementIntervalSetting(
+        "game_farMovementInterval", 4);
+
+/** Bytes per tick each client may receive, 0 for no limit. */
+static int budgetPerTick = 0;
+
+/** Ticks between movement updates at the edge of the visual range. */
+static int farMovementInterval = 4;
+
+static void applySettings(const int &)
+{
+    budgetPerTick = std::max(0, clientSendBudget.get());
+    farMovementInterval = std::max(1, farMovementIntervalSetting.get());
+}
+
+unsigned SendScheduler::mTotalDeferred = 0;
+
+SendScheduler::SendScheduler():
+    mTokens(budgetPerTick * 2),
+    mLastTick(GameState::getCurrentTick()),
+    mDeferred(0)
+{
+}
+
+void SendScheduler::initialize()
+{
+    applySettings(0);
+
+    // Both values can be tuned on a configuration reload.
+    clientSendBudget.signal_changed.connect(sigc::ptr_fun(&applySettings));
+    farMovementIntervalSetting.signal_changed.connect(
+            sigc::ptr_fun(&applySettings));
+
+    if (budgetPerTick)
+        LOG_INFO("Limiting client output to " << budgetPerTick
+                 << " bytes per tick.");
+}
+
+void SendScheduler::refill()
+{
+    const int tick = GameState::getCurrentTick();
+    if (tick == mLastTick)
+        return;
+
+    // Saving up is limited to two ticks worth of bytes
+    const int elapsed = std::min(tick - mLastTick, 2);
+    mTokens = std::min(mTokens + elapsed * budgetPerTick, budgetPerTick * 2);
+    mLastTick = tick;
+}
+
+void SendScheduler::consume(unsigned bytes)
+{
+    if (!budgetPerTick)
+        return;
+
+    refill();
+    mTokens -= bytes;
+}
+
+bool SendScheduler::fits(unsigned bytes, SendPriority priority)
+{
+    if (!budgetPerTick || priority == SEND_PRIORITY_HIGH)
+        return true;
+
+    refill();
+    return mTokens >= (int) bytes;
+}
+
+bool SendScheduler::isMovementDue(int distance, int visualRange,
+                                  int id, int tick)
+{
+    if (farMovementInterval == 1)
+        return true;
+
+    // Full rate within half the visual range, half the configured interval
+    // up to three quarters of it and the full interval beyond.
+    const int half = visualRange / 2;
+    const int threeQuarters = visualRange * 3 / 4;
+
+    int interval;
+    if (distance <= half * half)
+        return true;
+    else if (distance <= threeQuarters * threeQuarters)
+        interval = std::max(1, farMovementInterval / 2);
+    else
+        interval = farMovementInterval;
+
+    return (tick + id) % interval == 0;
+}
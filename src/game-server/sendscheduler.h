@@ -0,0 +1,111 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SENDSCHEDULER_H
+#define SENDSCHEDULER_H
+
+/**
+ * How important a message is for a game client.
+ */
+enum SendPriority
+{
+    SEND_PRIORITY_HIGH,     /**< Combat, own status, beings entering or
+                                 leaving. Never held back. */
+    SEND_PRIORITY_LOW       /**< Movement of other beings. Held back when
+                                 the send budget is exhausted. */
+};
+
+/**
+ * @brief Limits how many bytes are sent to a single game client per tick.
+ *
+ * The budget is a token bucket that is refilled every tick by the configured
+ * amount of bytes, and that can save up to twice that amount. High priority
+ * messages are always sent and may overdraw the budget, which delays the low
+ * priority ones until it recovers.
+ *
+ * The scheduler does not queue anything itself. Low priority updates describe
+ * state, so the caller simply skips them and sends the up-to-date state
+ * once there is room again.
+ */
+class SendScheduler
+{
+    public:
+        SendScheduler();
+
+        /**
+         * Reads the budget and the rate reduction from the configuration.
+         */
+        static void initialize();
+
+        /**
+         * Accounts for a message of the given size sent to the client.
+         */
+        void consume(unsigned bytes);
+
+        /**
+         * Returns whether a message of the given size and priority can be
+         * sent to the client during this tick.
+         */
+        bool fits(unsigned bytes, SendPriority priority);
+
+        /**
+         * Counts an update that was held back.
+         */
+        void deferred()
+        { ++mDeferred; ++mTotalDeferred; }
+
+        /**
+         * Returns the number of updates held back for this client.
+         */
+        unsigned getDeferred() const
+        { return mDeferred; }
+
+        /**
+         * Returns the number of updates held back for all clients since the
+         * server started.
+         */
+        static unsigned getTotalDeferred()
+        { return mTotalDeferred; }
+
+        /**
+         * Returns whether the movement of a being should be sent this tick.
+         * Beings in the outer half of the visual range are updated less
+         * often, staggered by their id so that not all of them are sent
+         * during the same tick.
+         *
+         * @param distance    the squared distance between observer and being
+         * @param visualRange the visual range in pixels
+         * @param id          the public id of the being
+         * @param tick        the current tick
+         */
+        static bool isMovementDue(int distance, int visualRange,
+                                  int id, int tick);
+
+    private:
+        void refill();
+
+        int mTokens;                    /**< Bytes left in the budget. */
+        int mLastTick;                  /**< Tick of the last refill. */
+        unsigned mDeferred;             /**< Updates held back. */
+
+        static unsigned mTotalDeferred;
+};
+
+#endif // SENDSCHEDULER_H
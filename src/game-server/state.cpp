@@ -21,6 +21,7 @@
 #include "game-server/state.h"
 
 #include "common/configuration.h"
+#include "common/defines.h"
 #include "game-server/accountconnection.h"
 #include "game-server/effect.h"
 #include "game-server/gamehandler.h"
@@ -32,14 +33,20 @@
 #include "game-server/mapmanager.h"
 #include "game-server/monster.h"
 #include "game-server/npc.h"
+#include "game-server/overloadcontroller.h"
+#include "game-server/sendscheduler.h"
+#include "game-server/tickprofiler.h"
 #include "game-server/trade.h"
 #include "net/messageout.h"
+#include "net/messageschema.h"
 #include "scripting/script.h"
 #include "scripting/scriptmanager.h"
 #include "utils/logger.h"
 #include "utils/speedconv.h"
 
+#include <algorithm>
 #include <cassert>
+#include <vector>
 
 enum
 {
@@ -65,6 +72,17 @@ typedef std::map< Entity *, DelayedEvent > DelayedEvents;
  */
 static int currentTick;
 
+/** Radius around beings in which others get informed about them. */
+static Configuration::Setting<int> gameVisualRange("game_visualRange", 448);
+
+/** Length of a world tick in milliseconds. Only read at startup. */
+static Configuration::Setting<int> gameTickLength("game_tickLength",
+                                                  WORLD_TICK_MS, false);
+
+/** Bounds of the configurable tick length, in milliseconds. */
+static const int MIN_TICK_LENGTH = 10;
+static const int MAX_TICK_LENGTH = 1000;
+
 /**
  * List of delayed events.
  */
@@ -122,20 +140,126 @@ static void serializeLooks(Entity *ch, MessageOut &msg)
     }
 }
 
+/**
+ * Appends the movement of a being to a GPMSG_BEINGS_MOVE_COMPACT message.
+ * The destination is sent as a delta against what the client was last told,
+ * in tiles when it is a whole number of tiles, and the speed only when it
+ * changed.
+ */
+static void serializeCompactMove(MessageOut &msg, MovementBaseline &baseline,
+                                 int id, int flags, const Point &destination,
+                                 int speed, const Map *map)
+{
+    int compactFlags = 0;
+    int dx = destination.x - baseline.destination.x;
+    int dy = destination.y - baseline.destination.y;
+
+    if (flags & MOVING_DESTINATION)
+    {
+        // The periodic position check resends the absolute destination,
+        // which also repairs any drift on the client side.
+        if (flags & MOVING_POSITION)
+        {
+            compactFlags |= MOVING_POSITION;
+        }
+        else
+        {
+            compactFlags |= MOVING_DESTINATION;
+
+            const int tileWidth = map->getTileWidth();
+            const int tileHeight = map->getTileHeight();
+            if (dx % tileWidth == 0 && dy % tileHeight == 0)
+            {
+                compactFlags |= MOVING_TILES;
+                dx /= tileWidth;
+                dy /= tileHeight;
+            }
+        }
+
+        if (speed != baseline.speed)
+            compactFlags |= MOVING_SPEED;
+    }
+
+    msg.writeVarInt(id);
+    msg.writeInt8(compactFlags);
+
+    if (compactFlags & MOVING_POSITION)
+    {
+        msg.writeInt16(destination.x);
+        msg.writeInt16(destination.y);
+    }
+    else if (compactFlags & MOVING_DESTINATION)
+    {
+        msg.writeSignedVarInt(dx);
+        msg.writeSignedVarInt(dy);
+    }
+
+    if (compactFlags & MOVING_SPEED)
+        msg.writeInt8(speed);
+
+    if (flags & MOVING_DESTINATION)
+    {
+        baseline.destination = destination;
+        baseline.speed = speed;
+    }
+}
+
+/**
+ * A movement update for a being, collected while informing a player so that
+ * the updates can be prioritized once everything more important was sent.
+ */
+struct PendingMove
+{
+    Entity *being;
+    int id;
+    int flags;
+    int distance;       /**< Squared distance to the observing character. */
+    bool forced;        /**< Bypasses the send budget and rate reduction. */
+
+    bool operator<(const PendingMove &other) const
+    { return distance < other.distance; }
+};
+
+/** Milliseconds between the positions sent along with moving beings. */
+static const int POSITION_CHECK_INTERVAL = 5 * 1000;
+
+/** Upper bound for the size of one entry in a movement message. */
+static const unsigned MAX_MOVE_ENTRY_SIZE = schema::BeingMove::size +
+                                           schema::BeingMovePosition::size +
+                                           schema::BeingMoveDestination::size;
+
 /**
  * Informs a player of what happened around the character.
  */
 static void informPlayer(MapComposite *map, Entity *p)
 {
-    MessageOut moveMsg(GPMSG_BEINGS_MOVE);
+    GameClient *client = p->getComponent<CharacterComponent>()->getClient();
+    const bool compactMovement =
+            client->capabilities & CAPABILITY_COMPACT_MOVEMENT;
+    MessageOut moveMsg(compactMovement ? GPMSG_BEINGS_MOVE_COMPACT
+                                       : GPMSG_BEINGS_MOVE);
     MessageOut damageMsg(GPMSG_BEINGS_DAMAGE);
     const Point &pold = p->getComponent<BeingComponent>()->getOldPosition();
     const Point &ppos = p->getComponent<ActorComponent>()->getPosition();
     int pflags = p->getComponent<ActorComponent>()->getUpdateFlags();
-    int visualRange = Configuration::getValue("game_visualRange", 448);
+    const int visualRange =
+            OverloadController::getVisualRange(gameVisualRange);
+    const int positionCheckInterval =
+            GameState::ticksFromMilliseconds(POSITION_CHECK_INTERVAL);
+
+    // When the range changed since the last update, what the client knows
+    // was decided by the previous range. Beings between both ranges get
+    // entered or left, so the iteration covers the larger one.
+    const int oldVisualRange =
+            client->visualRange ? client->visualRange : visualRange;
+    const int iterationRange = std::max(visualRange, oldVisualRange);
+    client->visualRange = visualRange;
+
+    static std::vector<PendingMove> pendingMoves;
+    pendingMoves.clear();
 
     // Inform client about activities of other beings near its character
-    for (BeingIterator it(map->getAroundBeingIterator(p, visualRange));
+    for (BeingIterator it(map->getAroundBeingIterator(p, iterationRange));
          it; ++it)
     {
         Entity *o = *it;
@@ -149,7 +273,7 @@ static void informPlayer(MapComposite *map, Entity *p)
         int flags = 0;
 
         // Check if the character p and the moving object o are around.
-        bool wereInRange = pold.inRangeOf(oold, visualRange) &&
+        bool wereInRange = pold.inRangeOf(oold, oldVisualRange) &&
                            !((pflags | oflags) & UPDATEFLAG_NEW_ON_MAP);
         bool willBeInRange = ppos.inRangeOf(opos, visualRange);
 
@@ -159,6 +283,7 @@ static void informPlayer(MapComposite *map, Entity *p)
             continue;
         }
 
+        MovementBaseline &baseline = client->movementBaselines[oid];
 
         if (wereInRange && willBeInRange)
         {
@@ -245,17 +370,18 @@ static void informPlayer(MapComposite *map, Entity *p)
             {
                 auto *beingComponent = o->getComponent<BeingComponent>();
                 const Hits &hits = beingComponent->getHitsTaken();
+                damageMsg.reserve(hits.size() * schema::BeingDamage::size);
                 for (Hits::const_iterator j = hits.begin(),
                      j_end = hits.end(); j != j_end; ++j)
                 {
-                    damageMsg.writeInt16(oid);
-                    damageMsg.writeInt16(*j);
+                    damageMsg.write(schema::BeingDamage(oid, *j));
                 }
             }
 
-            if (oold == opos)
+            if (oold == opos && opos == baseline.destination)
             {
-                // o does not move, nothing more to report.
+                // o does not move and the client is up to date, nothing more
+                // to report.
                 continue;
             }
         }
@@ -264,29 +390,27 @@ static void informPlayer(MapComposite *map, Entity *p)
         {
             // o is no longer visible from p. Send leave message.
             MessageOut leaveMsg(GPMSG_BEING_LEAVE);
-            leaveMsg.writeInt16(oid);
+            leaveMsg.write(schema::BeingLeave(oid));
             gameHandler->sendTo(p, leaveMsg);
+            client->movementBaselines.erase(oid);
             continue;
         }
 
         if (!wereInRange)
         {
             // o is now visible by p. Send enter message.
+            auto *beingComponent = o->getComponent<BeingComponent>();
             MessageOut enterMsg(GPMSG_BEING_ENTER);
-            enterMsg.writeInt8(otype);
-            enterMsg.writeInt16(oid);
-            enterMsg.writeInt8(o->getComponent<BeingComponent>()->getAction());
-            enterMsg.writeInt16(opos.x);
-            enterMsg.writeInt16(opos.y);
-            enterMsg.writeInt8(
-                    o->getComponent<BeingComponent>()->getDirection());
-            enterMsg.writeInt8(o->getComponent<BeingComponent>()->getGender());
+            enterMsg.write(schema::BeingEnter(otype, oid,
+                                              beingComponent->getAction(),
+                                              opos.x, opos.y,
+                                              beingComponent->getDirection(),
+                                              beingComponent->getGender()));
             switch (otype)
             {
                 case OBJECT_CHARACTER:
                 {
-                    enterMsg.writeString(
-                            o->getComponent<BeingComponent>()->getName());
+                    enterMsg.writeString(beingComponent->getName());
                     serializeLooks(o, enterMsg);
                 } break;
 
@@ -295,8 +419,7 @@ static void informPlayer(MapComposite *map, Entity *p)
                     MonsterComponent *monsterComponent =
                             o->getComponent<MonsterComponent>();
                     enterMsg.writeInt16(monsterComponent->getSpecy()->getId());
-                    enterMsg.writeString(
-                            o->getComponent<BeingComponent>()->getName());
+                    enterMsg.writeString(beingComponent->getName());
                 } break;
 
                 case OBJECT_NPC:
@@ -304,8 +427,7 @@ static void informPlayer(MapComposite *map, Entity *p)
                     NpcComponent *npcComponent =
                             o->getComponent<NpcComponent>();
                     enterMsg.writeInt16(npcComponent->getNpcId());
-                    enterMsg.writeString(
-                            o->getComponent<BeingComponent>()->getName());
+                    enterMsg.writeString(beingComponent->getName());
                 } break;
 
                 default:
@@ -313,37 +435,91 @@ static void informPlayer(MapComposite *map, Entity *p)
                     break;
             }
             gameHandler->sendTo(p, enterMsg);
+
+            baseline.destination = opos;
+            baseline.speed = -1;
         }
 
-        if (opos != oold)
+        // Movement that was held back earlier is still pending.
+        if (opos != oold || opos != baseline.destination)
         {
             // Add position check coords every 5 seconds.
-            if (currentTick % 50 == 0)
+            if (currentTick % positionCheckInterval == 0)
                 flags |= MOVING_POSITION;
 
             flags |= MOVING_DESTINATION;
         }
 
-        // Send move messages.
-        moveMsg.writeInt16(oid);
-        moveMsg.writeInt8(flags);
-        if (flags & MOVING_POSITION)
+        const int dx = opos.x - ppos.x;
+        const int dy = opos.y - ppos.y;
+        PendingMove move = { o, oid, flags, dx * dx + dy * dy,
+                             o == p || !wereInRange };
+        pendingMoves.push_back(move);
+    }
+
+    if (damageMsg.getLength() > 2)
+        gameHandler->sendTo(p, damageMsg);
+
+    // Inform client about status change.
+    p->getComponent<CharacterComponent>()->sendStatus(*p);
+
+    // Movement of other beings comes last. Nearby beings go first, far away
+    // ones are updated less often, and whatever does not fit in the send
+    // budget of the client is held back until a later tick.
+    SendScheduler &scheduler = client->sendScheduler;
+    std::sort(pendingMoves.begin(), pendingMoves.end());
+
+    for (std::vector<PendingMove>::const_iterator it = pendingMoves.begin(),
+         it_end = pendingMoves.end(); it != it_end; ++it)
+    {
+        const PendingMove &move = *it;
+
+        if (!move.forced &&
+            (!SendScheduler::isMovementDue(move.distance, visualRange,
+                                           move.id, currentTick) ||
+             !scheduler.fits(moveMsg.getLength() + MAX_MOVE_ENTRY_SIZE,
+                             SEND_PRIORITY_LOW)))
         {
-            moveMsg.writeInt16(oold.x);
-            moveMsg.writeInt16(oold.y);
+            scheduler.deferred();
+            continue;
         }
 
+        Entity *o = move.being;
+        const Point &oold =
+                o->getComponent<BeingComponent>()->getOldPosition();
+        const Point &opos = o->getComponent<ActorComponent>()->getPosition();
+        MovementBaseline &baseline = client->movementBaselines[move.id];
+        int flags = move.flags;
+
+        // We multiply the sent speed (in tiles per second) by ten
+        // to get it within a byte with decimal precision.
+        // For instance, a value of 4.5 will be sent as 45.
+        int speed = 0;
         if (flags & MOVING_DESTINATION)
         {
-            moveMsg.writeInt16(opos.x);
-            moveMsg.writeInt16(opos.y);
-            // We multiply the sent speed (in tiles per second) by ten
-            // to get it within a byte with decimal precision.
-            // For instance, a value of 4.5 will be sent as 45.
             auto *tpsSpeedAttribute = attributeManager->getAttributeInfo(ATTR_MOVE_SPEED_TPS);
-            moveMsg.writeInt8((unsigned short)
-                (o->getComponent<BeingComponent>()
-                        ->getModifiedAttribute(tpsSpeedAttribute) * 10));
+            speed = (unsigned char) (o->getComponent<BeingComponent>()
+                        ->getModifiedAttribute(tpsSpeedAttribute) * 10);
+        }
+
+        // Send move messages.
+        if (compactMovement)
+        {
+            serializeCompactMove(moveMsg, baseline, move.id, flags, opos,
+                                 speed, map->getMap());
+            continue;
+        }
+
+        moveMsg.write(schema::BeingMove(move.id, flags));
+        if (flags & MOVING_POSITION)
+            moveMsg.write(schema::BeingMovePosition(oold.x, oold.y));
+
+        if (flags & MOVING_DESTINATION)
+        {
+            moveMsg.write(schema::BeingMoveDestination(opos.x, opos.y, speed));
+
+            baseline.destination = opos;
+            baseline.speed = speed;
         }
     }
 
@@ -351,12 +527,6 @@ static void informPlayer(MapComposite *map, Entity *p)
     if (moveMsg.getLength() > 2)
         gameHandler->sendTo(p, moveMsg);
 
-    if (damageMsg.getLength() > 2)
-        gameHandler->sendTo(p, damageMsg);
-
-    // Inform client about status change.
-    p->getComponent<CharacterComponent>()->sendStatus(*p);
-
     // Inform client about health change of party members
     for (CharacterIterator i(map->getWholeMapIterator()); i; ++i)
     {
@@ -391,7 +561,7 @@ static void informPlayer(MapComposite *map, Entity *p)
 
     // Inform client about items on the ground around its character
     MessageOut itemMsg(GPMSG_ITEMS);
-    for (FixedActorIterator it(map->getAroundBeingIterator(p, visualRange));
+    for (FixedActorIterator it(map->getAroundBeingIterator(p, iterationRange));
          it; ++it)
     {
         Entity *o = *it;
@@ -402,7 +572,7 @@ static void informPlayer(MapComposite *map, Entity *p)
         Point opos = o->getComponent<ActorComponent>()->getPosition();
         int oflags = o->getComponent<ActorComponent>()->getUpdateFlags();
         bool willBeInRange = ppos.inRangeOf(opos, visualRange);
-        bool wereInRange = pold.inRangeOf(opos, visualRange) &&
+        bool wereInRange = pold.inRangeOf(opos, oldVisualRange) &&
                            !((pflags | oflags) & UPDATEFLAG_NEW_ON_MAP);
 
         if (willBeInRange ^ wereInRange)
@@ -466,6 +636,31 @@ static void informPlayer(MapComposite *map, Entity *p)
         gameHandler->sendTo(p, itemMsg);
 }
 
+void GameState::informPlayers(MapComposite *map, int tick)
+{
+    currentTick = tick;
+
+    for (CharacterIterator p(map->getWholeMapIterator()); p; ++p)
+    {
+        informPlayer(map, *p);
+    }
+
+    // Beings out of sight keep their changes until their next update, no
+    // character was informed about them anyway
+    for (ActorIterator it(map->getWholeMapIterator()); it; ++it)
+    {
+        Entity *a = *it;
+        if (map->skipsUpdate(a))
+            continue;
+
+        a->getComponent<ActorComponent>()->clearUpdateFlags();
+        if (a->canFight())
+        {
+            a->getComponent<BeingComponent>()->clearHitsTaken();
+        }
+    }
+}
+
 #ifndef NDEBUG
 static bool dbgLockObjects;
 #endif
@@ -478,7 +673,10 @@ void GameState::update(int tick)
     dbgLockObjects = true;
 #endif
 
-    ScriptManager::currentState()->update();
+    {
+        TickProfiler::Scope profile(TICK_SCRIPTS);
+        ScriptManager::update();
+    }
 
     // Update game state (update AI, etc.)
     const MapManager::Maps &maps = MapManager::getMaps();
@@ -491,20 +689,8 @@ void GameState::update(int tick)
 
         map->update();
 
-        for (CharacterIterator p(map->getWholeMapIterator()); p; ++p)
-        {
-            informPlayer(map, *p);
-        }
-
-        for (ActorIterator it(map->getWholeMapIterator()); it; ++it)
-        {
-            Entity *a = *it;
-            a->getComponent<ActorComponent>()->clearUpdateFlags();
-            if (a->canFight())
-            {
-                a->getComponent<BeingComponent>()->clearHitsTaken();
-            }
-        }
+        TickProfiler::Scope profile(TICK_INFORM, map->getID());
+        informPlayers(map, tick);
     }
 
 #   ifndef NDEBUG
@@ -512,6 +698,7 @@ void GameState::update(int tick)
 #   endif
 
     // Take care of events that were delayed because of their side effects.
+    TickProfiler::Scope profile(TICK_DELAYED_EVENTS);
     for (DelayedEvents::iterator it = delayedEvents.begin(),
          it_end = delayedEvents.end(); it != it_end; ++it)
     {
@@ -621,6 +808,8 @@ bool GameState::insert(Entity *ptr)
     if (obj->getType() != OBJECT_CHARACTER)
         return true;
 
+    gameHandler->characterInserted(ptr);
+
     /* Since the player does not know yet where in the world its character is,
        we send a map-change message, even if it is the first time it
        connects to this server. */
@@ -630,6 +819,10 @@ bool GameState::insert(Entity *ptr)
     mapChangeMessage.writeInt16(pos.y);
     gameHandler->sendTo(ptr, mapChangeMessage);
 
+    // The client forgets about all beings of the previous map
+    ptr->getComponent<CharacterComponent>()->getClient()
+            ->movementBaselines.clear();
+
     // update the online state of the character
     accountHandler->updateOnlineStatus(ptr->getComponent<CharacterComponent>()
                                        ->getDatabaseID(), true);
@@ -642,6 +835,23 @@ int GameState::getCurrentTick()
     return currentTick;
 }
 
+int GameState::getTickLength()
+{
+    return std::max(MIN_TICK_LENGTH,
+                    std::min(gameTickLength.get(), MAX_TICK_LENGTH));
+}
+
+int GameState::getVisualRange()
+{
+    return gameVisualRange;
+}
+
+int GameState::ticksFromMilliseconds(int ms)
+{
+    const int tickLength = getTickLength();
+    return std::max(1, (ms + tickLength / 2) / tickLength);
+}
+
 bool GameState::insertOrDelete(Entity *ptr)
 {
     if (insert(ptr)) return true;
@@ -653,7 +863,7 @@ void GameState::remove(Entity *ptr)
 {
     assert(!dbgLockObjects);
     MapComposite *map = ptr->getMap();
-    int visualRange = Configuration::getValue("game_visualRange", 448);
+    const int visualRange = gameVisualRange;
 
     ptr->signal_removed.emit(ptr);
 
@@ -700,14 +910,16 @@ void GameState::remove(Entity *ptr)
             auto *characterComponent =
                     ptr->getComponent<CharacterComponent>();
             characterComponent->cancelTransaction();
+            gameHandler->characterRemoved(ptr);
 
             // remove characters online status
             accountHandler->updateOnlineStatus(
                     characterComponent->getDatabaseID(), false);
         }
 
+        const int publicId = ptr->getComponent<ActorComponent>()->getPublicID();
         MessageOut msg(GPMSG_BEING_LEAVE);
-        msg.writeInt16(ptr->getComponent<ActorComponent>()->getPublicID());
+        msg.write(schema::BeingLeave(publicId));
         Point objectPos = ptr->getComponent<ActorComponent>()->getPosition();
 
         for (CharacterIterator p(map->getAroundActorIterator(ptr, visualRange));
@@ -718,6 +930,8 @@ void GameState::remove(Entity *ptr)
                 visualRange))
             {
                 gameHandler->sendTo(*p, msg);
+                (*p)->getComponent<CharacterComponent>()->getClient()
+                        ->movementBaselines.erase(publicId);
             }
         }
     }
@@ -831,9 +1045,14 @@ void GameState::enqueueWarp(Entity *ptr,
 }
 
 void GameState::sayAround(Entity *entity, const std::string &text)
+{
+    sayAround(entity, utils::StringView(text));
+}
+
+void GameState::sayAround(Entity *entity, const utils::StringView &text)
 {
     Point speakerPosition = entity->getComponent<ActorComponent>()->getPosition();
-    int visualRange = Configuration::getValue("game_visualRange", 448);
+    const int visualRange = gameVisualRange;
 
     for (CharacterIterator i(entity->getMap()->getAroundActorIterator(entity, visualRange)); i; ++i)
     {
@@ -847,6 +1066,12 @@ void GameState::sayAround(Entity *entity, const std::string &text)
 }
 
 void GameState::sayTo(Entity *destination, Entity *source, const std::string &text)
+{
+    sayTo(destination, source, utils::StringView(text));
+}
+
+void GameState::sayTo(Entity *destination, Entity *source,
+                      const utils::StringView &text)
 {
     if (destination->getType() != OBJECT_CHARACTER)
         return; //only characters will read it anyway
@@ -22,6 +22,7 @@
 #define STATE_H
 
 #include "utils/point.h"
+#include "utils/stringview.h"
 
 #include <string>
 
@@ -38,6 +39,31 @@ namespace GameState
 
     int getCurrentTick();
 
+    /**
+     * Returns the length of a world tick in milliseconds, as configured by
+     * game_tickLength. Durations that are counted in ticks scale with it.
+     */
+    int getTickLength();
+
+    /**
+     * Returns the number of ticks closest to the given duration in
+     * milliseconds, but at least one.
+     */
+    int ticksFromMilliseconds(int ms);
+
+    /**
+     * Returns the radius in pixels around beings in which characters get
+     * informed about them, as configured by game_visualRange.
+     */
+    int getVisualRange();
+
+    /**
+     * Informs the characters on the map of what happened around them
+     * during the given tick, then clears the update flags of the actors on
+     * the map. Part of update(), available separately for benchmarking.
+     */
+    void informPlayers(MapComposite *map, int tick);
+
     /**
      * Inserts an entity in the game world.
      * @return false if the insertion failed and the entity is in limbo.
@@ -95,11 +121,14 @@ namespace GameState
      * @note passing nullptr as source generates a message from "Server:"
      */
     void sayTo(Entity *destination, Entity *source, const std::string &text);
+    void sayTo(Entity *destination, Entity *source,
+               const utils::StringView &text);
 
     /**
      * Says something to everything around an actor.
      */
     void sayAround(Entity *entity, const std::string &text);
+    void sayAround(Entity *entity, const utils::StringView &text);
 
     /**
      * Says something to every player on the server.
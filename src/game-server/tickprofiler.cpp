@@ -0,0 +1,347 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "game-server/tickprofiler.h"
+
+#include "common/configuration.h"
+#include "game-server/mapcomposite.h"
+#include "game-server/mapmanager.h"
+#include "utils/histogram.h"
+#include "utils/logger.h"
+#include "utils/string.h"
+#include "utils/tracer.h"
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+using utils::Histogram;
+using utils::Tracer;
+
+static Configuration::Setting<bool> profilerEnabled("game_tickProfiler",
+                                                    false);
+static Configuration::Setting<std::string> profileFile(
+        "log_gameTickProfileFile", std::string());
+
+/** The phases that are also measured per map. */
+static const int FIRST_MAP_PHASE = TICK_MAP_UPDATE;
+static const int MAP_PHASE_COUNT = TICK_INFORM - TICK_MAP_UPDATE + 1;
+
+struct MapProfile
+{
+    MapProfile(): total(0) {}
+
+    Histogram phases[MAP_PHASE_COUNT];
+    uint64_t total;     /**< Time spent on the map in microseconds. */
+};
+
+static const char *phaseNames[TICK_PHASE_COUNT] =
+{
+    "account",
+    "clients",
+    "scripts",
+    "map_update",
+    "movement",
+    "zones",
+    "inform",
+    "delayed_events",
+    "flush"
+};
+
+/** Durations of the phases, one sample per tick. */
+static Histogram phaseHistograms[TICK_PHASE_COUNT];
+/** Durations of the whole ticks. */
+static Histogram tickHistogram;
+/** Durations of the per-map phases, indexed by map id. */
+static std::vector<MapProfile> mapProfiles;
+
+/** Whether the current tick is measured, profiled and/or traced. */
+static bool inTick = false;
+static bool profiling = false;
+static bool tracing = false;
+static std::chrono::steady_clock::time_point tickStart;
+static unsigned currentTick[TICK_PHASE_COUNT];
+static unsigned lastTick[TICK_PHASE_COUNT];
+static unsigned lastTickTotal = 0;
+
+static uint64_t toMicroseconds(std::chrono::steady_clock::time_point time)
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(time.time_since_epoch()).count();
+}
+
+static void enabledChanged(const bool &enabled)
+{
+    LOG_INFO("Tick profiler " << (enabled ? "enabled." : "disabled."));
+    TickProfiler::reset();
+}
+
+TickProfiler::Scope::Scope(TickPhase phase, int mapId):
+    mPhase(phase),
+    mMapId(mapId),
+    mActive(inTick)
+{
+    if (mActive)
+        mStart = std::chrono::steady_clock::now();
+}
+
+TickProfiler::Scope::~Scope()
+{
+    stop();
+}
+
+void TickProfiler::Scope::enter(TickPhase phase)
+{
+    stop();
+    mPhase = phase;
+    mActive = inTick;
+    if (mActive)
+        mStart = std::chrono::steady_clock::now();
+}
+
+void TickProfiler::Scope::stop()
+{
+    if (!mActive)
+        return;
+
+    const uint64_t start = toMicroseconds(mStart);
+    const uint64_t end = toMicroseconds(std::chrono::steady_clock::now());
+
+    if (profiling)
+        record(mPhase, mMapId, end - start);
+
+    if (tracing)
+    {
+        Tracer::record("tick", phaseNames[mPhase], start, end,
+                       mMapId < 0 ? std::string()
+                                  : "map " + utils::toString(mMapId));
+    }
+
+    mActive = false;
+}
+
+void TickProfiler::initialize()
+{
+    profilerEnabled.signal_changed.connect(sigc::ptr_fun(&enabledChanged));
+
+    if (profilerEnabled)
+        LOG_INFO("Tick profiler enabled.");
+}
+
+bool TickProfiler::isEnabled()
+{
+    return profilerEnabled;
+}
+
+void TickProfiler::startTick()
+{
+    profiling = profilerEnabled;
+    tracing = Tracer::isEnabled();
+    inTick = profiling || tracing;
+    if (!inTick)
+        return;
+
+    std::fill(currentTick, currentTick + TICK_PHASE_COUNT, 0);
+    tickStart = std::chrono::steady_clock::now();
+}
+
+void TickProfiler::endTick()
+{
+    if (!inTick)
+        return;
+
+    inTick = false;
+
+    const uint64_t start = toMicroseconds(tickStart);
+    const uint64_t end = toMicroseconds(std::chrono::steady_clock::now());
+
+    if (tracing)
+        Tracer::record("tick", "tick", start, end);
+
+    if (!profiling)
+        return;
+
+    lastTickTotal = end - start;
+    tickHistogram.record(lastTickTotal);
+
+    for (int phase = 0; phase < TICK_PHASE_COUNT; ++phase)
+        phaseHistograms[phase].record(currentTick[phase]);
+
+    std::copy(currentTick, currentTick + TICK_PHASE_COUNT, lastTick);
+}
+
+void TickProfiler::record(TickPhase phase, int mapId, unsigned microseconds)
+{
+    currentTick[phase] += microseconds;
+
+    const int mapPhase = phase - FIRST_MAP_PHASE;
+    if (mapId < 0 || mapPhase < 0 || mapPhase >= MAP_PHASE_COUNT)
+        return;
+
+    if (mapId >= (int) mapProfiles.size())
+        mapProfiles.resize(mapId + 1);
+
+    MapProfile &profile = mapProfiles[mapId];
+    profile.phases[mapPhase].record(microseconds);
+    profile.total += microseconds;
+}
+
+const char *TickProfiler::getPhaseName(TickPhase phase)
+{
+    return phaseNames[phase];
+}
+
+void TickProfiler::logLastTick()
+{
+    if (!profilerEnabled || !lastTickTotal)
+        return;
+
+    std::ostringstream os;
+    os << "Last tick took " << lastTickTotal << " us:";
+    for (int phase = 0; phase < TICK_PHASE_COUNT; ++phase)
+        os << ' ' << phaseNames[phase] << '=' << lastTick[phase];
+    LOG_WARN(os.str());
+}
+
+static void writePercentiles(std::ostream &os, const Histogram &histogram)
+{
+    os << " count=\"" << histogram.getCount()
+       << "\" mean=\"" << histogram.getMean()
+       << "\" p50=\"" << histogram.getPercentile(50)
+       << "\" p90=\"" << histogram.getPercentile(90)
+       << "\" p99=\"" << histogram.getPercentile(99)
+       << "\" p999=\"" << histogram.getPercentile(99.9)
+       << "\" max=\"" << histogram.getMax() << "\"";
+}
+
+void TickProfiler::dumpStatistics(std::ostream &os)
+{
+    os << "<ticks unit=\"us\"";
+    writePercentiles(os, tickHistogram);
+    os << ">\n";
+
+    for (int phase = 0; phase < TICK_PHASE_COUNT; ++phase)
+    {
+        os << "<phase name=\"" << phaseNames[phase] << "\"";
+        writePercentiles(os, phaseHistograms[phase]);
+        os << "/>\n";
+    }
+
+    for (unsigned id = 0; id < mapProfiles.size(); ++id)
+    {
+        const MapProfile &profile = mapProfiles[id];
+        if (!profile.total)
+            continue;
+
+        const MapComposite *map = MapManager::getMap(id);
+        os << "<map id=\"" << id
+           << "\" name=\"" << (map ? map->getName() : std::string())
+           << "\" total=\"" << profile.total << "\">\n";
+
+        for (int i = 0; i < MAP_PHASE_COUNT; ++i)
+        {
+            os << "<phase name=\"" << phaseNames[FIRST_MAP_PHASE + i] << "\"";
+            writePercentiles(os, profile.phases[i]);
+            os << "/>\n";
+        }
+        os << "</map>\n";
+    }
+
+    os << "</ticks>\n";
+}
+
+/**
+ * Orders maps by the time spent on them, most expensive first.
+ */
+static bool moreExpensive(unsigned a, unsigned b)
+{
+    return mapProfiles[a].total > mapProfiles[b].total;
+}
+
+static void logStatistics()
+{
+    LOG_INFO("Tick time: p50 " << tickHistogram.getPercentile(50)
+             << " us, p99 " << tickHistogram.getPercentile(99)
+             << " us, max " << tickHistogram.getMax() << " us");
+
+    for (int phase = 0; phase < TICK_PHASE_COUNT; ++phase)
+    {
+        const Histogram &histogram = phaseHistograms[phase];
+        LOG_INFO("Tick phase " << phaseNames[phase]
+                 << ": p50 " << histogram.getPercentile(50)
+                 << " us, p99 " << histogram.getPercentile(99)
+                 << " us, max " << histogram.getMax() << " us");
+    }
+
+    // Only the most expensive maps, the file has all of them.
+    std::vector<unsigned> ids;
+    for (unsigned id = 0; id < mapProfiles.size(); ++id)
+        if (mapProfiles[id].total)
+            ids.push_back(id);
+
+    const unsigned shown = std::min<unsigned>(ids.size(), 5);
+    std::partial_sort(ids.begin(), ids.begin() + shown, ids.end(),
+                      moreExpensive);
+
+    for (unsigned i = 0; i < shown; ++i)
+    {
+        const MapProfile &profile = mapProfiles[ids[i]];
+        const MapComposite *map = MapManager::getMap(ids[i]);
+        std::ostringstream os;
+        os << "Tick map " << ids[i] << " ("
+           << (map ? map->getName() : std::string()) << "): "
+           << profile.total << " us in total, p99";
+        for (int phase = 0; phase < MAP_PHASE_COUNT; ++phase)
+        {
+            os << ' ' << phaseNames[FIRST_MAP_PHASE + phase] << '='
+               << profile.phases[phase].getPercentile(99);
+        }
+        LOG_INFO(os.str());
+    }
+}
+
+void TickProfiler::dumpStatistics()
+{
+    if (!profilerEnabled)
+        return;
+
+    const std::string &fileName = profileFile;
+    if (fileName.empty())
+    {
+        logStatistics();
+    }
+    else
+    {
+        std::ofstream os(fileName.c_str());
+        dumpStatistics(os);
+    }
+
+    reset();
+}
+
+void TickProfiler::reset()
+{
+    for (int phase = 0; phase < TICK_PHASE_COUNT; ++phase)
+        phaseHistograms[phase].reset();
+
+    tickHistogram.reset();
+    mapProfiles.clear();
+}
@@ -0,0 +1,129 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TICKPROFILER_H
+#define TICKPROFILER_H
+
+#include <chrono>
+#include <iosfwd>
+#include <string>
+
+/**
+ * The phases a game server tick is made of.
+ */
+enum TickPhase
+{
+    TICK_ACCOUNT,           /**< Messages from the account server. */
+    TICK_CLIENTS,           /**< Messages from the game clients. */
+    TICK_SCRIPTS,           /**< The update of the script state. */
+    TICK_MAP_UPDATE,        /**< Entity updates and map update callbacks. */
+    TICK_MOVEMENT,          /**< Moving beings around. */
+    TICK_ZONES,             /**< Updating the zones of moved entities. */
+    TICK_INFORM,            /**< Informing characters about their surrounding. */
+    TICK_DELAYED_EVENTS,    /**< Inserts, removes and warps of the tick. */
+    TICK_FLUSH,             /**< Sending the outgoing messages. */
+    TICK_PHASE_COUNT
+};
+
+/**
+ * Measures how long each phase of the game server tick takes.
+ *
+ * The durations are counted in histograms per phase, and the phases that
+ * run per map are also counted per map, so a slow tick can be traced back
+ * to the phase and map responsible for it. While tracing is enabled, the
+ * phases are also recorded as trace spans. When both are disabled, the cost
+ * of the instrumentation is a check of a flag per phase.
+ */
+namespace TickProfiler
+{
+    /**
+     * Measures the phase running during its lifetime. The phase can be
+     * switched to attribute consecutive parts of the code without nesting
+     * scopes.
+     */
+    class Scope
+    {
+        public:
+            Scope(TickPhase phase, int mapId = -1);
+            ~Scope();
+
+            /**
+             * Ends the current phase and starts measuring another one.
+             */
+            void enter(TickPhase phase);
+
+        private:
+            void stop();
+
+            TickPhase mPhase;
+            int mMapId;
+            bool mActive;
+            std::chrono::steady_clock::time_point mStart;
+    };
+
+    /**
+     * Reads the profiler options from the configuration.
+     */
+    void initialize();
+
+    bool isEnabled();
+
+    /**
+     * Marks the start and the end of a tick. The end records the total
+     * duration and the per-phase durations of the tick.
+     */
+    void startTick();
+    void endTick();
+
+    /**
+     * Adds a duration in microseconds to a phase of the current tick.
+     */
+    void record(TickPhase phase, int mapId, unsigned microseconds);
+
+    /**
+     * Returns a short description of the given phase.
+     */
+    const char *getPhaseName(TickPhase phase);
+
+    /**
+     * Logs how the time of the last tick was spent. Used when ticks are
+     * skipped.
+     */
+    void logLastTick();
+
+    /**
+     * Writes the percentiles of all phases and maps since the last reset.
+     */
+    void dumpStatistics(std::ostream &os);
+
+    /**
+     * Writes the statistics to the configured file, or to the log when no
+     * file is set, and starts a new measuring period.
+     */
+    void dumpStatistics();
+
+    /**
+     * Forgets all measured durations.
+     */
+    void reset();
+}
+
+#endif // TICKPROFILER_H
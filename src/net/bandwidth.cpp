@@ -22,57 +22,87 @@
 
 #include "netcomputer.h"
 
+#include <fstream>
+#include <ostream>
+
 BandwidthMonitor::BandwidthMonitor():
     mAmountServerOutput(0),
     mAmountServerInput(0),
     mAmountClientOutput(0),
-    mAmountClientInput(0)
+    mAmountClientInput(0),
+    mAmountUncompressedOutput(0),
+    mAmountCompressedOutput(0)
 {
 }
 
-void BandwidthMonitor::increaseInterServerOutput(int size)
+void BandwidthMonitor::count(TrafficDirection direction, int id, int size)
+{
+    MessageStatistics &stats = mMessages[direction][slot(id)];
+    ++stats.count;
+    stats.bytes += size;
+}
+
+void BandwidthMonitor::increaseInterServerOutput(int id, int size)
 {
     mAmountServerOutput += size;
+    count(TRAFFIC_OUTPUT, id, size);
 }
 
-void BandwidthMonitor::increaseInterServerInput(int size)
+void BandwidthMonitor::increaseInterServerInput(int id, int size)
 {
     mAmountServerInput += size;
+    count(TRAFFIC_INPUT, id, size);
 }
 
-void BandwidthMonitor::increaseClientOutput(NetComputer *nc, int size)
+void BandwidthMonitor::increaseClientOutput(NetComputer *nc, int id, int size)
 {
     mAmountClientOutput += size;
-    // look for an existing client stored
-    ClientBandwidth::iterator itr = mClientBandwidth.find(nc);
-
-    // if there isnt one, create one
-    if (itr == mClientBandwidth.end())
-    {
-        std::pair<ClientBandwidth::iterator, bool> retItr;
-        retItr = mClientBandwidth.insert(std::pair<NetComputer*, std::pair<int, int> >(nc, std::pair<int, int>(0, 0)));
-        itr = retItr.first;
-    }
-
-    itr->second.first += size;
-
+    nc->countOutput(size);
+    count(TRAFFIC_OUTPUT, id, size);
 }
 
-void BandwidthMonitor::increaseClientInput(NetComputer *nc, int size)
+void BandwidthMonitor::increaseClientInput(NetComputer *nc, int id, int size)
 {
     mAmountClientInput += size;
+    nc->countInput(size);
+    count(TRAFFIC_INPUT, id, size);
+}
+
+void BandwidthMonitor::increaseCompressedOutput(int uncompressedSize,
+                                                int compressedSize)
+{
+    mAmountUncompressedOutput += uncompressedSize;
+    mAmountCompressedOutput += compressedSize;
+}
 
-    // look for an existing client stored
-    ClientBandwidth::iterator itr = mClientBandwidth.find(nc);
+void BandwidthMonitor::dumpStatistics(std::ostream &os) const
+{
+    os << "<network client_out=\"" << mAmountClientOutput
+       << "\" client_in=\"" << mAmountClientInput
+       << "\" server_out=\"" << mAmountServerOutput
+       << "\" server_in=\"" << mAmountServerInput
+       << "\" uncompressed_out=\"" << mAmountUncompressedOutput
+       << "\" compressed_out=\"" << mAmountCompressedOutput << "\">\n";
 
-    // if there isnt one, create it
-    if (itr == mClientBandwidth.end())
+    for (int id = 0; id < MESSAGE_ID_SLOTS; ++id)
     {
-        std::pair<ClientBandwidth::iterator, bool> retItr;
-        retItr = mClientBandwidth.insert(std::pair<NetComputer*, std::pair<int, int> >(nc, std::pair<int, int>(0, 0)));
-        itr = retItr.first;
+        const MessageStatistics &in = mMessages[TRAFFIC_INPUT][id];
+        const MessageStatistics &out = mMessages[TRAFFIC_OUTPUT][id];
+        if (!in.count && !out.count)
+            continue;
+
+        os << "<message id=\"" << id
+           << "\" sent=\"" << out.count
+           << "\" sent_bytes=\"" << out.bytes
+           << "\" received=\"" << in.count
+           << "\" received_bytes=\"" << in.bytes << "\"/>\n";
     }
 
-    itr->second.second += size;
+    os << "</network>\n";
 }
 
+void BandwidthMonitor::dumpStatistics(const std::string &fileName) const
+{
+    std::ofstream os(fileName.c_str());
+    dumpStatistics(os);
+}
@@ -21,31 +21,96 @@
 #ifndef BANDWIDTH_H
 #define BANDWIDTH_H
 
-#include <map>
+#include <iosfwd>
+#include <string>
 
 class NetComputer;
 
+/**
+ * Message ids at or above this value are counted together in the last slot.
+ * All ids in use are well below it.
+ */
+const int MESSAGE_ID_SLOTS = 0x0800;
+
+enum TrafficDirection
+{
+    TRAFFIC_INPUT,
+    TRAFFIC_OUTPUT
+};
+
+/**
+ * Number and total size of the messages of one type.
+ */
+struct MessageStatistics
+{
+    MessageStatistics(): count(0), bytes(0) {}
+
+    unsigned count;
+    unsigned long long bytes;
+};
+
+/**
+ * Counts the network traffic of a server, in total and per message type.
+ * Per client totals are kept on the NetComputer itself.
+ */
 class BandwidthMonitor
 {
 public:
     BandwidthMonitor();
-    void increaseInterServerOutput(int size);
-    void increaseInterServerInput(int size);
-    void increaseClientOutput(NetComputer *nc, int size);
-    void increaseClientInput(NetComputer *nc, int size);
+    void increaseInterServerOutput(int id, int size);
+    void increaseInterServerInput(int id, int size);
+    void increaseClientOutput(NetComputer *nc, int id, int size);
+    void increaseClientInput(NetComputer *nc, int id, int size);
     int totalInterServerOut() const { return mAmountServerOutput; }
     int totalInterServerIn() const { return mAmountServerInput; }
     int totalClientOut() const { return mAmountClientOutput; }
     int totalClientIn() const { return mAmountClientInput; }
 
+    /**
+     * Accounts for a message that was compressed before sending it.
+     */
+    void increaseCompressedOutput(int uncompressedSize, int compressedSize);
+
+    /**
+     * Returns the size of all compressed messages before and after the
+     * compression.
+     */
+    unsigned long long totalUncompressedOut() const
+    { return mAmountUncompressedOutput; }
+    unsigned long long totalCompressedOut() const
+    { return mAmountCompressedOutput; }
+
+    /**
+     * Returns the traffic caused by the messages with the given id.
+     */
+    const MessageStatistics &getMessageStatistics(TrafficDirection direction,
+                                                  int id) const
+    { return mMessages[direction][slot(id)]; }
+
+    /**
+     * Writes the totals and the traffic of each message type as XML.
+     */
+    void dumpStatistics(std::ostream &os) const;
+
+    /**
+     * Writes the statistics to the given file, replacing its contents.
+     */
+    void dumpStatistics(const std::string &fileName) const;
+
 private:
+    static int slot(int id)
+    { return (id >= 0 && id < MESSAGE_ID_SLOTS) ? id : MESSAGE_ID_SLOTS - 1; }
+
+    void count(TrafficDirection direction, int id, int size);
+
     int mAmountServerOutput;
     int mAmountServerInput;
     int mAmountClientOutput;
     int mAmountClientInput;
-    // map of client to output and input
-    typedef std::map<NetComputer*, std::pair<int, int> > ClientBandwidth;
-    ClientBandwidth mClientBandwidth;
+    unsigned long long mAmountUncompressedOutput;
+    unsigned long long mAmountCompressedOutput;
+
+    MessageStatistics mMessages[2][MESSAGE_ID_SLOTS];
 };
 
 extern BandwidthMonitor *gBandwidth;
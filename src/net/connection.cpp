@@ -32,7 +32,8 @@
 
 Connection::Connection():
     mRemote(0),
-    mLocal(0)
+    mLocal(0),
+    mDetached(false)
 {
 }
 
@@ -75,8 +76,15 @@ bool Connection::start(const std::string &address, int port)
     return mRemote;
 }
 
+void Connection::startDetached()
+{
+    mDetached = true;
+}
+
 void Connection::stop()
 {
+    mDetached = false;
+
     if (mRemote)
         enet_peer_disconnect(mRemote, 0);
     if (mLocal)
@@ -92,17 +100,23 @@ void Connection::stop()
 
 bool Connection::isConnected() const
 {
-    return mRemote && mRemote->state == ENET_PEER_STATE_CONNECTED;
+    return mDetached ||
+           (mRemote && mRemote->state == ENET_PEER_STATE_CONNECTED);
 }
 
 void Connection::send(const MessageOut &msg, bool reliable, unsigned channel)
 {
+    if (mDetached) {
+        gBandwidth->increaseInterServerOutput(msg.getId(), msg.getLength());
+        return;
+    }
+
     if (!mRemote) {
         LOG_WARN("Can't send message to unconnected host! (" << msg << ")");
         return;
     }
 
-    gBandwidth->increaseInterServerOutput(msg.getLength());
+    gBandwidth->increaseInterServerOutput(msg.getId(), msg.getLength());
 
     ENetPacket *packet;
     packet = enet_packet_create(msg.getData(),
@@ -128,7 +142,8 @@ void Connection::process()
                 {
                     MessageIn msg((char *)event.packet->data,
                                   event.packet->dataLength);
-                    gBandwidth->increaseInterServerInput(event.packet->dataLength);
+                    gBandwidth->increaseInterServerInput(msg.getId(),
+                                                    event.packet->dataLength);
                     processMessage(msg);
                 }
                 else
@@ -43,6 +43,12 @@ class Connection
          */
         bool start(const std::string &, int);
 
+        /**
+         * Acts as connected without a remote host, used when replaying
+         * recorded input. Messages sent are dropped.
+         */
+        void startDetached();
+
         /**
          * Disconnects.
          */
@@ -64,6 +70,12 @@ class Connection
          */
         void process();
 
+        /**
+         * Handles a message as if it was received from the remote host.
+         */
+        void processDetached(MessageIn &msg)
+        { processMessage(msg); }
+
     protected:
         /**
          * Processes a single message from the remote host.
@@ -73,6 +85,7 @@ class Connection
     private:
         ENetPeer *mRemote;
         ENetHost *mLocal;
+        bool mDetached;
 };
 
 #endif
@@ -18,8 +18,6 @@
  *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <algorithm>
-
 #include "net/connectionhandler.h"
 
 #include "common/configuration.h"
@@ -28,6 +26,8 @@
 #include "net/messageout.h"
 #include "net/netcomputer.h"
 #include "utils/logger.h"
+#include "utils/string.h"
+#include "utils/tracer.h"
 
 #ifdef ENET_VERSION_CREATE
 #define ENET_CUTOFF ENET_VERSION_CREATE(1,3,0)
@@ -100,7 +100,7 @@ void ConnectionHandler::process(enet_uint32 timeout)
             case ENET_EVENT_TYPE_CONNECT:
             {
                 NetComputer *comp = computerConnected(event.peer);
-                clients.push_back(comp);
+                addClient(comp);
                 LOG_INFO("A new client connected from " << *comp << ":"
                          << event.peer->address.port << " to port "
                          << host->address.port);
@@ -124,7 +124,12 @@ void ConnectionHandler::process(enet_uint32 timeout)
                     LOG_DEBUG("Received message " << msg << " from "
                               << *comp);
 
-                    gBandwidth->increaseClientInput(comp, event.packet->dataLength);
+                    gBandwidth->increaseClientInput(comp, msg.getId(),
+                                                    event.packet->dataLength);
+
+                    utils::TraceSpan span("net", "message");
+                    if (span.isRecording())
+                        span.setDetail(utils::toString(msg.getId()));
 
                     processMessage(comp, msg);
                 } else {
@@ -144,7 +149,7 @@ void ConnectionHandler::process(enet_uint32 timeout)
 
                 // Reset the peer's client information.
                 computerDisconnected(comp);
-                clients.erase(std::find(clients.begin(), clients.end(), comp));
+                removeClient(comp);
                 event.peer->data = nullptr;
             } break;
 
@@ -166,3 +171,37 @@ unsigned ConnectionHandler::getClientCount() const
 {
     return clients.size();
 }
+
+NetComputer *ConnectionHandler::connectDetached()
+{
+    NetComputer *comp = computerConnected(nullptr);
+    addClient(comp);
+    return comp;
+}
+
+void ConnectionHandler::processDetached(NetComputer *comp, MessageIn &msg)
+{
+    gBandwidth->increaseClientInput(comp, msg.getId(), msg.getLength());
+    processMessage(comp, msg);
+}
+
+void ConnectionHandler::disconnectDetached(NetComputer *comp)
+{
+    computerDisconnected(comp);
+    removeClient(comp);
+}
+
+void ConnectionHandler::addClient(NetComputer *comp)
+{
+    mClientPositions[comp] = clients.insert(clients.end(), comp);
+}
+
+void ConnectionHandler::removeClient(NetComputer *comp)
+{
+    ClientPositions::iterator i = mClientPositions.find(comp);
+    if (i == mClientPositions.end())
+        return;
+
+    clients.erase(i->second);
+    mClientPositions.erase(i);
+}
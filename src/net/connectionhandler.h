@@ -23,6 +23,7 @@
 
 #include <list>
 #include <string>
+#include <unordered_map>
 #include <enet/enet.h>
 
 class MessageIn;
@@ -81,6 +82,24 @@ class ConnectionHandler
          */
         unsigned getClientCount() const;
 
+        /**
+         * Adds a computer that is not connected through the network, like
+         * the clients of a replayed input recording. Whatever is sent to it
+         * is dropped.
+         */
+        NetComputer *connectDetached();
+
+        /**
+         * Handles a message as if it was received from the given detached
+         * computer.
+         */
+        void processDetached(NetComputer *, MessageIn &);
+
+        /**
+         * Removes a detached computer as if it disconnected.
+         */
+        void disconnectDetached(NetComputer *);
+
     private:
         ENetAddress address;      /**< Includes the port to listen to. */
         ENetHost *host;           /**< The host that listen for connections. */
@@ -113,9 +132,19 @@ class ConnectionHandler
         typedef std::list<NetComputer*> NetComputers;
         /**
          * A list of pointers to the client structures created by
-         * computerConnected.
+         * computerConnected, in the order they connected. Broadcasts follow
+         * this order, so they are reproducible when replaying input.
          */
         NetComputers clients;
+
+    private:
+        void addClient(NetComputer *comp);
+        void removeClient(NetComputer *comp);
+
+        typedef std::unordered_map<NetComputer*,
+                                   NetComputers::iterator> ClientPositions;
+        /** Position of each client in the list, for constant time removal. */
+        ClientPositions mClientPositions;
 };
 
 #endif
@@ -121,6 +121,41 @@ int MessageIn::readInt32()
     return value;
 }
 
+unsigned MessageIn::readVarInt()
+{
+    unsigned value = 0;
+
+    if (!readValueType(ManaServ::VarInt))
+        return value;
+
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        ASSERT_IF (mPos < mLength)
+        {
+            unsigned char byte = mData[mPos];
+            ++mPos;
+            value |= (unsigned) (byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        else
+        {
+            LOG_DEBUG("Unable to read varint in " << mId << "!");
+            break;
+        }
+    }
+
+    // Either truncated or longer than five bytes
+    mPos = mLength + 1;
+    return 0;
+}
+
+int MessageIn::readSignedVarInt()
+{
+    unsigned value = readVarInt();
+    return (int) (value >> 1) ^ -(int) (value & 1);
+}
+
 double MessageIn::readDouble()
 {
     double value = -1;
@@ -134,6 +169,22 @@ double MessageIn::readDouble()
     mPos += sizeof(double);
 #else
     int length = readInt8();
+    if (length == ManaServ::DOUBLE_BINARY_MARKER)
+    {
+        if (mPos + sizeof(double) > mLength)
+        {
+            LOG_DEBUG("Unable to read double in " << mId << "!");
+            mPos = mLength + 1;
+            return value;
+        }
+
+        uint64_t bits = 0;
+        for (unsigned i = 0; i < sizeof(double); ++i)
+            bits = (bits << 8) | (unsigned char) mData[mPos++];
+        memcpy(&value, &bits, sizeof(double));
+        return value;
+    }
+
     std::istringstream i (readString(length));
     i >> value;
 #endif
@@ -141,9 +192,14 @@ double MessageIn::readDouble()
 }
 
 std::string MessageIn::readString(int length)
+{
+    return readStringView(length).str();
+}
+
+utils::StringView MessageIn::readStringView(int length)
 {
     if (!readValueType(ManaServ::String))
-        return std::string();
+        return utils::StringView();
 
     if (mDebugMode)
     {
@@ -156,7 +212,7 @@ std::string MessageIn::readString(int length)
             LOG_DEBUG("Expected string of length " << length <<
                       " but received length " << fixedLength);
             mPos = mLength + 1;
-            return std::string();
+            return utils::StringView();
         }
     }
 
@@ -170,17 +226,17 @@ std::string MessageIn::readString(int length)
     if (length < 0 || mPos + length > mLength)
     {
         mPos = mLength + 1;
-        return std::string();
+        return utils::StringView();
     }
 
     // Read the string
     const char *stringBeg = mData + mPos;
     const char *stringEnd = (const char *)memchr(stringBeg, '\0', length);
-    std::string readString(stringBeg,
-                           stringEnd ? stringEnd - stringBeg : length);
+    utils::StringView stringView(stringBeg,
+                                 stringEnd ? stringEnd - stringBeg : length);
     mPos += length;
 
-    return readString;
+    return stringView;
 }
 
 bool MessageIn::readValueType(ManaServ::ValueType type)
@@ -259,6 +315,9 @@ operator <<(std::ostream &os, const MessageIn &msg)
             case ManaServ::Double:
                 os << "d " << m.readDouble();
                 break;
+            case ManaServ::VarInt:
+                os << "V " << m.readVarInt();
+                break;
             default:
                 os << "??? }";
                 return os; // Stop after error
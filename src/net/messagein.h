@@ -22,6 +22,7 @@
 #define MESSAGEIN_H
 
 #include "common/manaserv_protocol.h"
+#include "utils/stringview.h"
 
 #include <iosfwd>
 
@@ -49,9 +50,16 @@ class MessageIn
          */
         int getLength() const { return mLength; }
 
+        /**
+         * Returns the data of this message, including its ID.
+         */
+        const char *getData() const { return mData; }
+
         int readInt8();             /**< Reads a byte. */
         int readInt16();            /**< Reads a short. */
         int readInt32();            /**< Reads a long. */
+        unsigned readVarInt();      /**< Reads a LEB128 varint. */
+        int readSignedVarInt();     /**< Reads a zigzag-encoded varint. */
 
         /**
          * Reads a double. HACKY and should *not* be used for client
@@ -66,6 +74,55 @@ class MessageIn
          */
         std::string readString(int length = -1);
 
+        /**
+         * Reads a string like readString, without copying it. The returned
+         * view points into the message data, so it is only valid as long as
+         * the data this message was constructed with, usually the ENet
+         * packet being processed.
+         */
+        utils::StringView readStringView(int length = -1);
+
+        /**
+         * Reads a record with a fixed layout, see net/messageschema.h. The
+         * bounds are checked once for the whole record.
+         *
+         * @return false when the message is too short, in which case the
+         *         message is marked as fully read.
+         */
+        template<typename Record>
+        bool read(Record &record)
+        {
+            if (mDebugMode)
+            {
+                record.readAnnotated(*this);
+                return mPos <= mLength;
+            }
+
+            if (mPos + Record::size > mLength)
+            {
+                mPos = mLength + 1;
+                return false;
+            }
+
+            record.deserialize(mData + mPos);
+            mPos += Record::size;
+            return true;
+        }
+
+        /**
+         * Returns the number of complete records of the given schema that
+         * are left in the message.
+         */
+        template<typename Record>
+        int getUnreadCount() const
+        {
+            // In debug mode, each value is preceded by its type
+            const int size = mDebugMode ? Record::size + Record::count
+                                        : Record::size;
+            const int unread = getUnreadLength();
+            return unread > 0 ? unread / size : 0;
+        }
+
         /**
          * Returns the length of unread data.
          */
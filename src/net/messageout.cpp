@@ -41,8 +41,10 @@ const unsigned CAPACITY_GROW_FACTOR = 2;
 static bool debugModeEnabled = false;
 
 MessageOut::MessageOut(int id):
+    mId(id),
     mPos(0),
-    mDebugMode(false)
+    mDebugMode(false),
+    mBinaryEncoding(false)
 {
     mData = (char*) malloc(INITIAL_DATA_CAPACITY);
     mDataSize = INITIAL_DATA_CAPACITY;
@@ -105,6 +107,25 @@ void MessageOut::writeInt32(int value)
     mPos += 4;
 }
 
+void MessageOut::writeVarInt(unsigned value)
+{
+    if (mDebugMode)
+        writeValueType(ManaServ::VarInt);
+
+    expand(mPos + 5);
+    while (value >= 0x80)
+    {
+        mData[mPos++] = (char) ((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    mData[mPos++] = (char) value;
+}
+
+void MessageOut::writeSignedVarInt(int value)
+{
+    writeVarInt(((unsigned) value << 1) ^ (unsigned) (value >> 31));
+}
+
 void MessageOut::writeDouble(double value)
 {
     if (mDebugMode)
@@ -115,6 +136,18 @@ void MessageOut::writeDouble(double value)
     memcpy(mData + mPos, &value, sizeof(double));
     mPos += sizeof(double);
 #else
+    if (mBinaryEncoding)
+    {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(double));
+
+        writeInt8(ManaServ::DOUBLE_BINARY_MARKER);
+        expand(mPos + sizeof(double));
+        for (int shift = 56; shift >= 0; shift -= 8)
+            mData[mPos++] = (char) (bits >> shift);
+        return;
+    }
+
 // Rather inefficient, but I don't have a lot of time.
 // If anyone wants to implement a custom double you are more than welcome to.
     std::ostringstream o;
@@ -127,7 +160,19 @@ void MessageOut::writeDouble(double value)
 #endif
 }
 
+void MessageOut::writeData(const char *data, unsigned length)
+{
+    expand(mPos + length);
+    memcpy(mData + mPos, data, length);
+    mPos += length;
+}
+
 void MessageOut::writeString(const std::string &string, int length)
+{
+    writeString(utils::StringView(string), length);
+}
+
+void MessageOut::writeString(const utils::StringView &string, int length)
 {
     if (mDebugMode)
     {
@@ -135,7 +180,7 @@ void MessageOut::writeString(const std::string &string, int length)
         writeInt16(length);
     }
 
-    int stringLength = string.length();
+    int stringLength = string.size();
     if (length < 0)
     {
         // Write the length at the start if not fixed
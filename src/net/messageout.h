@@ -22,6 +22,7 @@
 #define MESSAGEOUT_H
 
 #include "common/manaserv_protocol.h"
+#include "utils/stringview.h"
 
 #include <iosfwd>
 
@@ -56,8 +57,21 @@ class MessageOut
         void writeInt32(int value);
 
         /**
-         * Writes a double. HACKY and should *not* be used for client
-         * communication!
+         * Writes an unsigned integer as a LEB128 varint, using one byte for
+         * values below 128 and at most five bytes.
+         */
+        void writeVarInt(unsigned value);
+
+        /**
+         * Writes a signed integer as a zigzag-encoded varint, so that small
+         * negative values stay short as well.
+         */
+        void writeSignedVarInt(int value);
+
+        /**
+         * Writes a double. Unless binary encoding is enabled for this
+         * message, it is sent as decimal text, which is HACKY and should
+         * *not* be used for client communication!
          */
         void writeDouble(double value);
 
@@ -66,6 +80,41 @@ class MessageOut
          * as a short at the start of the string.
          */
         void writeString(const std::string &string, int length = -1);
+        void writeString(const utils::StringView &string, int length = -1);
+
+        /**
+         * Appends raw data, as taken from another message.
+         */
+        void writeData(const char *data, unsigned length);
+
+        /**
+         * Writes a record with a fixed layout, see net/messageschema.h.
+         */
+        template<typename Record>
+        void write(const Record &record)
+        {
+            if (mDebugMode)
+            {
+                record.writeAnnotated(*this);
+                return;
+            }
+
+            expand(mPos + Record::size);
+            record.serialize(mData + mPos);
+            mPos += Record::size;
+        }
+
+        /**
+         * Makes sure that the given amount of bytes can be written without
+         * growing the buffer again.
+         */
+        void reserve(unsigned size)
+        { expand(mPos + size); }
+
+        /**
+         * Returns the message ID.
+         */
+        int getId() const { return mId; }
 
         /**
          * Returns the content of the message.
@@ -77,6 +126,18 @@ class MessageOut
          */
         unsigned getLength() const { return mPos; }
 
+        /**
+         * Sets whether doubles written from now on use the binary encoding.
+         * Only enable this when the receiver negotiated
+         * CAPABILITY_BINARY_ENCODING. Readers detect the encoding of each
+         * double by themselves.
+         */
+        void setBinaryEncoding(bool enabled)
+        { mBinaryEncoding = enabled; }
+
+        bool getBinaryEncoding() const
+        { return mBinaryEncoding; }
+
         /**
          * Sets whether the debug mode is enabled. In debug mode, the internal
          * data of the message is annotated so that the message contents can
@@ -96,9 +157,11 @@ class MessageOut
         void writeValueType(ManaServ::ValueType type);
 
         char *mData;                /**< Data building up. */
+        int mId;                    /**< The message ID. */
         unsigned mPos;              /**< Position in the data. */
         unsigned mDataSize;         /**< Allocated datasize. */
         bool mDebugMode;            /**< Include debugging information. */
+        bool mBinaryEncoding;       /**< Write doubles in binary form. */
 
         /**
          * Streams message ID and length to the given output stream.
@@ -0,0 +1,254 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MESSAGESCHEMA_H
+#define MESSAGESCHEMA_H
+
+#include "net/messagein.h"
+#include "net/messageout.h"
+
+#include <cstring>
+#include <stdint.h>
+#include <enet/enet.h>
+
+/**
+ * Compile-time layouts for the fixed parts of the high-volume messages.
+ *
+ * A record is a list of integer fields whose total size is known at compile
+ * time. MessageOut::write reserves room for a whole record once and copies
+ * all fields in one go, and MessageIn::read checks the bounds of a whole
+ * record once. In debug mode both fall back to the annotated per-field
+ * functions, so records can be mixed freely with the other read and write
+ * functions.
+ */
+namespace schema
+{
+    /** A B field: 8-bit unsigned integer. */
+    struct Byte
+    {
+        static const unsigned size = 1;
+
+        static void serialize(char *data, int value)
+        { data[0] = (char) value; }
+
+        static int deserialize(const char *data)
+        { return (unsigned char) data[0]; }
+
+        static void write(MessageOut &msg, int value)
+        { msg.writeInt8(value); }
+
+        static int read(MessageIn &msg)
+        { return msg.readInt8(); }
+    };
+
+    /** A W field: 16-bit signed integer in network byte order. */
+    struct Word
+    {
+        static const unsigned size = 2;
+
+        static void serialize(char *data, int value)
+        {
+            uint16_t t = ENET_HOST_TO_NET_16(value);
+            memcpy(data, &t, 2);
+        }
+
+        static int deserialize(const char *data)
+        {
+            uint16_t t;
+            memcpy(&t, data, 2);
+            return (short) ENET_NET_TO_HOST_16(t);
+        }
+
+        static void write(MessageOut &msg, int value)
+        { msg.writeInt16(value); }
+
+        static int read(MessageIn &msg)
+        { return msg.readInt16(); }
+    };
+
+    /** A D field: 32-bit signed integer in network byte order. */
+    struct DoubleWord
+    {
+        static const unsigned size = 4;
+
+        static void serialize(char *data, int value)
+        {
+            uint32_t t = ENET_HOST_TO_NET_32(value);
+            memcpy(data, &t, 4);
+        }
+
+        static int deserialize(const char *data)
+        {
+            uint32_t t;
+            memcpy(&t, data, 4);
+            return ENET_NET_TO_HOST_32(t);
+        }
+
+        static void write(MessageOut &msg, int value)
+        { msg.writeInt32(value); }
+
+        static int read(MessageIn &msg)
+        { return msg.readInt32(); }
+    };
+
+    /**
+     * Applies the field types to the values of a record, one field after
+     * the other. The empty specialization ends the recursion.
+     */
+    template<unsigned Index, typename... Fields>
+    struct FieldList
+    {
+        static const unsigned size = 0;
+
+        static void serialize(char *, const int *) {}
+        static void deserialize(const char *, int *) {}
+        static void write(MessageOut &, const int *) {}
+        static void read(MessageIn &, int *) {}
+    };
+
+    template<unsigned Index, typename Field, typename... Rest>
+    struct FieldList<Index, Field, Rest...>
+    {
+        typedef FieldList<Index + 1, Rest...> Next;
+
+        static const unsigned size = Field::size + Next::size;
+
+        static void serialize(char *data, const int *values)
+        {
+            Field::serialize(data, values[Index]);
+            Next::serialize(data + Field::size, values);
+        }
+
+        static void deserialize(const char *data, int *values)
+        {
+            values[Index] = Field::deserialize(data);
+            Next::deserialize(data + Field::size, values);
+        }
+
+        static void write(MessageOut &msg, const int *values)
+        {
+            Field::write(msg, values[Index]);
+            Next::write(msg, values);
+        }
+
+        static void read(MessageIn &msg, int *values)
+        {
+            values[Index] = Field::read(msg);
+            Next::read(msg, values);
+        }
+    };
+
+    /**
+     * A record of fixed-size integer fields.
+     */
+    template<typename... Fields>
+    class Record
+    {
+        typedef FieldList<0, Fields...> List;
+
+        public:
+            /** Number of fields. */
+            static const unsigned count = sizeof...(Fields);
+
+            /** Size in bytes when not in debug mode. */
+            static const unsigned size = List::size;
+
+            Record()
+            { memset(mValues, 0, sizeof(mValues)); }
+
+            template<typename... Values>
+            Record(Values... values)
+                : mValues { static_cast<int>(values)... }
+            {
+                static_assert(sizeof...(Values) == count,
+                              "A value is needed for each field");
+            }
+
+            int operator[](unsigned index) const { return mValues[index]; }
+            int &operator[](unsigned index) { return mValues[index]; }
+
+            /** Writes the fields to a buffer of at least size bytes. */
+            void serialize(char *data) const
+            { List::serialize(data, mValues); }
+
+            /** Reads the fields from a buffer of at least size bytes. */
+            void deserialize(const char *data)
+            { List::deserialize(data, mValues); }
+
+            /** Writes the fields one by one, with debugging information. */
+            void writeAnnotated(MessageOut &msg) const
+            { List::write(msg, mValues); }
+
+            /** Reads the fields one by one, with debugging information. */
+            void readAnnotated(MessageIn &msg)
+            { List::read(msg, mValues); }
+
+        private:
+            int mValues[count];
+    };
+
+    // Schemas of the high-volume game server messages. See
+    // manaserv_protocol.h for the complete layouts.
+
+    /** GPMSG_BEING_ENTER: B type, W being id, B action, W*2 position,
+        B direction, B gender. The type specific part follows. */
+    typedef Record<Byte, Word, Byte, Word, Word, Byte, Byte> BeingEnter;
+
+    /** GPMSG_BEING_LEAVE: W being id. */
+    typedef Record<Word> BeingLeave;
+
+    /** GPMSG_BEINGS_MOVE entry: W being id, B flags. */
+    typedef Record<Word, Byte> BeingMove;
+
+    /** GPMSG_BEINGS_MOVE entry with MOVING_POSITION: W*2 position. */
+    typedef Record<Word, Word> BeingMovePosition;
+
+    /** GPMSG_BEINGS_MOVE entry with MOVING_DESTINATION: W*2 destination,
+        B speed. */
+    typedef Record<Word, Word, Byte> BeingMoveDestination;
+
+    /** GPMSG_BEINGS_DAMAGE entry: W being id, W amount. */
+    typedef Record<Word, Word> BeingDamage;
+
+    /** PGMSG_WALK: W*2 destination. */
+    typedef Record<Word, Word> Walk;
+
+    /** GPMSG_PLAYER_ATTRIBUTE_CHANGE entry: W attribute, D base value,
+        D modified value (both in 1/256ths). */
+    typedef Record<Word, DoubleWord, DoubleWord> AttributeChange;
+
+    // Schemas of GAMSG_STATISTICS, sent by the game server to the account
+    // server.
+
+    /** Map entry after the map id: W entity nb, W monster nb, W player nb.
+        The character ids of the players follow. */
+    typedef Record<Word, Word, Word> MapStatistics;
+
+    /** Player of a map entry: D character id. */
+    typedef Record<DoubleWord> MapPlayer;
+
+    /** Traffic entry: W message id, D sent nb, D sent bytes, D received nb,
+        D received bytes. */
+    typedef Record<Word, DoubleWord, DoubleWord, DoubleWord, DoubleWord>
+            MessageTraffic;
+
+} // namespace schema
+
+#endif // MESSAGESCHEMA_H
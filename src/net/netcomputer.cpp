@@ -28,20 +28,77 @@
 
 #include "../utils/logger.h"
 #include "../utils/processorutils.h"
+#include "../utils/zlib.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+
+/** Messages of at least this length are compressed, if enabled. */
+static unsigned compressionThreshold = 0;
+
+/**
+ * Creates a packet holding the compressed payload of the message. Returns
+ * null when the compression failed or did not make the message smaller.
+ */
+static ENetPacket *createCompressedPacket(const MessageOut &msg,
+                                          enet_uint32 flags)
+{
+    // The message id stays uncompressed
+    const unsigned payloadLength = msg.getLength() - 2;
+    const unsigned headerLength = 2 + 4;
+    char *compressed;
+    unsigned compressedLength;
+
+    if (!deflateMemory(msg.getData() + 2, payloadLength,
+                       compressed, compressedLength))
+        return nullptr;
+
+    ENetPacket *packet = nullptr;
+    if (headerLength + compressedLength < msg.getLength())
+    {
+        packet = enet_packet_create(nullptr, headerLength + compressedLength,
+                                    flags);
+    }
+
+    if (packet)
+    {
+        uint16_t id;
+        memcpy(&id, msg.getData(), 2);
+        id |= ENET_HOST_TO_NET_16(ManaServ::XXMSG_COMPRESSED_FLAG);
+        uint32_t length = ENET_HOST_TO_NET_32(payloadLength);
+
+        memcpy(packet->data, &id, 2);
+        memcpy(packet->data + 2, &length, 4);
+        memcpy(packet->data + headerLength, compressed, compressedLength);
+
+        gBandwidth->increaseCompressedOutput(msg.getLength(),
+                                             packet->dataLength);
+    }
+
+    free(compressed);
+    return packet;
+}
 
 NetComputer::NetComputer(ENetPeer *peer):
-    mPeer(peer)
+    mPeer(peer),
+    mCompressionEnabled(false),
+    mBytesSent(0),
+    mBytesReceived(0),
+    mMessagesSent(0),
+    mMessagesReceived(0)
 {
 }
 
 bool NetComputer::isConnected() const
 {
-    return (mPeer->state == ENET_PEER_STATE_CONNECTED);
+    return !mPeer || mPeer->state == ENET_PEER_STATE_CONNECTED;
 }
 
 void NetComputer::disconnect(const MessageOut &msg)
 {
-    if (isConnected())
+    // A detached computer is only disconnected by its recorded input
+    if (mPeer && isConnected())
     {
         /* ChannelID 0xFF is the channel used by enet_peer_disconnect.
          * If a reliable packet is send over this channel ENet guaranties
@@ -61,15 +118,28 @@ void NetComputer::send(const MessageOut &msg, bool reliable,
 {
     LOG_DEBUG("Sending message " << msg << " to " << *this);
 
-    gBandwidth->increaseClientOutput(this, msg.getLength());
+    if (!mPeer)
+    {
+        gBandwidth->increaseClientOutput(this, msg.getId(), msg.getLength());
+        return;
+    }
 
-    ENetPacket *packet;
-    packet = enet_packet_create(msg.getData(),
-                                msg.getLength(),
-                                reliable ? ENET_PACKET_FLAG_RELIABLE : 0);
+    const enet_uint32 flags = reliable ? ENET_PACKET_FLAG_RELIABLE : 0;
+    ENetPacket *packet = nullptr;
+
+    if (mCompressionEnabled && compressionThreshold &&
+        msg.getLength() >= compressionThreshold)
+    {
+        packet = createCompressedPacket(msg, flags);
+    }
+
+    if (!packet)
+        packet = enet_packet_create(msg.getData(), msg.getLength(), flags);
 
     if (packet)
     {
+        gBandwidth->increaseClientOutput(this, msg.getId(),
+                                         packet->dataLength);
         enet_peer_send(mPeer, channel, packet);
     }
     else
@@ -80,6 +150,9 @@ void NetComputer::send(const MessageOut &msg, bool reliable,
 
 std::ostream &operator <<(std::ostream &os, const NetComputer &comp)
 {
+    if (!comp.mPeer)
+        return os << "detached";
+
     // address.host contains the ip-address in network-byte-order
     if (utils::processor::isLittleEndian)
         os << ( comp.mPeer->address.host & 0x000000ff)        << "."
@@ -97,7 +170,12 @@ std::ostream &operator <<(std::ostream &os, const NetComputer &comp)
     return os;
 }
 
+void NetComputer::setCompressionThreshold(unsigned length)
+{
+    compressionThreshold = length;
+}
+
 int NetComputer::getIP() const
 {
-    return mPeer->address.host;
+    return mPeer ? mPeer->address.host : 0;
 }
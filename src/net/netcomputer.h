@@ -33,6 +33,11 @@ class MessageOut;
 class NetComputer
 {
     public:
+        /**
+         * Constructor. Without a peer, the computer is detached: it is
+         * handled like a connected one, but whatever is sent to it is
+         * dropped. Used when replaying recorded input.
+         */
         NetComputer(ENetPeer *peer);
 
         virtual ~NetComputer() {}
@@ -70,13 +75,50 @@ class NetComputer
         void send(const MessageOut &msg, bool reliable = true,
                   unsigned channel = 0);
 
+        /**
+         * Sets whether large messages may be compressed when sent to this
+         * computer. Disabled by default, since the computer needs to
+         * understand XXMSG_COMPRESSED_FLAG.
+         */
+        void setCompressionEnabled(bool enabled)
+        { mCompressionEnabled = enabled; }
+
+        /**
+         * Sets the minimum length of a message before it is compressed.
+         * Zero disables compression.
+         */
+        static void setCompressionThreshold(unsigned length);
+
         /**
          * Returns IP address of computer in 32bit int form
          */
         int getIP() const;
 
+        /**
+         * Accounts for a message sent to this computer.
+         */
+        void countOutput(int size)
+        { mBytesSent += size; ++mMessagesSent; }
+
+        /**
+         * Accounts for a message received from this computer.
+         */
+        void countInput(int size)
+        { mBytesReceived += size; ++mMessagesReceived; }
+
+        unsigned long long getBytesSent() const { return mBytesSent; }
+        unsigned long long getBytesReceived() const { return mBytesReceived; }
+        unsigned getMessagesSent() const { return mMessagesSent; }
+        unsigned getMessagesReceived() const { return mMessagesReceived; }
+
     private:
         ENetPeer *mPeer;              /**< Client peer */
+        bool mCompressionEnabled;     /**< Peer understands compression */
+
+        unsigned long long mBytesSent;      /**< Bytes sent to the peer. */
+        unsigned long long mBytesReceived;  /**< Bytes received from it. */
+        unsigned mMessagesSent;             /**< Messages sent to the peer. */
+        unsigned mMessagesReceived;         /**< Messages received from it. */
 
         /**
          * Converts the ip-address of the peer to a stringstream.
@@ -53,10 +53,13 @@ extern "C" {
 #include "net/messageout.h"
 #include "scripting/luautil.h"
 #include "scripting/luascript.h"
+#include "scripting/scheduler.h"
 #include "scripting/scriptmanager.h"
 #include "utils/logger.h"
 #include "utils/speedconv.h"
 
+#include <algorithm>
+#include <climits>
 #include <string.h>
 #include <math.h>
 
@@ -68,11 +71,36 @@ extern "C" {
  * http://doc.manasource.org/scripting
  */
 
+/**
+ * Raises an error when the calling script does not run in the global script
+ * state. Callbacks called for all maps can only be assigned from there when
+ * maps have script states of their own.
+ */
+static void checkGlobalState(lua_State *s)
+{
+    if (getScript(s) != ScriptManager::currentState())
+        luaL_error(s, "only allowed in the global script state");
+}
+
+/**
+ * Raises an error when the calling script does not run in the script state
+ * of the given map.
+ */
+static void checkMapState(lua_State *s, MapComposite *map)
+{
+    if (getScript(s) != ScriptManager::getState(map))
+        luaL_error(s, "only allowed in the script state of the map");
+}
+
 /** LUA_CATEGORY Callbacks (callbacks)
  * **Note:** You can only assign a **single** function as callback.
  * When setting a new function the old one will not be called anymore.
  * Some of this callbacks are already used for the libmana.lua. Be careful when
  * using those since they will most likely break your code in other places.
+ *
+ * When the `script_perMapStates` option is enabled, the callbacks of
+ * characters, attributes, crafting and map updates can only be assigned by
+ * the main script, which runs in the global script state.
  */
 
 /** LUA on_update_derived_attribute (callbacks)
@@ -87,6 +115,7 @@ extern "C" {
 static int on_update_derived_attribute(lua_State *s)
 {
     luaL_checktype(s, 1, LUA_TFUNCTION);
+    checkGlobalState(s);
     BeingComponent::setUpdateDerivedAttributesCallback(getScript(s));
     return 0;
 }
@@ -106,6 +135,7 @@ static int on_update_derived_attribute(lua_State *s)
 static int on_recalculate_base_attribute(lua_State *s)
 {
     luaL_checktype(s, 1, LUA_TFUNCTION);
+    checkGlobalState(s);
     BeingComponent::setRecalculateBaseAttributeCallback(getScript(s));
     return 0;
 }
@@ -118,6 +148,7 @@ static int on_recalculate_base_attribute(lua_State *s)
 static int on_character_death(lua_State *s)
 {
     luaL_checktype(s, 1, LUA_TFUNCTION);
+    checkGlobalState(s);
     CharacterComponent::setDeathCallback(getScript(s));
     return 0;
 }
@@ -132,6 +163,7 @@ static int on_character_death(lua_State *s)
 static int on_character_death_accept(lua_State *s)
 {
     luaL_checktype(s, 1, LUA_TFUNCTION);
+    checkGlobalState(s);
     CharacterComponent::setDeathAcceptedCallback(getScript(s));
     return 0;
 }
@@ -145,6 +177,7 @@ static int on_character_death_accept(lua_State *s)
 static int on_character_login(lua_State *s)
 {
     luaL_checktype(s, 1, LUA_TFUNCTION);
+    checkGlobalState(s);
     CharacterComponent::setLoginCallback(getScript(s));
     return 0;
 }
@@ -210,7 +243,7 @@ static int on_create_npc_delayed(lua_State *s)
 static int on_map_initialize(lua_State *s)
 {
     luaL_checktype(s, 1, LUA_TFUNCTION);
-    MapComposite::setInitializeCallback(getScript(s));
+    Script::setMapInitializeCallback(getScript(s));
     return 0;
 }
 
@@ -224,6 +257,7 @@ static int on_map_initialize(lua_State *s)
 static int on_craft(lua_State *s)
 {
     luaL_checktype(s, 1, LUA_TFUNCTION);
+    checkGlobalState(s);
     ScriptManager::setCraftCallback(getScript(s));
     return 0;
 }
@@ -237,10 +271,29 @@ static int on_craft(lua_State *s)
 static int on_mapupdate(lua_State *s)
 {
     luaL_checktype(s, 1, LUA_TFUNCTION);
+    checkGlobalState(s);
     MapComposite::setUpdateCallback(getScript(s));
     return 0;
 }
 
+/** LUA on_map_message (callbacks)
+ * on_map_message(function ref)
+ **
+ * Will make sure that the function `ref` gets called with the id of the
+ * sending map and the message as arguments for each message posted to a map
+ * with [post_map_message](scripting.html#post_map_message). The receiving
+ * map is the current map while the function runs.
+ *
+ * When maps have script states of their own, each state assigns its own
+ * function, which receives the messages of the maps using that state.
+ */
+static int on_map_message(lua_State *s)
+{
+    luaL_checktype(s, 1, LUA_TFUNCTION);
+    Script::setMapMessageCallback(getScript(s));
+    return 0;
+}
+
 
 /** LUA_CATEGORY Creation and removal of stuff (creation)
  */
@@ -280,7 +333,7 @@ static int npc_create(lua_State *s)
 
     MapComposite *m = checkCurrentMap(s);
 
-    NpcComponent *npcComponent = new NpcComponent(id);
+    NpcComponent *npcComponent = new NpcComponent(id, getScript(s));
 
     Entity *npc = new Entity(OBJECT_NPC);
     auto *actorComponent = new ActorComponent(*npc);
@@ -2161,7 +2214,7 @@ static int chr_try_get_quest(lua_State *s)
 static int get_character_by_name(lua_State *s)
 {
     const char *name = luaL_checkstring(s, 1);
-    push(s, gameHandler->getCharacterByNameSlow(name));
+    push(s, gameHandler->getCharacterByName(name));
     return 1;
 }
 
@@ -2646,6 +2699,30 @@ static int map_get_pvp(lua_State *s)
     return 1;
 }
 
+/** LUA post_map_message (mapinformation)
+ * post_map_message(int mapid, string message)
+ **
+ * Posts the `message` to the scripts of the map with the id `mapid`. The
+ * message is delivered to the [on_map_message](scripting.html#on_map_message)
+ * callback at the beginning of the next tick, together with the id of the
+ * current map, or 0 when there is none.
+ *
+ * This is the way for scripts to interact with maps that may run in another
+ * script state, since Lua values can not be shared between states. Use a
+ * string encoding of your choice for structured messages.
+ */
+static int post_map_message(lua_State *s)
+{
+    const int target = luaL_checkint(s, 1);
+    const char *message = luaL_checkstring(s, 2);
+    luaL_argcheck(s, MapManager::getMap(target), 1, "unknown map id");
+
+    const Script::Context *context = getScript(s)->getContext();
+    const int sender = context && context->map ? context->map->getID() : 0;
+    ScriptManager::postMapMessage(sender, target, message);
+    return 0;
+}
+
 
 /** LUA_CATEGORY Persistent variables (variables)
  */
@@ -2669,6 +2746,7 @@ static int on_mapvar_changed(lua_State *s)
     luaL_checktype(s, 2, LUA_TFUNCTION);
     luaL_argcheck(s, key[0] != 0, 2, "empty variable name");
     MapComposite *m = checkCurrentMap(s);
+    checkMapState(s, m);
     m->setMapVariableCallback(key, getScript(s));
     return 0;
 }
@@ -2692,6 +2770,7 @@ static int on_worldvar_changed(lua_State *s)
     luaL_checktype(s, 2, LUA_TFUNCTION);
     luaL_argcheck(s, key[0] != 0, 2, "empty variable name");
     MapComposite *m = checkCurrentMap(s);
+    checkMapState(s, m);
     m->setWorldVariableCallback(key, getScript(s));
     return 0;
 }
@@ -2797,98 +2876,463 @@ static int log(lua_State *s)
 }
 
 
+/**
+ * Returns the number of ticks closest to the seconds given as argument, at
+ * least one. Raises an error when the seconds are not a number or more than
+ * the scheduler can wait.
+ */
+static int checkSeconds(lua_State *s, int p)
+{
+    const lua_Number seconds = luaL_checknumber(s, p);
+
+    // Computed in floating point, since the milliseconds of a long delay do
+    // not fit into an int
+    const double ticks = floor(seconds * 1000 / GameState::getTickLength()
+                               + 0.5);
+    luaL_argcheck(s, ticks == ticks, p, "not a number");
+    luaL_argcheck(s, ticks <= Scheduler::MAX_TICKS, p, "delay too long");
+    return std::max(1, (int) std::max(ticks, 0.0));
+}
+
+/**
+ * Schedules the function given as second argument with the current map as
+ * context and pushes the handle of the job.
+ */
+static int scheduleJob(lua_State *s, int delay, int interval)
+{
+    luaL_checktype(s, 2, LUA_TFUNCTION);
+
+    Script *script = getScript(s);
+    const Script::Context *context = script->getContext();
+
+    lua_pushvalue(s, 2);
+    Script::Ref function = luaL_ref(s, LUA_REGISTRYINDEX);
+    const Scheduler::Handle handle = script->getScheduler().schedule(
+            function, context ? context->map : 0, delay, interval);
+    if (!handle)
+        luaL_error(s, "too many scheduled jobs");
+
+    lua_pushinteger(s, handle);
+    return 1;
+}
+
+/** LUA schedule_in (scheduling)
+ * schedule_in(number seconds, function() [function body] end)
+ **
+ * **Return value:** A handle for cancelling the job with
+ * [schedule_cancel](scripting.html#schedule_cancel).
+ *
+ * Executes the `function body` in `seconds` seconds, rounded to the nearest
+ * tick. The function body runs with the current map as map context.
+ */
+static int schedule_in(lua_State *s)
+{
+    return scheduleJob(s, checkSeconds(s, 1), 0);
+}
+
+/** LUA schedule_every (scheduling)
+ * schedule_every(number seconds, function() [function body] end)
+ **
+ * **Return value:** A handle for cancelling the job with
+ * [schedule_cancel](scripting.html#schedule_cancel).
+ *
+ * Executes the `function body` every `seconds` seconds from now on, rounded
+ * to the nearest tick. The function body runs with the current map as map
+ * context.
+ */
+static int schedule_every(lua_State *s)
+{
+    const int ticks = checkSeconds(s, 1);
+    return scheduleJob(s, ticks, ticks);
+}
+
+/** LUA schedule_in_ticks (scheduling)
+ * schedule_in_ticks(int ticks, function() [function body] end)
+ **
+ * **Return value:** A handle for cancelling the job with
+ * [schedule_cancel](scripting.html#schedule_cancel).
+ *
+ * Executes the `function body` after `ticks` game ticks, at least one.
+ */
+static int schedule_in_ticks(lua_State *s)
+{
+    return scheduleJob(s, luaL_checkint(s, 1), 0);
+}
+
+/** LUA schedule_every_ticks (scheduling)
+ * schedule_every_ticks(int ticks, function() [function body] end)
+ **
+ * **Return value:** A handle for cancelling the job with
+ * [schedule_cancel](scripting.html#schedule_cancel).
+ *
+ * Executes the `function body` every `ticks` game ticks from now on, at
+ * least every tick.
+ */
+static int schedule_every_ticks(lua_State *s)
+{
+    const int ticks = std::max(1, luaL_checkint(s, 1));
+    return scheduleJob(s, ticks, ticks);
+}
+
+/** LUA schedule_cancel (scheduling)
+ * schedule_cancel(handle job)
+ **
+ * **Return value:** True if the job was cancelled, false if it already ran
+ * or was cancelled before.
+ *
+ * Cancels a job returned by one of the schedule functions. A job may cancel
+ * itself while it runs.
+ */
+static int schedule_cancel(lua_State *s)
+{
+    const Scheduler::Handle handle = luaL_checkinteger(s, 1);
+    lua_pushboolean(s, getScript(s)->getScheduler().cancel(handle));
+    return 1;
+}
+
+
 /** LUA_CATEGORY Area of Effect (area)
  * In order to easily use area of effects in your items or in your scripts,
  * the following functions are available:
  */
 
-/** LUA get_beings_in_circle (area)
- * get_beings_in_circle(int x, int y, int radius)
- * get_beings_in_circle(handle actor, int radius)
- **
- * **Return value:** This function returns a lua table of all beings in a
- * circle of radius (in pixels) `radius` centered either at the pixel at
- * (`x`, `y`) or at the position of `being`.
+/**
+ * Options of a query for the beings in an area.
  */
-static int get_beings_in_circle(lua_State *s)
+struct BeingQuery
+{
+    unsigned typeMask;      /**< Bit for each entity type to include. */
+    unsigned maxResults;    /**< Number of beings returned, 0 for all. */
+    bool sortByDistance;    /**< Whether the closest beings come first. */
+    Point center;           /**< Point the distances are measured from. */
+};
+
+/** Types of the beings found by a query without type filter. */
+static const unsigned BEING_TYPE_MASK =
+        1 << OBJECT_NPC | 1 << OBJECT_MONSTER | 1 << OBJECT_CHARACTER;
+
+/**
+ * Beings found by the queries. Queries made by the callbacks of another query
+ * add their results behind those of the running one.
+ */
+static std::vector<Entity *> queryResults;
+
+/**
+ * Reads the type filter, the maximum number of results and the sorting flag
+ * of a query from the arguments from \a p up to \a last. The type filter is
+ * a single type or a table of types.
+ */
+static void checkBeingQuery(lua_State *s, int p, int last, BeingQuery &query)
+{
+    query.typeMask = BEING_TYPE_MASK;
+    query.maxResults = 0;
+    query.sortByDistance = false;
+
+    if (p <= last && lua_isnumber(s, p))
+    {
+        const int type = lua_tointeger(s, p);
+        luaL_argcheck(s, type >= 0 && type < 32, p, "invalid type");
+        query.typeMask = 1 << type;
+    }
+    else if (p <= last && lua_istable(s, p))
+    {
+        query.typeMask = 0;
+        for (int i = 1;; ++i)
+        {
+            lua_rawgeti(s, p, i);
+            if (lua_isnil(s, -1))
+            {
+                lua_pop(s, 1);
+                break;
+            }
+            const int type = lua_tointeger(s, -1);
+            luaL_argcheck(s, lua_isnumber(s, -1) && type >= 0 && type < 32,
+                          p, "invalid type");
+            query.typeMask |= 1 << type;
+            lua_pop(s, 1);
+        }
+    }
+    else if (p <= last)
+    {
+        luaL_argcheck(s, lua_isnil(s, p), p, "type or table of types expected");
+    }
+
+    if (p + 1 <= last)
+        query.maxResults = std::max(0, luaL_optint(s, p + 1, 0));
+    if (p + 2 <= last && !lua_isnil(s, p + 2))
+        query.sortByDistance = checkOptionalBool(s, p + 2, false);
+}
+
+/**
+ * Orders beings by their distance to a point. Beings at the same distance
+ * are ordered by their public ID, so that the results do not depend on the
+ * order of the beings in the zones.
+ */
+struct CloserTo
+{
+    CloserTo(const Point &center) : center(center) {}
+
+    int distance(Entity *being) const
+    {
+        const Point &pos =
+                being->getComponent<ActorComponent>()->getPosition();
+        const int dx = pos.x - center.x;
+        const int dy = pos.y - center.y;
+        return dx * dx + dy * dy;
+    }
+
+    bool operator()(Entity *a, Entity *b) const
+    {
+        const int distanceA = distance(a);
+        const int distanceB = distance(b);
+        if (distanceA != distanceB)
+            return distanceA < distanceB;
+        return a->getComponent<ActorComponent>()->getPublicID() <
+               b->getComponent<ActorComponent>()->getPublicID();
+    }
+
+    Point center;
+};
+
+/**
+ * Sorts the beings a query found behind \a begin, when requested, and drops
+ * those beyond the maximum number of results.
+ */
+static void finishBeingQuery(const BeingQuery &query, size_t begin)
+{
+    size_t count = queryResults.size() - begin;
+    if (query.maxResults && query.maxResults < count)
+        count = query.maxResults;
+
+    if (query.sortByDistance)
+    {
+        std::partial_sort(queryResults.begin() + begin,
+                          queryResults.begin() + begin + count,
+                          queryResults.end(),
+                          CloserTo(query.center));
+    }
+
+    queryResults.resize(begin + count);
+}
+
+/**
+ * Reads the area and the options of a circle query starting at argument
+ * \a p, and adds the beings in the circle to the query results.
+ */
+static void findBeingsInCircle(lua_State *s, int p, int last)
 {
     int x, y, r;
-    if (lua_isuserdata(s, 1))
+    if (lua_isuserdata(s, p))
     {
-        Entity *b = checkActor(s, 1);
+        Entity *b = checkActor(s, p);
         const Point &pos = b->getComponent<ActorComponent>()->getPosition();
         x = pos.x;
         y = pos.y;
-        r = luaL_checkint(s, 2);
+        r = luaL_checkint(s, p + 1);
+        p += 2;
     }
     else
     {
-        x = luaL_checkint(s, 1);
-        y = luaL_checkint(s, 2);
-        r = luaL_checkint(s, 3);
+        x = luaL_checkint(s, p);
+        y = luaL_checkint(s, p + 1);
+        r = luaL_checkint(s, p + 2);
+        p += 3;
     }
 
+    BeingQuery query;
+    checkBeingQuery(s, p, last, query);
+    query.center = Point(x, y);
+
     MapComposite *m = checkCurrentMap(s);
 
-    //create a lua table with the beings in the given area.
-    lua_newtable(s);
-    int tableStackPosition = lua_gettop(s);
-    int tableIndex = 1;
-    for (BeingIterator i(m->getAroundPointIterator(Point(x, y), r)); i; ++i)
+    const size_t begin = queryResults.size();
+    for (BeingIterator i(m->getAroundPointIterator(query.center, r)); i; ++i)
     {
         Entity *b = *i;
-        char t = b->getType();
-        if (t == OBJECT_NPC || t == OBJECT_CHARACTER || t == OBJECT_MONSTER)
+        if (!(query.typeMask & 1 << b->getType()))
+            continue;
+
+        auto *actorComponent = b->getComponent<ActorComponent>();
+        if (Collision::circleWithCircle(actorComponent->getPosition(),
+                                        actorComponent->getSize(),
+                                        query.center, r))
         {
-            auto *actorComponent = b->getComponent<ActorComponent>();
-            if (Collision::circleWithCircle(actorComponent->getPosition(),
-                                            actorComponent->getSize(),
-                                            Point(x, y), r))
-            {
-                push(s, b);
-                lua_rawseti(s, tableStackPosition, tableIndex);
-                tableIndex++;
-            }
+            queryResults.push_back(b);
         }
     }
 
-    return 1;
+    finishBeingQuery(query, begin);
 }
 
-/** LUA get_beings_in_rectangle (area)
- * get_beings_in_rectangle(int x, int y, int width, int height)
- **
- * **Return value:** An table of being entities within the rectangle.
- * All parameters have to be passed as pixels.
+/**
+ * Reads the area and the options of a rectangle query starting at argument
+ * \a p, and adds the beings in the rectangle to the query results. Distances
+ * are measured from the center of the rectangle.
  */
-static int get_beings_in_rectangle(lua_State *s)
+static void findBeingsInRectangle(lua_State *s, int p, int last)
 {
-    const int x = luaL_checkint(s, 1);
-    const int y = luaL_checkint(s, 2);
-    const int w = luaL_checkint(s, 3);
-    const int h = luaL_checkint(s, 4);
+    const int x = luaL_checkint(s, p);
+    const int y = luaL_checkint(s, p + 1);
+    const int w = luaL_checkint(s, p + 2);
+    const int h = luaL_checkint(s, p + 3);
+
+    BeingQuery query;
+    checkBeingQuery(s, p + 4, last, query);
+    query.center = Point(x + w / 2, y + h / 2);
 
     MapComposite *m = checkCurrentMap(s);
 
-    //create a lua table with the beings in the given area.
-    lua_newtable(s);
-    int tableStackPosition = lua_gettop(s);
-    int tableIndex = 1;
+    const size_t begin = queryResults.size();
     Rectangle rect = {x, y ,w, h};
     for (BeingIterator i(m->getInsideRectangleIterator(rect)); i; ++i)
     {
         Entity *b = *i;
-        char t = b->getType();
-        if ((t == OBJECT_NPC || t == OBJECT_CHARACTER || t == OBJECT_MONSTER) &&
+        if ((query.typeMask & 1 << b->getType()) &&
             rect.contains(b->getComponent<ActorComponent>()->getPosition()))
         {
-            push(s, b);
-            lua_rawseti(s, tableStackPosition, tableIndex);
-            tableIndex++;
+            queryResults.push_back(b);
+        }
+    }
+
+    finishBeingQuery(query, begin);
+}
+
+/**
+ * Pushes the beings a query found behind \a begin as a table and removes
+ * them from the query results.
+ */
+static int pushBeingQuery(lua_State *s, size_t begin)
+{
+    lua_createtable(s, queryResults.size() - begin, 0);
+    int tableStackPosition = lua_gettop(s);
+    int tableIndex = 1;
+    for (size_t i = begin; i < queryResults.size(); ++i)
+    {
+        push(s, queryResults[i]);
+        lua_rawseti(s, tableStackPosition, tableIndex);
+        tableIndex++;
+    }
+
+    queryResults.resize(begin);
+    return 1;
+}
+
+/**
+ * Calls the function at argument \a callback for each being a query found
+ * behind \a begin, until it returns true, and removes them from the query
+ * results.
+ */
+static int callBeingQuery(lua_State *s, int callback, size_t begin)
+{
+    for (size_t i = begin; i < queryResults.size(); ++i)
+    {
+        lua_pushvalue(s, callback);
+        push(s, queryResults[i]);
+        if (lua_pcall(s, 1, 1, 0))
+        {
+            queryResults.resize(begin);
+            return lua_error(s);
         }
+
+        const bool stop = lua_toboolean(s, -1);
+        lua_pop(s, 1);
+        if (stop)
+            break;
     }
-     return 1;
- }
+
+    queryResults.resize(begin);
+    return 0;
+}
+
+/** LUA get_beings_in_circle (area)
+ * get_beings_in_circle(int x, int y, int radius
+ *                      [, int type [, int max_results [, bool sort]]])
+ * get_beings_in_circle(handle actor, int radius
+ *                      [, int type [, int max_results [, bool sort]]])
+ **
+ * **Return value:** This function returns a lua table of all beings in a
+ * circle of radius (in pixels) `radius` centered either at the pixel at
+ * (`x`, `y`) or at the position of `being`.
+ *
+ * Only beings of the given `type` are returned when it is set, which can
+ * also be a table of types like `{ TYPE_MONSTER, TYPE_CHARACTER }`. When
+ * `sort` is true the closest beings come first. At most `max_results` beings
+ * are returned when it is positive, the closest ones when sorting.
+ */
+static int get_beings_in_circle(lua_State *s)
+{
+    const size_t begin = queryResults.size();
+    findBeingsInCircle(s, 1, lua_gettop(s));
+    return pushBeingQuery(s, begin);
+}
+
+/** LUA get_beings_in_rectangle (area)
+ * get_beings_in_rectangle(int x, int y, int width, int height
+ *                         [, int type [, int max_results [, bool sort]]])
+ **
+ * **Return value:** An table of being entities within the rectangle.
+ * All parameters have to be passed as pixels.
+ *
+ * The optional arguments work as for
+ * [get_beings_in_circle](scripting.html#get_beings_in_circle), distances
+ * are measured from the center of the rectangle.
+ */
+static int get_beings_in_rectangle(lua_State *s)
+{
+    const size_t begin = queryResults.size();
+    findBeingsInRectangle(s, 1, lua_gettop(s));
+    return pushBeingQuery(s, begin);
+}
+
+/** LUA for_each_being_in_circle (area)
+ * for_each_being_in_circle(int x, int y, int radius
+ *                          [, int type [, int max_results [, bool sort]]],
+ *                          function callback)
+ * for_each_being_in_circle(handle actor, int radius
+ *                          [, int type [, int max_results [, bool sort]]],
+ *                          function callback)
+ **
+ * Calls `callback` with each being that
+ * [get_beings_in_circle](scripting.html#get_beings_in_circle) would return,
+ * without creating a table. The iteration stops early when `callback`
+ * returns true. The callback cannot yield.
+ *
+ * **Example:**
+ * {% highlight lua %}
+ * for_each_being_in_circle(mob, 200, TYPE_CHARACTER, 1, true, function(ch)
+ *     mob:say("I see you, " .. ch:name())
+ * end)
+ * {% endhighlight %}
+ */
+static int for_each_being_in_circle(lua_State *s)
+{
+    const int callback = lua_gettop(s);
+    luaL_checktype(s, callback, LUA_TFUNCTION);
+
+    const size_t begin = queryResults.size();
+    findBeingsInCircle(s, 1, callback - 1);
+    return callBeingQuery(s, callback, begin);
+}
+
+/** LUA for_each_being_in_rectangle (area)
+ * for_each_being_in_rectangle(int x, int y, int width, int height
+ *                             [, int type [, int max_results [, bool sort]]],
+ *                             function callback)
+ **
+ * Calls `callback` with each being that
+ * [get_beings_in_rectangle](scripting.html#get_beings_in_rectangle) would
+ * return, without creating a table. The iteration stops early when
+ * `callback` returns true. The callback cannot yield.
+ */
+static int for_each_being_in_rectangle(lua_State *s)
+{
+    const int callback = lua_gettop(s);
+    luaL_checktype(s, callback, LUA_TFUNCTION);
+
+    const size_t begin = queryResults.size();
+    findBeingsInRectangle(s, 1, callback - 1);
+    return callBeingQuery(s, callback, begin);
+}
 
 /** LUA get_distance (area)
  * get_distance(handle being1, handle being2)
@@ -2977,6 +3421,7 @@ static int abilityinfo_on_use(lua_State *s)
     auto *info = LuaAbilityInfo::check(s, 1);
     Script *script = getScript(s);
     luaL_checktype(s, 2, LUA_TFUNCTION);
+    checkGlobalState(s);
     script->assignCallback(info->useCallback);
     return 0;
 }
@@ -2995,6 +3440,7 @@ static int abilityinfo_on_recharged(lua_State *s)
     auto *info = LuaAbilityInfo::check(s, 1);
     Script *script = getScript(s);
     luaL_checktype(s, 2, LUA_TFUNCTION);
+    checkGlobalState(s);
     script->assignCallback(info->rechargedCallback);
     return 0;
 }
@@ -3070,6 +3516,7 @@ static int status_effect_on_tick(lua_State *s)
 {
     StatusEffect *statusEffect = LuaStatusEffect::check(s, 1);
     luaL_checktype(s, 2, LUA_TFUNCTION);
+    checkGlobalState(s);
     statusEffect->setTickCallback(getScript(s));
     return 0;
 }
@@ -3116,6 +3563,7 @@ static int monster_class_on_update(lua_State *s)
 {
     MonsterClass *monsterClass = LuaMonsterClass::check(s, 1);
     luaL_checktype(s, 2, LUA_TFUNCTION);
+    checkGlobalState(s);
     monsterClass->setUpdateCallback(getScript(s));
     return 0;
 }
@@ -3283,6 +3731,7 @@ static int item_class_on(lua_State *s)
     ItemClass *itemClass = LuaItemClass::check(s, 1);
     const char *event = luaL_checkstring(s, 2);
     luaL_checktype(s, 3, LUA_TFUNCTION);
+    checkGlobalState(s);
     itemClass->setEventCallback(event, getScript(s));
     return 0;
 }
@@ -3375,7 +3824,8 @@ static int require_loader(lua_State *s)
 LuaScript::LuaScript():
     nbArgs(-1)
 {
-    mRootState = luaL_newstate();
+    mRootState = lua_newstate(allocate, nullptr);
+    lua_atpanic(mRootState, panic);
     mCurrentState = mRootState;
     luaL_openlibs(mRootState);
 
@@ -3407,6 +3857,7 @@ LuaScript::LuaScript():
         { "on_mapvar_changed",              on_mapvar_changed                 },
         { "on_worldvar_changed",            on_worldvar_changed               },
         { "on_mapupdate",                   on_mapupdate                      },
+        { "on_map_message",                 on_map_message                    },
         { "get_item_class",                 get_item_class                    },
         { "get_monster_class",              get_monster_class                 },
         { "get_monster_classes",            get_monster_classes               },
@@ -3433,6 +3884,8 @@ LuaScript::LuaScript():
         { "trigger_create",                 trigger_create                    },
         { "get_beings_in_circle",           get_beings_in_circle              },
         { "get_beings_in_rectangle",        get_beings_in_rectangle           },
+        { "for_each_being_in_circle",       for_each_being_in_circle          },
+        { "for_each_being_in_rectangle",    for_each_being_in_rectangle       },
         { "get_character_by_name",          get_character_by_name             },
         { "effect_create",                  effect_create                     },
         { "test_tableget",                  test_tableget                     },
@@ -3441,8 +3894,14 @@ LuaScript::LuaScript():
         { "is_walkable",                    is_walkable                       },
         { "get_path_length",                get_path_length                   },
         { "map_get_pvp",                    map_get_pvp                       },
+        { "post_map_message",               post_map_message                  },
         { "item_drop",                      item_drop                         },
         { "log",                            log                               },
+        { "schedule_in",                    schedule_in                       },
+        { "schedule_every",                 schedule_every                    },
+        { "schedule_in_ticks",              schedule_in_ticks                 },
+        { "schedule_every_ticks",           schedule_every_ticks              },
+        { "schedule_cancel",                schedule_cancel                   },
         { "get_distance",                   get_distance                      },
         { "map_get_objects",                map_get_objects                   },
         { "announce",                       announce                          },
@@ -23,18 +23,25 @@
 
 #include "scripting/luautil.h"
 #include "scripting/scriptmanager.h"
+#include "scripting/scriptprofiler.h"
 
 #include "game-server/charactercomponent.h"
 #include "utils/logger.h"
+#include "utils/string.h"
+#include "utils/tracer.h"
 
 #include <cassert>
+#include <cstdlib>
 #include <cstring>
 
-Script::Ref LuaScript::mDeathNotificationCallback;
-Script::Ref LuaScript::mRemoveNotificationCallback;
+/** Instructions executed between two samples of the script profiler. */
+static const int SAMPLE_INSTRUCTIONS = 10000;
+
 
 const char LuaScript::registryKey = 0;
 
+uint64_t LuaScript::mAllocatedBytes = 0;
+
 LuaScript::~LuaScript()
 {
     lua_close(mRootState);
@@ -120,10 +127,63 @@ void LuaScript::push(AttributeInfo *attributeInfo)
     ++nbArgs;
 }
 
+/**
+ * Returns where the function at the given stack index was defined, for
+ * identifying callbacks in traces.
+ */
+static std::string functionLocation(lua_State *s, int index)
+{
+    lua_Debug ar;
+    lua_pushvalue(s, index);
+    lua_getinfo(s, ">S", &ar);
+    return std::string(ar.short_src) + ":" + utils::toString(ar.linedefined);
+}
+
+/**
+ * Counts a sample of the line being executed for the script profiler.
+ */
+static void sampleHook(lua_State *s, lua_Debug *ar)
+{
+    if (lua_getinfo(s, "Sl", ar))
+    {
+        ScriptProfiler::recordSample(std::string(ar->short_src) + ":" +
+                                     utils::toString(ar->currentline));
+    }
+}
+
+/**
+ * Installs or removes the sampling hook on the given state, following the
+ * script profiler. The threads created later inherit the hook.
+ */
+static void updateSampleHook(lua_State *s)
+{
+    const bool sampling = ScriptProfiler::isSampling();
+    if (sampling == (lua_gethook(s) == sampleHook))
+        return;
+
+    if (sampling)
+        lua_sethook(s, sampleHook, LUA_MASKCOUNT, SAMPLE_INSTRUCTIONS);
+    else
+        lua_sethook(s, nullptr, 0, 0);
+}
+
 int LuaScript::execute(const Context &context)
 {
     assert(nbArgs >= 0);
 
+    utils::TraceSpan span("lua", "callback");
+    const bool profiling = ScriptProfiler::isEnabled();
+    if (span.isRecording() || profiling)
+    {
+        const std::string location =
+                functionLocation(mCurrentState, -(nbArgs + 1));
+        if (span.isRecording())
+            span.setDetail(location);
+        if (profiling)
+            ScriptProfiler::enterCall(location, mAllocatedBytes);
+    }
+    updateSampleHook(mCurrentState);
+
     const Context *previousContext = mContext;
     mContext = &context;
 
@@ -131,6 +191,9 @@ int LuaScript::execute(const Context &context)
     nbArgs = -1;
     int res = lua_pcall(mCurrentState, tmpNbArgs, 1, 1);
 
+    if (profiling)
+        ScriptProfiler::leaveCall(mAllocatedBytes);
+
     if (res || !(lua_isnil(mCurrentState, -1) || lua_isnumber(mCurrentState, -1)))
     {
         const char *s = lua_tostring(mCurrentState, -1);
@@ -139,6 +202,7 @@ int LuaScript::execute(const Context &context)
                  << "     Script  : " << mScriptFile << std::endl
                  << "     Error   : " << (s ? s : "") << std::endl);
         lua_pop(mCurrentState, 1);
+        mContext = previousContext;
         return 0;
     }
     res = lua_tointeger(mCurrentState, -1);
@@ -152,6 +216,26 @@ bool LuaScript::resume()
     assert(nbArgs >= 0);
     assert(mCurrentThread);
 
+    utils::TraceSpan span("lua", "thread");
+    const bool profiling = ScriptProfiler::isEnabled();
+
+    // Only a thread that did not start yet has its function on the stack.
+    // Its location is looked up once, and only while someone is looking.
+    LuaThread *thread = static_cast<LuaThread*>(mCurrentThread);
+    if ((span.isRecording() || profiling) && thread->mLocation.empty())
+    {
+        if (lua_status(mCurrentState) == 0)
+            thread->mLocation = functionLocation(mCurrentState, -(nbArgs + 1));
+        else
+            thread->mLocation = "?";    // Started before anyone looked
+    }
+
+    if (span.isRecording())
+        span.setDetail(thread->mLocation);
+    if (profiling)
+        ScriptProfiler::enterCall(thread->mLocation, mAllocatedBytes);
+    updateSampleHook(mCurrentState);
+
     const Context *previousContext = mContext;
     mContext = &mCurrentThread->getContext();
 
@@ -163,6 +247,9 @@ bool LuaScript::resume()
     int result = lua_resume(mCurrentState, nullptr, tmpNbArgs);
 #endif
 
+    if (profiling)
+        ScriptProfiler::leaveCall(mAllocatedBytes);
+
     if (result == 0)                // Thread is done
     {
         if (lua_gettop(mCurrentState) > 0)
@@ -311,6 +398,31 @@ void LuaScript::getPostCallback(Entity *q,
 }
 
 
+void *LuaScript::allocate(void *, void *ptr, size_t oldSize, size_t newSize)
+{
+    if (newSize == 0)
+    {
+        free(ptr);
+        return nullptr;
+    }
+
+    // Without a block, the old size may tell the type of the new object
+    if (!ptr)
+        oldSize = 0;
+    if (newSize > oldSize)
+        mAllocatedBytes += newSize - oldSize;
+
+    return realloc(ptr, newSize);
+}
+
+int LuaScript::panic(lua_State *s)
+{
+    const char *message = lua_tostring(s, -1);
+    LOG_FATAL("Unprotected error in a Lua script: "
+              << (message ? message : ""));
+    return 0;
+}
+
 LuaScript::LuaThread::LuaThread(LuaScript *script) :
     Thread(script)
 {
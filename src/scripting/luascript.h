@@ -26,6 +26,8 @@ extern "C" {
 #include <lauxlib.h>
 }
 
+#include <stdint.h>
+
 #include "scripting/script.h"
 
 class CharacterComponent;
@@ -82,10 +84,12 @@ class LuaScript : public Script
 
 
         static void setDeathNotificationCallback(Script *script)
-        { script->assignCallback(mDeathNotificationCallback); }
+        { script->assignCallback(static_cast<LuaScript *>(script)
+                                 ->mDeathNotificationCallback); }
 
         static void setRemoveNotificationCallback(Script *script)
-        { script->assignCallback(mRemoveNotificationCallback); }
+        { script->assignCallback(static_cast<LuaScript *>(script)
+                                 ->mRemoveNotificationCallback); }
 
         static const char registryKey;
 
@@ -98,14 +102,30 @@ class LuaScript : public Script
 
                 lua_State *mState;
                 int mRef;
+                std::string mLocation;  /**< Where its function is defined. */
         };
 
+        /**
+         * Allocates the memory of the Lua states, counting the allocated
+         * bytes for the script profiler.
+         */
+        static void *allocate(void *, void *ptr, size_t oldSize,
+                              size_t newSize);
+
+        /**
+         * Logs errors raised outside of protected calls.
+         */
+        static int panic(lua_State *s);
+
+        /** Bytes allocated by all Lua states so far. */
+        static uint64_t mAllocatedBytes;
+
         lua_State *mRootState;
         lua_State *mCurrentState;
         int nbArgs;
 
-        static Ref mDeathNotificationCallback;
-        static Ref mRemoveNotificationCallback;
+        Ref mDeathNotificationCallback;
+        Ref mRemoveNotificationCallback;
 
         friend class LuaThread;
 };
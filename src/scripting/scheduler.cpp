@@ -0,0 +1,239 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "scripting/scheduler.h"
+
+#include "game-server/state.h"
+
+#include <algorithm>
+
+static const int ROOT_BITS = 8;
+static const int LEVEL_BITS = 6;
+static const int LEVELS = 3;            /**< Levels above the root. */
+
+static const unsigned ROOT_SIZE = 1 << ROOT_BITS;
+static const unsigned LEVEL_SIZE = 1 << LEVEL_BITS;
+static const unsigned ROOT_MASK = ROOT_SIZE - 1;
+static const unsigned LEVEL_MASK = LEVEL_SIZE - 1;
+
+/** Longest delay the wheel can hold, longer ones are moved down early. */
+static const unsigned MAX_DELAY = (1u << (ROOT_BITS + LEVELS * LEVEL_BITS)) - 1;
+
+/** Index of the list of jobs being run, after the heads of the slots. */
+static const unsigned DUE_LIST = ROOT_SIZE + LEVELS * LEVEL_SIZE;
+static const unsigned FIRST_JOB = DUE_LIST + 1;
+
+/** Handles store the index of the entry below its generation. */
+static const int INDEX_BITS = 20;
+static const unsigned INDEX_MASK = (1 << INDEX_BITS) - 1;
+static const unsigned GENERATION_MASK = (1 << (31 - INDEX_BITS)) - 1;
+
+Scheduler::Scheduler(Script *script):
+    mScript(script),
+    mEntries(FIRST_JOB),
+    mFreeEntry(0),
+    mTick(GameState::getCurrentTick() + 1),
+    mJobCount(0)
+{
+    for (unsigned i = 0; i < FIRST_JOB; ++i)
+        mEntries[i].prev = mEntries[i].next = i;
+}
+
+Scheduler::Handle Scheduler::schedule(Script::Ref function,
+                                      MapComposite *map,
+                                      int delay, int interval)
+{
+    unsigned index = mFreeEntry;
+    if (index)
+    {
+        mFreeEntry = mEntries[index].next;
+    }
+    else if (mEntries.size() <= INDEX_MASK)
+    {
+        index = mEntries.size();
+        mEntries.push_back(Entry());
+    }
+    else
+    {
+        mScript->unref(function);
+        return 0;
+    }
+
+    Entry &entry = mEntries[index];
+    entry.expires = mTick - 1 + std::max(1, delay);
+    entry.interval = interval;
+    entry.function = function;
+    entry.map = map;
+    insert(index);
+    ++mJobCount;
+
+    return (entry.generation & GENERATION_MASK) << INDEX_BITS | index;
+}
+
+bool Scheduler::cancel(Handle handle)
+{
+    const unsigned index = handle & INDEX_MASK;
+    if (index < FIRST_JOB || index >= mEntries.size())
+        return false;
+
+    Entry &entry = mEntries[index];
+    if (!entry.function.isValid() ||
+        (entry.generation & GENERATION_MASK) != handle >> INDEX_BITS)
+        return false;
+
+    unlink(index);
+    mScript->unref(entry.function);
+    release(index);
+    return true;
+}
+
+void Scheduler::update(int tick)
+{
+    while ((int) (tick - mTick) >= 0)
+    {
+        const unsigned slot = mTick & ROOT_MASK;
+
+        // Move the jobs of the next slot above down when a level wraps
+        if (slot == 0)
+        {
+            for (int level = 0; level < LEVELS; ++level)
+            {
+                const int shift = ROOT_BITS + level * LEVEL_BITS;
+                if (cascade(level, (mTick >> shift) & LEVEL_MASK) != 0)
+                    break;
+            }
+        }
+
+        // Take the due jobs out of the wheel first, so that jobs scheduled
+        // or cancelled by the called functions do not disturb the iteration
+        Entry &due = mEntries[DUE_LIST];
+        if (mEntries[slot].next != slot)
+        {
+            due.next = mEntries[slot].next;
+            due.prev = mEntries[slot].prev;
+            mEntries[due.next].prev = DUE_LIST;
+            mEntries[due.prev].next = DUE_LIST;
+            mEntries[slot].prev = mEntries[slot].next = slot;
+        }
+
+        ++mTick;
+
+        while (mEntries[DUE_LIST].next != DUE_LIST)
+        {
+            const unsigned index = mEntries[DUE_LIST].next;
+            unlink(index);
+
+            // The entries may move while the function runs
+            Entry &entry = mEntries[index];
+            Script::Ref function = entry.function;
+            Script::Context context;
+            context.map = entry.map;
+
+            const bool repeated = entry.interval > 0;
+            if (repeated)
+            {
+                entry.expires += entry.interval;
+                insert(index);
+            }
+            else
+            {
+                release(index);
+            }
+
+            mScript->prepare(function);
+            mScript->execute(context);
+
+            // Repeated jobs keep the function until they are cancelled
+            if (!repeated)
+                mScript->unref(function);
+        }
+    }
+}
+
+void Scheduler::insert(unsigned index)
+{
+    Entry &entry = mEntries[index];
+    const unsigned delay = entry.expires - mTick;
+
+    unsigned head;
+    if ((int) delay < 0)
+    {
+        head = mTick & ROOT_MASK;
+    }
+    else if (delay < ROOT_SIZE)
+    {
+        head = entry.expires & ROOT_MASK;
+    }
+    else
+    {
+        // Jobs beyond the range of the wheel wait in the farthest slot and
+        // are placed again when it is moved down
+        const unsigned expires = delay > MAX_DELAY ? mTick + MAX_DELAY
+                                                   : entry.expires;
+        int level = 0;
+        while ((delay >> (ROOT_BITS + (level + 1) * LEVEL_BITS)) &&
+               level < LEVELS - 1)
+            ++level;
+
+        const int shift = ROOT_BITS + level * LEVEL_BITS;
+        head = ROOT_SIZE + level * LEVEL_SIZE +
+               ((expires >> shift) & LEVEL_MASK);
+    }
+
+    link(index, head);
+}
+
+void Scheduler::link(unsigned index, unsigned head)
+{
+    Entry &entry = mEntries[index];
+    entry.next = head;
+    entry.prev = mEntries[head].prev;
+    mEntries[entry.prev].next = index;
+    mEntries[head].prev = index;
+}
+
+void Scheduler::unlink(unsigned index)
+{
+    Entry &entry = mEntries[index];
+    mEntries[entry.prev].next = entry.next;
+    mEntries[entry.next].prev = entry.prev;
+}
+
+void Scheduler::release(unsigned index)
+{
+    Entry &entry = mEntries[index];
+    entry.function = Script::Ref();
+    ++entry.generation;
+    entry.next = mFreeEntry;
+    mFreeEntry = index;
+    --mJobCount;
+}
+
+int Scheduler::cascade(int level, int slot)
+{
+    const unsigned head = ROOT_SIZE + level * LEVEL_SIZE + slot;
+    while (mEntries[head].next != head)
+    {
+        const unsigned index = mEntries[head].next;
+        unlink(index);
+        insert(index);
+    }
+    return slot;
+}
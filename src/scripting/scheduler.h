@@ -0,0 +1,122 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SCRIPTING_SCHEDULER_H
+#define SCRIPTING_SCHEDULER_H
+
+#include "scripting/script.h"
+
+#include <climits>
+#include <vector>
+
+class MapComposite;
+
+/**
+ * Calls script functions after a number of ticks, once or repeatedly.
+ *
+ * The jobs are kept in a hierarchical timer wheel. The lowest level has a
+ * slot for each of the next 256 ticks, and each of the three levels above
+ * covers 64 times the range of the level below it, which is about 77 days at
+ * 100 ms ticks. When a level wraps around, the jobs of the next slot above
+ * are moved down. Scheduling and cancelling a job take constant time, and a
+ * tick only touches the jobs that are due or move down a level.
+ *
+ * A job belongs to the map that was the script context when it was
+ * scheduled, and runs with that map as context.
+ */
+class Scheduler
+{
+    public:
+        /**
+         * Identifies a scheduled job. A handle stops matching once its job
+         * has run or was cancelled, until the job's slot has been reused
+         * two thousand times.
+         */
+        typedef unsigned Handle;
+
+        /**
+         * Longest delay and interval in ticks. Jobs beyond the range of the
+         * timing wheel wait in its farthest slot, so this only keeps the
+         * tick arithmetic from overflowing.
+         */
+        static const int MAX_TICKS = INT_MAX / 2;
+
+        Scheduler(Script *script);
+
+        /**
+         * Schedules the function to be called after the given number of
+         * ticks, at least one, and then every \a interval ticks when it is
+         * positive. The scheduler takes over the reference to the function.
+         *
+         * @return the handle of the job, or 0 when there are too many jobs.
+         */
+        Handle schedule(Script::Ref function, MapComposite *map,
+                        int delay, int interval = 0);
+
+        /**
+         * Cancels a job.
+         *
+         * @return false when the job already ran, was cancelled before or
+         *         the handle is invalid.
+         */
+        bool cancel(Handle handle);
+
+        /**
+         * Calls the functions of the jobs that are due up to and including
+         * the given tick.
+         */
+        void update(int tick);
+
+        /**
+         * Returns the number of scheduled jobs.
+         */
+        unsigned getJobCount() const
+        { return mJobCount; }
+
+    private:
+        /**
+         * A job, or the head of a list of jobs. The jobs of a slot are kept
+         * in a circular list, linked by index so the entries can grow.
+         */
+        struct Entry
+        {
+            unsigned prev;
+            unsigned next;
+            unsigned expires;       /**< Tick at which the job is due. */
+            int interval;           /**< Ticks between repetitions. */
+            unsigned generation;    /**< Times the entry was released. */
+            Script::Ref function;   /**< Invalid while the entry is free. */
+            MapComposite *map;
+        };
+
+        void insert(unsigned index);
+        void link(unsigned index, unsigned head);
+        void unlink(unsigned index);
+        void release(unsigned index);
+        int cascade(int level, int slot);
+
+        Script *mScript;
+        std::vector<Entry> mEntries;    /**< List heads, then jobs. */
+        unsigned mFreeEntry;            /**< First free entry, 0 if none. */
+        unsigned mTick;                 /**< Next tick to be processed. */
+        unsigned mJobCount;
+};
+
+#endif // SCRIPTING_SCHEDULER_H
@@ -23,6 +23,8 @@
 #include "common/configuration.h"
 #include "common/resourcemanager.h"
 #include "game-server/being.h"
+#include "game-server/state.h"
+#include "scripting/scheduler.h"
 #include "utils/logger.h"
 
 #include <cassert>
@@ -35,18 +37,18 @@ typedef std::map< std::string, Script::Factory > Engines;
 
 static Engines *engines = nullptr;
 
-Script::Ref Script::mCreateNpcDelayedCallback;
-Script::Ref Script::mUpdateCallback;
-
 Script::Script():
     mCurrentThread(0),
-    mContext(0)
+    mContext(0),
+    mScheduler(new Scheduler(this))
 {}
 
 Script::~Script()
 {
     // There should be no remaining threads when the Script gets deleted
     assert(mThreads.empty());
+
+    delete mScheduler;
 }
 
 void Script::registerEngine(const std::string &name, Factory f)
@@ -78,13 +80,37 @@ Script *Script::create(const std::string &engine)
 
 void Script::update()
 {
-    if (!mUpdateCallback.isValid())
+    if (mUpdateCallback.isValid())
+    {
+        prepare(mUpdateCallback);
+        execute();
+    }
+
+    mScheduler->update(GameState::getCurrentTick());
+}
+
+void Script::initializeMap(MapComposite *map)
+{
+    if (!mMapInitializeCallback.isValid())
     {
-        LOG_ERROR("Could not find callback for update function!");
+        LOG_WARN("No callback for map initialization found");
         return;
     }
-    prepare(mUpdateCallback);
-    execute();
+
+    prepare(mMapInitializeCallback);
+    execute(map);
+}
+
+void Script::deliverMapMessage(MapComposite *map, int sender,
+                               const std::string &message)
+{
+    if (!mMapMessageCallback.isValid())
+        return;
+
+    prepare(mMapMessageCallback);
+    push(sender);
+    push(message);
+    execute(map);
 }
 
 static char *skipPotentialBom(char *text)
@@ -102,7 +128,9 @@ bool Script::loadFile(const std::string &name, const Context &context)
     if (buffer)
     {
         mScriptFile = name;
-        load(skipPotentialBom(buffer), name.c_str(), context);
+        // The '@' makes Lua report locations in the file by its name
+        const std::string chunkName = "@" + name;
+        load(skipPotentialBom(buffer), chunkName.c_str(), context);
         free(buffer);
         return true;
     } else {
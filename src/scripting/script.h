@@ -35,6 +35,7 @@
 
 class MapComposite;
 class Entity;
+class Scheduler;
 
 /**
  * Abstract interface for calling functions written in an external language.
@@ -146,10 +147,34 @@ class Script : public sigc::trackable
 
         /**
          * Called every tick for the script to manage its data.
-         * Calls the "update" function of the script by default.
+         * Calls the "update" function of the script, if any, and the
+         * scheduled functions that are due.
          */
         virtual void update();
 
+        /**
+         * Calls the map initialization function of the script, if any, with
+         * the given map as context.
+         */
+        void initializeMap(MapComposite *map);
+
+        /**
+         * Calls the map message function of the script, if any, with the
+         * target map as context.
+         *
+         * @param map     the map the message is addressed to
+         * @param sender  the id of the map that posted the message, or 0
+         * @param message the content of the message
+         */
+        void deliverMapMessage(MapComposite *map, int sender,
+                               const std::string &message);
+
+        /**
+         * Returns the scheduler calling functions of this script.
+         */
+        Scheduler &getScheduler()
+        { return *mScheduler; }
+
         /**
          * Creates a new script thread and makes it the current one. Script
          * threads do not execute in parallel, but they can suspend execution
@@ -250,10 +275,16 @@ class Script : public sigc::trackable
         virtual void processRemoveEvent(Entity *entity) = 0;
 
         static void setCreateNpcDelayedCallback(Script *script)
-        { script->assignCallback(mCreateNpcDelayedCallback); }
+        { script->assignCallback(script->mCreateNpcDelayedCallback); }
 
         static void setUpdateCallback(Script *script)
-        { script->assignCallback(mUpdateCallback); }
+        { script->assignCallback(script->mUpdateCallback); }
+
+        static void setMapInitializeCallback(Script *script)
+        { script->assignCallback(script->mMapInitializeCallback); }
+
+        static void setMapMessageCallback(Script *script)
+        { script->assignCallback(script->mMapMessageCallback); }
 
     protected:
         std::string mScriptFile;
@@ -262,9 +293,16 @@ class Script : public sigc::trackable
 
     private:
         std::vector<Thread*> mThreads;
+        Scheduler *mScheduler;
 
-        static Ref mCreateNpcDelayedCallback;
-        static Ref mUpdateCallback;
+        /*
+         * The callbacks below are used by libmana.lua, which is loaded into
+         * every script state, so each state keeps its own.
+         */
+        Ref mCreateNpcDelayedCallback;
+        Ref mUpdateCallback;
+        Ref mMapInitializeCallback;
+        Ref mMapMessageCallback;
 
     friend struct ScriptEventDispatch;
     friend class Thread;
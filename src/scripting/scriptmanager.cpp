@@ -21,20 +21,57 @@
 #include "scriptmanager.h"
 
 #include "common/configuration.h"
+#include "game-server/map.h"
+#include "game-server/mapcomposite.h"
+#include "game-server/mapmanager.h"
+#include "scripting/scheduler.h"
 #include "scripting/script.h"
+#include "utils/logger.h"
 
+#include <map>
+#include <vector>
+
+/**
+ * A message posted by a script for the scripts of another map.
+ */
+struct MapMessage
+{
+    int sender;
+    int target;
+    std::string message;
+};
+
+typedef std::map<std::string, Script *> GroupStates;
+typedef std::map<const MapComposite *, Script *> MapStates;
+
+static std::string _engine;
 static Script *_currentState;
+static bool _perMapStates;
+
+static GroupStates _groupStates;        /**< Owns the states of the maps. */
+static MapStates _mapStates;            /**< Lookup of the state of a map. */
+static std::vector<MapMessage> _mapMessages;
 
 static Script::Ref _craftCallback;
 
 void ScriptManager::initialize()
 {
-    const std::string engine = Configuration::getValue("script_engine", "lua");
-    _currentState = Script::create(engine);
+    _engine = Configuration::getValue("script_engine", "lua");
+    _perMapStates = Configuration::getBoolValue("script_perMapStates", false);
+    _currentState = Script::create(_engine);
 }
 
 void ScriptManager::deinitialize()
 {
+    for (GroupStates::iterator i = _groupStates.begin(),
+         i_end = _groupStates.end(); i != i_end; ++i)
+    {
+        delete i->second;
+    }
+    _groupStates.clear();
+    _mapStates.clear();
+    _mapMessages.clear();
+
     delete _currentState;
     _currentState = 0;
 }
@@ -49,6 +86,79 @@ Script *ScriptManager::currentState()
     return _currentState;
 }
 
+Script *ScriptManager::getState(MapComposite *map)
+{
+    if (!_perMapStates || !map)
+        return _currentState;
+
+    MapStates::const_iterator i = _mapStates.find(map);
+    if (i != _mapStates.end())
+        return i->second;
+
+    std::string group = map->getMap()->getProperty("scriptState");
+    if (group.empty())
+        group = map->getName();
+
+    Script *&state = _groupStates[group];
+    if (!state)
+    {
+        LOG_INFO("Creating script state \"" << group << "\" for map "
+                 << map->getID());
+        state = Script::create(_engine);
+    }
+
+    _mapStates[map] = state;
+    return state;
+}
+
+void ScriptManager::postMapMessage(int sender, int target,
+                                   const std::string &message)
+{
+    MapMessage mapMessage;
+    mapMessage.sender = sender;
+    mapMessage.target = target;
+    mapMessage.message = message;
+    _mapMessages.push_back(mapMessage);
+}
+
+void ScriptManager::update()
+{
+    // Messages posted while delivering are kept for the next update
+    std::vector<MapMessage> messages;
+    messages.swap(_mapMessages);
+
+    for (std::vector<MapMessage>::const_iterator i = messages.begin(),
+         i_end = messages.end(); i != i_end; ++i)
+    {
+        MapComposite *map = MapManager::getMap(i->target);
+        if (!map || !map->isActive())
+        {
+            LOG_WARN("Dropping script message for inactive map "
+                     << i->target);
+            continue;
+        }
+        getState(map)->deliverMapMessage(map, i->sender, i->message);
+    }
+
+    _currentState->update();
+    for (GroupStates::const_iterator i = _groupStates.begin(),
+         i_end = _groupStates.end(); i != i_end; ++i)
+    {
+        i->second->update();
+    }
+}
+
+unsigned ScriptManager::getScheduledJobCount()
+{
+    unsigned count = _currentState->getScheduler().getJobCount();
+    for (GroupStates::const_iterator i = _groupStates.begin(),
+         i_end = _groupStates.end(); i != i_end; ++i)
+    {
+        count += i->second->getScheduler().getJobCount();
+    }
+    return count;
+}
+
 bool ScriptManager::performCraft(Entity *crafter,
                                  const std::list<InventoryItem> &recipe)
 {
@@ -25,13 +25,21 @@
 
 #include <string>
 
+class MapComposite;
 class Script;
 
 /**
- * Manages the script states. In fact at the moment it simply provides access
- * to the single global script state, but in the future it is planned to allow
- * reloading the scripts while the server is running, by keeping old script
- * states around until they are no longer in use.
+ * Manages the script states. There is always a global script state, which
+ * runs the main script and holds the callbacks of the item, monster, ability
+ * and status effect classes. When the "script_perMapStates" option is
+ * enabled, the scripts of each map run in a state of their own, which is
+ * shared with the other maps naming the same "scriptState" map property.
+ * Such a state only loads libmana.lua, so the map scripts have to require
+ * the files they depend on themselves.
+ *
+ * In the future it is planned to allow reloading the scripts while the server
+ * is running, by keeping old script states around until they are no longer in
+ * use.
  */
 namespace ScriptManager {
 
@@ -55,6 +63,30 @@ bool loadMainScript(const std::string &file);
  */
 Script *currentState();
 
+/**
+ * Returns the script state running the scripts of the given map, creating it
+ * when needed. This is the global state unless per-map states are enabled.
+ */
+Script *getState(MapComposite *map);
+
+/**
+ * Queues a message for the given map. It is delivered to the map message
+ * callback of the state of that map at the next update.
+ *
+ * @param sender the id of the map posting the message, or 0
+ */
+void postMapMessage(int sender, int target, const std::string &message);
+
+/**
+ * Delivers the queued map messages and updates all script states.
+ */
+void update();
+
+/**
+ * Returns the number of jobs scheduled in all script states.
+ */
+unsigned getScheduledJobCount();
+
 bool performCraft(Entity *crafter, const std::list<InventoryItem> &recipe);
 
 void setCraftCallback(Script *script);
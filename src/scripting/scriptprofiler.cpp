@@ -0,0 +1,243 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "scripting/scriptprofiler.h"
+
+#include "common/configuration.h"
+#include "utils/logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <unordered_map>
+
+using ScriptProfiler::Entry;
+
+static Configuration::Setting<std::string> profileFile(
+        "log_gameScriptProfileFile", std::string());
+
+/** Number of locations and lines logged when there is no profile file. */
+static const unsigned LOGGED_ENTRIES = 10;
+
+/**
+ * A call being measured.
+ */
+struct Frame
+{
+    Entry *entry;
+    std::chrono::steady_clock::time_point start;
+    uint64_t allocatedBytes;    /**< Allocated before the call. */
+    uint64_t childTime;         /**< Spent in nested calls. */
+    uint64_t childBytes;        /**< Allocated by nested calls. */
+};
+
+static bool enabled = false;
+static bool sampling = false;
+
+static std::unordered_map<std::string, Entry> entries;
+static std::unordered_map<std::string, unsigned long> samples;
+static std::vector<Frame> frames;
+
+/**
+ * Writes a location as an XML attribute value. Chunk names of inline map
+ * scripts contain quotes.
+ */
+static void writeAttribute(std::ostream &os, const std::string &value)
+{
+    for (char c : value)
+    {
+        switch (c)
+        {
+            case '&': os << "&amp;"; break;
+            case '<': os << "&lt;"; break;
+            case '>': os << "&gt;"; break;
+            case '"': os << "&quot;"; break;
+            default: os << c; break;
+        }
+    }
+}
+
+void ScriptProfiler::setEnabled(bool enable, bool sample)
+{
+    enabled = enable;
+    sampling = enable && sample;
+    frames.clear();
+}
+
+bool ScriptProfiler::isEnabled()
+{
+    return enabled;
+}
+
+bool ScriptProfiler::isSampling()
+{
+    return sampling;
+}
+
+void ScriptProfiler::enterCall(const std::string &location,
+                               uint64_t allocatedBytes)
+{
+    Entry &entry = entries[location];
+    if (entry.location.empty())
+        entry.location = location;
+
+    Frame frame;
+    frame.entry = &entry;
+    frame.start = std::chrono::steady_clock::now();
+    frame.allocatedBytes = allocatedBytes;
+    frame.childTime = 0;
+    frame.childBytes = 0;
+    frames.push_back(frame);
+}
+
+void ScriptProfiler::leaveCall(uint64_t allocatedBytes)
+{
+    // The profiler may have been switched off and on during the call
+    if (frames.empty())
+        return;
+
+    const Frame frame = frames.back();
+    frames.pop_back();
+
+    using namespace std::chrono;
+    const uint64_t time = duration_cast<nanoseconds>(
+            steady_clock::now() - frame.start).count();
+    const uint64_t bytes = allocatedBytes - frame.allocatedBytes;
+
+    Entry &entry = *frame.entry;
+    ++entry.calls;
+    entry.totalTime += time;
+    entry.selfTime += time - std::min(time, frame.childTime);
+    entry.maxTime = std::max(entry.maxTime, time);
+    entry.allocatedBytes += bytes - std::min(bytes, frame.childBytes);
+
+    if (!frames.empty())
+    {
+        frames.back().childTime += time;
+        frames.back().childBytes += bytes;
+    }
+}
+
+void ScriptProfiler::recordSample(const std::string &location)
+{
+    ++samples[location];
+}
+
+/**
+ * Orders entries by their self time, most expensive first.
+ */
+static bool moreExpensive(const Entry &a, const Entry &b)
+{
+    return a.selfTime > b.selfTime;
+}
+
+typedef std::pair<std::string, unsigned long> Sample;
+
+static bool moreSampled(const Sample &a, const Sample &b)
+{
+    return a.second > b.second;
+}
+
+std::vector<Entry> ScriptProfiler::getEntries(unsigned count)
+{
+    std::vector<Entry> result;
+    result.reserve(entries.size());
+    for (auto &entry : entries)
+        result.push_back(entry.second);
+
+    count = std::min<unsigned>(count, result.size());
+    std::partial_sort(result.begin(), result.begin() + count, result.end(),
+                      moreExpensive);
+    result.resize(count);
+    return result;
+}
+
+/**
+ * Returns the sampled lines, the most sampled first, at most \a count.
+ */
+static std::vector<Sample> getSamples(unsigned count)
+{
+    std::vector<Sample> result(samples.begin(), samples.end());
+    count = std::min<unsigned>(count, result.size());
+    std::partial_sort(result.begin(), result.begin() + count, result.end(),
+                      moreSampled);
+    result.resize(count);
+    return result;
+}
+
+void ScriptProfiler::dumpStatistics(std::ostream &os)
+{
+    os << "<?xml version=\"1.0\"?>\n<scripts>\n";
+
+    for (const Entry &entry : getEntries(entries.size()))
+    {
+        os << "<function location=\"";
+        writeAttribute(os, entry.location);
+        os << "\" calls=\"" << entry.calls
+           << "\" total=\"" << entry.totalTime / 1000
+           << "\" self=\"" << entry.selfTime / 1000
+           << "\" max=\"" << entry.maxTime / 1000
+           << "\" allocated=\"" << entry.allocatedBytes << "\"/>\n";
+    }
+
+    for (const Sample &sample : getSamples(samples.size()))
+    {
+        os << "<line location=\"";
+        writeAttribute(os, sample.first);
+        os << "\" samples=\"" << sample.second << "\"/>\n";
+    }
+
+    os << "</scripts>\n";
+}
+
+std::string ScriptProfiler::dumpStatistics()
+{
+    const std::string &fileName = profileFile;
+    if (!fileName.empty())
+    {
+        std::ofstream os(fileName.c_str());
+        dumpStatistics(os);
+        return fileName;
+    }
+
+    for (const Entry &entry : getEntries(LOGGED_ENTRIES))
+    {
+        LOG_INFO("Script function " << entry.location << ": "
+                 << entry.calls << " calls, " << entry.selfTime / 1000
+                 << " us self, " << entry.totalTime / 1000 << " us total, "
+                 << entry.maxTime / 1000 << " us max, "
+                 << entry.allocatedBytes << " bytes allocated");
+    }
+
+    for (const Sample &sample : getSamples(LOGGED_ENTRIES))
+    {
+        LOG_INFO("Script line " << sample.first << ": "
+                 << sample.second << " samples");
+    }
+
+    return std::string();
+}
+
+void ScriptProfiler::reset()
+{
+    entries.clear();
+    samples.clear();
+    frames.clear();
+}
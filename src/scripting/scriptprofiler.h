@@ -0,0 +1,115 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SCRIPTING_SCRIPTPROFILER_H
+#define SCRIPTING_SCRIPTPROFILER_H
+
+#include <iosfwd>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * Measures where the time of the script engine goes.
+ *
+ * Each call into a script function, either a callback or the resumption of a
+ * script thread, is attributed to the location the function was defined at.
+ * Per location, the profiler counts the calls, the time spent including and
+ * excluding nested calls, and the bytes allocated by the script engine.
+ * Optionally, the script engine also samples the line being executed every
+ * few thousand instructions, which finds the hot spots within long
+ * functions. While the profiler is disabled, its cost is a check of a flag
+ * per call.
+ */
+namespace ScriptProfiler
+{
+    /**
+     * What was measured for the functions defined at one location.
+     */
+    struct Entry
+    {
+        Entry(): calls(0), totalTime(0), selfTime(0), maxTime(0),
+                 allocatedBytes(0) {}
+
+        std::string location;
+        unsigned long calls;
+        uint64_t totalTime;         /**< Nanoseconds, with nested calls. */
+        uint64_t selfTime;          /**< Nanoseconds, without nested calls. */
+        uint64_t maxTime;           /**< Longest call in nanoseconds. */
+        uint64_t allocatedBytes;    /**< Without nested calls. */
+    };
+
+    /**
+     * Starts or stops profiling. Stopping keeps the results.
+     *
+     * @param sampling whether to also sample the executed lines.
+     */
+    void setEnabled(bool enabled, bool sampling = false);
+
+    bool isEnabled();
+
+    bool isSampling();
+
+    /**
+     * Marks the start of a call to the function defined at the given
+     * location. Calls can nest.
+     *
+     * @param allocatedBytes the bytes allocated by the script engine so far.
+     */
+    void enterCall(const std::string &location, uint64_t allocatedBytes);
+
+    /**
+     * Marks the end of the innermost call.
+     *
+     * @param allocatedBytes the bytes allocated by the script engine so far.
+     */
+    void leaveCall(uint64_t allocatedBytes);
+
+    /**
+     * Counts a sample of the line being executed.
+     */
+    void recordSample(const std::string &location);
+
+    /**
+     * Returns the measured locations, the most expensive by self time
+     * first, at most \a count of them.
+     */
+    std::vector<Entry> getEntries(unsigned count);
+
+    /**
+     * Writes all measurements since the last reset.
+     */
+    void dumpStatistics(std::ostream &os);
+
+    /**
+     * Writes the measurements to the configured file, or the most expensive
+     * locations to the log when no file is set.
+     *
+     * @return the name of the file written, empty when logged.
+     */
+    std::string dumpStatistics();
+
+    /**
+     * Forgets all measurements.
+     */
+    void reset();
+}
+
+#endif // SCRIPTING_SCRIPTPROFILER_H
@@ -0,0 +1,104 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "utils/histogram.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace utils
+{
+
+Histogram::Histogram()
+{
+    reset();
+}
+
+unsigned Histogram::bucketIndex(unsigned value)
+{
+    if (value < SUB_BUCKETS)
+        return value;
+
+    // Position of the highest bit, the bits below the sub-bucket bits are
+    // what gets lost.
+    unsigned highest = 31 - __builtin_clz(value);
+    unsigned shift = highest - SUB_BUCKET_BITS;
+    return SUB_BUCKETS * (shift + 1) + ((value >> shift) - SUB_BUCKETS);
+}
+
+unsigned Histogram::bucketLimit(unsigned index)
+{
+    if (index < SUB_BUCKETS)
+        return index;
+
+    unsigned shift = index / SUB_BUCKETS - 1;
+    uint64_t next = uint64_t(SUB_BUCKETS + index % SUB_BUCKETS + 1) << shift;
+    return unsigned(next - 1);
+}
+
+void Histogram::record(unsigned value)
+{
+    ++mBuckets[bucketIndex(value)];
+    ++mCount;
+    mTotal += value;
+    if (value > mMax)
+        mMax = value;
+}
+
+void Histogram::merge(const Histogram &other)
+{
+    for (unsigned i = 0; i < BUCKET_COUNT; ++i)
+        mBuckets[i] += other.mBuckets[i];
+
+    mCount += other.mCount;
+    mTotal += other.mTotal;
+    if (other.mMax > mMax)
+        mMax = other.mMax;
+}
+
+void Histogram::reset()
+{
+    memset(mBuckets, 0, sizeof(mBuckets));
+    mCount = 0;
+    mTotal = 0;
+    mMax = 0;
+}
+
+unsigned Histogram::getPercentile(double percentile) const
+{
+    if (!mCount)
+        return 0;
+
+    unsigned long wanted = (unsigned long) (mCount * percentile / 100.0 + 0.5);
+    if (wanted < 1)
+        wanted = 1;
+
+    unsigned long seen = 0;
+    for (unsigned i = 0; i < BUCKET_COUNT; ++i)
+    {
+        seen += mBuckets[i];
+        if (seen >= wanted)
+            return std::min(bucketLimit(i), mMax);
+    }
+    return mMax;
+}
+
+} // namespace utils
@@ -0,0 +1,95 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+namespace utils
+{
+
+/**
+ * A latency histogram in the style of HdrHistogram.
+ *
+ * Values are counted in buckets that are linear within each power of two,
+ * so the relative error of a reported value stays below 1/16 over the
+ * whole range of an unsigned int while the histogram keeps a fixed size.
+ * Recording a value is a couple of bit operations and an increment.
+ */
+class Histogram
+{
+    public:
+        Histogram();
+
+        /**
+         * Counts one occurence of the given value.
+         */
+        void record(unsigned value);
+
+        /**
+         * Adds the counts of another histogram to this one.
+         */
+        void merge(const Histogram &other);
+
+        /**
+         * Forgets all recorded values.
+         */
+        void reset();
+
+        unsigned long getCount() const
+        { return mCount; }
+
+        unsigned getMax() const
+        { return mMax; }
+
+        uint64_t getTotal() const
+        { return mTotal; }
+
+        unsigned getMean() const
+        { return mCount ? mTotal / mCount : 0; }
+
+        /**
+         * Returns the value below which the given percentage of the
+         * recorded values fall, rounded up to the bucket bounds.
+         *
+         * @param percentile a percentage between 0 and 100.
+         */
+        unsigned getPercentile(double percentile) const;
+
+    private:
+        static const unsigned SUB_BUCKET_BITS = 4;
+        static const unsigned SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+        static const unsigned BUCKET_COUNT =
+                SUB_BUCKETS * (32 - SUB_BUCKET_BITS + 1);
+
+        static unsigned bucketIndex(unsigned value);
+        static unsigned bucketLimit(unsigned index);
+
+        uint32_t mBuckets[BUCKET_COUNT];
+        unsigned long mCount;
+        uint64_t mTotal;
+        unsigned mMax;
+};
+
+} // namespace utils
+
+#endif // HISTOGRAM_H
@@ -25,8 +25,15 @@
 #include "utils/string.h"
 #include "utils/time.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
+#include <mutex>
+#include <thread>
 
 #ifdef WIN32
 #include <windows.h>
@@ -79,6 +86,227 @@ static bool getDayChanged()
     return false;
 }
 
+/**
+ * Background writer of the asynchronous logging mode.
+ *
+ * Messages are handed over through a bounded ring buffer in which every slot
+ * carries a sequence number telling whether it is free or holds a message.
+ * Producers only race on an atomic enqueue position and never wait for the
+ * writer: when the buffer is full the message is dropped and counted.
+ */
+class LogWriter
+{
+    public:
+        LogWriter(unsigned capacity);
+        ~LogWriter();
+
+        /**
+         * Queues a message. The message string is taken over.
+         *
+         * @return false if the ring buffer was full.
+         */
+        bool push(std::string &msg, Logger::Level level, time_t time);
+
+        /**
+         * Waits until all messages queued before this call were written.
+         */
+        void flush();
+
+        unsigned long getDropped() const
+        { return mDropped.load(std::memory_order_relaxed); }
+
+    private:
+        struct Slot
+        {
+            std::atomic<size_t> sequence;
+            Logger::Level level;
+            time_t time;
+            std::string message;
+        };
+
+        /** Writer thread main loop. */
+        void run();
+
+        /**
+         * Writes the message at the dequeue position, if any.
+         *
+         * @return whether a message was written.
+         */
+        bool pop();
+
+        static const unsigned BATCH_SIZE = 256;
+
+        Slot *mSlots;
+        size_t mMask;
+        std::atomic<size_t> mEnqueuePos;
+        std::atomic<size_t> mDequeuePos;
+        std::atomic<unsigned long> mDropped;
+        unsigned long mReportedDropped; /**< Only used by the writer. */
+        std::atomic<bool> mRunning;
+        std::atomic<bool> mSleeping;
+        std::mutex mMutex;
+        std::condition_variable mWakeUp;
+        std::thread mThread;
+};
+
+/** The asynchronous writer, when enabled. */
+static std::atomic<LogWriter*> asyncWriter(nullptr);
+
+LogWriter::LogWriter(unsigned capacity):
+    mEnqueuePos(0),
+    mDequeuePos(0),
+    mDropped(0),
+    mReportedDropped(0),
+    mRunning(true),
+    mSleeping(false)
+{
+    size_t size = 2;
+    while (size < capacity)
+        size <<= 1;
+
+    mSlots = new Slot[size];
+    mMask = size - 1;
+    for (size_t i = 0; i < size; ++i)
+        mSlots[i].sequence.store(i, std::memory_order_relaxed);
+
+    mThread = std::thread(&LogWriter::run, this);
+}
+
+LogWriter::~LogWriter()
+{
+    mRunning.store(false);
+    mWakeUp.notify_one();
+    mThread.join();
+    delete[] mSlots;
+}
+
+bool LogWriter::push(std::string &msg, Logger::Level level, time_t time)
+{
+    size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;)
+    {
+        slot = &mSlots[pos & mMask];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+        if (diff == 0)
+        {
+            if (mEnqueuePos.compare_exchange_weak(pos, pos + 1,
+                                                  std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            // The writer did not free this slot yet, the buffer is full.
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else
+        {
+            pos = mEnqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->level = level;
+    slot->time = time;
+    slot->message.swap(msg);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+
+    if (mSleeping.load(std::memory_order_relaxed))
+        mWakeUp.notify_one();
+    return true;
+}
+
+bool LogWriter::pop()
+{
+    size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+    Slot &slot = mSlots[pos & mMask];
+    if (slot.sequence.load(std::memory_order_acquire) != pos + 1)
+        return false;
+
+    try
+    {
+        Logger::write(slot.message, slot.level, slot.time);
+    }
+    catch (std::exception &e)
+    {
+        std::cerr << "Logger: " << e.what() << ": " << slot.message
+                  << std::endl;
+    }
+
+    slot.message.clear();
+    slot.sequence.store(pos + mMask + 1, std::memory_order_release);
+    mDequeuePos.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+void LogWriter::run()
+{
+    for (;;)
+    {
+        unsigned written = 0;
+        while (written < BATCH_SIZE && pop())
+            ++written;
+
+        if (written)
+        {
+            const unsigned long dropped = getDropped();
+            try
+            {
+                if (dropped != mReportedDropped)
+                {
+                    std::ostringstream os;
+                    os << "Log buffer full, dropped "
+                       << dropped - mReportedDropped << " messages";
+                    mReportedDropped = dropped;
+                    Logger::write(os.str(), Logger::Warn, time(nullptr));
+                }
+
+                // Write the whole batch at once and only then check
+                // whether the log file needs to be switched.
+                if (mLogFile.is_open())
+                {
+                    mLogFile.flush();
+                    Logger::switchLogs();
+                }
+            }
+            catch (std::exception &e)
+            {
+                std::cerr << "Logger: " << e.what() << std::endl;
+            }
+            std::cout.flush();
+            continue;
+        }
+
+        if (!mRunning.load())
+            break;
+
+        // Sleep until a producer wakes us up. The timeout covers the case
+        // where a message is queued right before mSleeping is set.
+        std::unique_lock<std::mutex> lock(mMutex);
+        mSleeping.store(true);
+        mWakeUp.wait_for(lock, std::chrono::milliseconds(50));
+        mSleeping.store(false);
+    }
+}
+
+void LogWriter::flush()
+{
+    const size_t target = mEnqueuePos.load();
+    mWakeUp.notify_one();
+    while (mDequeuePos.load(std::memory_order_acquire) < target)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+/**
+ * Makes sure the writer thread is stopped and the pending messages are
+ * written when the program exits without calling Logger::deinitialize().
+ */
+static struct LogWriterGuard
+{
+    ~LogWriterGuard() { Logger::deinitialize(); }
+} writerGuard;
+
 void Logger::initialize(const std::string &logFile)
 {
     setLogFile(logFile, true);
@@ -91,13 +319,67 @@ void Logger::initialize(const std::string &logFile)
     setLogRotation(Configuration::getBoolValue("log_enableRotation", false));
     setMaxLogfileSize(Configuration::getValue("log_maxFileSize", 1024));
     setSwitchLogEachDay(Configuration::getBoolValue("log_perDay", false));
+
+    // Hand the writing over to a background thread once configured.
+    setAsynchronous(Configuration::getBoolValue("log_asynchronous", false),
+                    Configuration::getValue("log_asyncBufferSize", 8192));
+}
+
+void Logger::deinitialize()
+{
+    setAsynchronous(false);
+}
+
+void Logger::setAsynchronous(bool enable, unsigned bufferSize)
+{
+    if (enable == (asyncWriter != nullptr))
+        return;
+
+    if (enable)
+    {
+        asyncWriter = new LogWriter(bufferSize);
+    }
+    else
+    {
+        LogWriter *writer = asyncWriter.exchange(nullptr);
+        const unsigned long dropped = writer->getDropped();
+        delete writer;
+        if (dropped)
+            LOG_WARN("Dropped " << dropped << " log messages in total");
+    }
+}
+
+void Logger::flush()
+{
+    if (LogWriter *writer = asyncWriter)
+        writer->flush();
 }
 
-void Logger::output(std::ostream &os, const std::string &msg, const char *prefix)
+unsigned long Logger::getDroppedMessages()
+{
+    LogWriter *writer = asyncWriter;
+    return writer ? writer->getDropped() : 0;
+}
+
+/**
+ * Formats the given time as hh:mm:ss.
+ */
+static std::string formatTime(time_t time)
+{
+    tm local;
+    getLocalTime(time, local);
+    char buffer[9];
+    snprintf(buffer, sizeof(buffer), "%02d:%02d:%02d",
+             local.tm_hour, local.tm_min, local.tm_sec);
+    return buffer;
+}
+
+void Logger::output(std::ostream &os, const std::string &msg,
+                    const char *prefix, time_t time)
 {
     if (mHasTimestamp)
     {
-        os << "[" << getCurrentTime() << "]" << ' ';
+        os << "[" << formatTime(time) << "]" << ' ';
     }
 
     if (prefix)
@@ -105,7 +387,7 @@ void Logger::output(std::ostream &os, const std::string &msg, const char *prefix
         os << prefix << ' ';
     }
 
-    os << msg << std::endl;
+    os << msg << '\n';
 }
 
 void Logger::setLogFile(const std::string &logFile, bool append)
@@ -138,36 +420,61 @@ void Logger::setLogFile(const std::string &logFile, bool append)
 
 void Logger::output(const std::string &msg, Level atVerbosity)
 {
-    if (mVerbosity >= atVerbosity)
+    if (mVerbosity < atVerbosity)
+        return;
+
+    if (LogWriter *writer = asyncWriter)
     {
-        static const char *prefixes[] =
-        {
-        #ifdef T_COL_LOG
-            "[\033[45mFTL\033[0m]",
-            "[\033[41mERR\033[0m]",
-            "[\033[43mWRN\033[0m]",
-        #else
-            "[FTL]",
-            "[ERR]",
-            "[WRN]",
-        #endif
-            "[INF]",
-            "[DBG]"
-        };
+        std::string queued(msg);
+        writer->push(queued, atVerbosity, time(nullptr));
 
-        bool open = mLogFile.is_open();
+        // Make sure fatal errors are on disk before the process goes down.
+        if (atVerbosity == Fatal)
+            writer->flush();
+    }
+    else
+    {
+        write(msg, atVerbosity, time(nullptr));
+    }
+}
+
+void Logger::write(const std::string &msg, Level atVerbosity, time_t time)
+{
+    static const char *prefixes[] =
+    {
+    #ifdef T_COL_LOG
+        "[\033[45mFTL\033[0m]",
+        "[\033[41mERR\033[0m]",
+        "[\033[43mWRN\033[0m]",
+    #else
+        "[FTL]",
+        "[ERR]",
+        "[WRN]",
+    #endif
+        "[INF]",
+        "[DBG]"
+    };
+
+    bool open = mLogFile.is_open();
 
-        if (open)
+    if (open)
+    {
+        output(mLogFile, msg, prefixes[atVerbosity], time);
+
+        // The asynchronous writer flushes and switches logs once per batch.
+        if (!asyncWriter)
         {
-            output(mLogFile, msg, prefixes[atVerbosity]);
+            mLogFile.flush();
             switchLogs();
         }
+    }
 
-        if (!open || mTeeMode)
-        {
-            output(atVerbosity <= Warn ? std::cerr : std::cout,
-                   msg, prefixes[atVerbosity]);
-        }
+    if (!open || mTeeMode)
+    {
+        std::ostream &os = atVerbosity <= Warn ? std::cerr : std::cout;
+        output(os, msg, prefixes[atVerbosity], time);
+        if (!asyncWriter)
+            os.flush();
     }
 }
 
@@ -22,6 +22,7 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 
+#include <ctime>
 #include <iosfwd>
 #include <sstream>
 #include <iostream>
@@ -36,8 +37,16 @@ namespace utils
  * By default, the messages will be timestamped but the logger can be
  * configured to not prefix the messages with a timestamp.
  *
+ * The logger can optionally hand messages over to a background writer
+ * thread through a fixed-size lock-free ring buffer. In that mode, the
+ * thread that logs only pays for formatting the message itself; timestamps,
+ * file writes and log rotation happen on the writer thread in batches.
+ * When the ring buffer is full, messages are dropped and counted rather
+ * than blocking the caller.
+ *
  * Limitations:
- *     - not thread-safe.
+ *     - the configuration setters are not thread-safe and should only be
+ *       called before the asynchronous mode is enabled.
  *
  * Example of use:
  *
@@ -85,6 +94,12 @@ class Logger
 
         static void initialize(const std::string &logFile);
 
+        /**
+         * Stops the asynchronous writer, if any, after it wrote all
+         * pending messages.
+         */
+        static void deinitialize();
+
         /**
          * Sets the log file.
          *
@@ -161,6 +176,30 @@ class Logger
          */
         static void output(const std::string &msg, Level atVerbosity);
 
+        /**
+         * Enables or disables the asynchronous writer thread.
+         *
+         * When disabled, the messages still waiting in the ring buffer are
+         * written out before this method returns.
+         *
+         * @param enable whether to log asynchronously.
+         * @param bufferSize the number of messages the ring buffer can hold,
+         *        rounded up to a power of two.
+         */
+        static void setAsynchronous(bool enable, unsigned bufferSize = 8192);
+
+        /**
+         * Blocks until the asynchronous writer has written all messages
+         * queued so far. Does nothing in synchronous mode.
+         */
+        static void flush();
+
+        /**
+         * Returns the number of messages dropped because the ring buffer
+         * was full.
+         */
+        static unsigned long getDroppedMessages();
+
         static Level mVerbosity;   /**< Verbosity level. */
     private:
         static bool mHasTimestamp; /**< Timestamp flag. */
@@ -180,17 +219,28 @@ class Logger
          * @param os the output stream.
          * @param msg the message to log.
          * @param prefix the message prefix.
+         * @param time the time at which the message was logged.
          *
          * @exception std::ios::failure.
          */
         static void output(std::ostream &os, const std::string &msg,
-                           const char *prefix);
+                           const char *prefix, time_t time);
+
+        /**
+         * Writes a message to the log file and/or the standard streams.
+         * Called directly in synchronous mode and from the writer thread
+         * otherwise.
+         */
+        static void write(const std::string &msg, Level atVerbosity,
+                          time_t time);
 
         /**
          * Switch the log file based on a maximum size
          * and/or and a date change.
          */
         static void switchLogs();
+
+        friend class LogWriter;
 };
 
 /**
@@ -19,6 +19,7 @@
  */
 
 #include <algorithm>
+#include <cctype>
 
 #include "utils/stringfilter.h"
 
@@ -40,11 +41,16 @@ StringFilter::~StringFilter()
 }
 
 bool StringFilter::loadSlangFilterList()
+{
+    return loadSlangFilterList(Configuration::getValue("SlangsList",
+                                                       std::string()));
+}
+
+bool StringFilter::loadSlangFilterList(const std::string &slangsList)
 {
     mInitialized = false;
+    mSlangs.clear();
 
-    const std::string slangsList = Configuration::getValue("SlangsList",
-                                                           std::string());
     if (!slangsList.empty()) {
         std::istringstream iss(slangsList);
         std::string tmp;
@@ -69,7 +75,25 @@ void StringFilter::writeSlangFilterList()
     //mConfig->setValue("SlangsList", slangsList);
 }
 
-bool StringFilter::filterContent(const std::string &text) const
+/**
+ * Compares the text to the slang without regard to case, without copying
+ * either of them.
+ */
+static bool equalsIgnoreCase(const StringView &text, const std::string &slang)
+{
+    if (text.size() != slang.size())
+        return false;
+
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        if (std::toupper((unsigned char) text[i]) !=
+            std::toupper((unsigned char) slang[i]))
+            return false;
+    }
+    return true;
+}
+
+bool StringFilter::filterContent(const StringView &text) const
 {
     if (!mInitialized) {
         LOG_DEBUG("Slangs List is not initialized.");
@@ -77,19 +101,11 @@ bool StringFilter::filterContent(const std::string &text) const
     }
 
     bool isContentClean = true;
-    std::string upperCaseText = text;
-
-    std::transform(text.begin(), text.end(), upperCaseText.begin(),
-            (int(*)(int))std::toupper);
 
     for (Slangs::const_iterator i = mSlangs.begin(); i != mSlangs.end(); ++i)
     {
         // We look for slangs into the sentence.
-        std::string upperCaseSlang = *i;
-        std::transform(upperCaseSlang.begin(), upperCaseSlang.end(),
-                upperCaseSlang.begin(), (int(*)(int))std::toupper);
-
-        if (upperCaseText.compare(upperCaseSlang)) {
+        if (!equalsIgnoreCase(text, *i)) {
             isContentClean = false;
             break;
         }
@@ -117,9 +133,9 @@ bool StringFilter::isEmailValid(const std::string &email) const
         (email.find_first_of(' ') == std::string::npos);
 }
 
-bool StringFilter::findDoubleQuotes(const std::string &text) const
+bool StringFilter::findDoubleQuotes(const StringView &text) const
 {
-    return (text.find('"', 0) != std::string::npos);
+    return (text.find('"') != std::string::npos);
 }
 
 } // ::utils
@@ -24,6 +24,8 @@
 #include <list>
 #include <string>
 
+#include "utils/stringview.h"
+
 namespace utils
 {
 
@@ -45,6 +47,13 @@ class StringFilter
          */
         bool loadSlangFilterList();
 
+        /**
+         * Replaces the slang list by the given comma separated list.
+         *
+         * @return true if the list is not empty
+         */
+        bool loadSlangFilterList(const std::string &slangsList);
+
         /**
          * Write slang list to the config file.
          *
@@ -56,7 +65,7 @@ class StringFilter
         * Useful to filter slangs automatically, by instance.
         * @return true if the sentence is slangs clear.
         */
-        bool filterContent(const std::string &text) const;
+        bool filterContent(const StringView &text) const;
 
         /**
          * Tells if an email is valid
@@ -68,7 +77,7 @@ class StringFilter
          * Very useful not to make SQL Queries based on names crash
          * I placed it here cause where you've got " you can have slangs...
          */
-        bool findDoubleQuotes(const std::string &text) const;
+        bool findDoubleQuotes(const StringView &text) const;
 
     private:
         typedef std::list<std::string> Slangs;
@@ -0,0 +1,92 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UTILS_STRINGVIEW_H
+#define UTILS_STRINGVIEW_H
+
+#include <cstring>
+#include <string>
+
+namespace utils
+{
+    /**
+     * A non-owning reference to a sequence of characters. The referenced
+     * memory has to outlive the view, which makes it suitable for parsing
+     * a message without copying its strings.
+     */
+    class StringView
+    {
+        public:
+            typedef const char *const_iterator;
+
+            StringView()
+                : mData(""), mSize(0)
+            {}
+
+            StringView(const char *data, size_t size)
+                : mData(data), mSize(size)
+            {}
+
+            StringView(const std::string &string)
+                : mData(string.data()), mSize(string.size())
+            {}
+
+            const char *data() const { return mData; }
+            size_t size() const { return mSize; }
+            bool empty() const { return mSize == 0; }
+
+            const_iterator begin() const { return mData; }
+            const_iterator end() const { return mData + mSize; }
+
+            char operator[](size_t index) const { return mData[index]; }
+
+            /**
+             * Returns the position of the first occurrence of the character,
+             * or std::string::npos.
+             */
+            size_t find(char c) const
+            {
+                const void *found = memchr(mData, c, mSize);
+                return found ? (const char *) found - mData
+                             : std::string::npos;
+            }
+
+            /**
+             * Returns a copy of the referenced characters.
+             */
+            std::string str() const { return std::string(mData, mSize); }
+
+        private:
+            const char *mData;
+            size_t mSize;
+    };
+
+    inline bool operator==(const StringView &a, const StringView &b)
+    {
+        return a.size() == b.size() &&
+               memcmp(a.data(), b.data(), a.size()) == 0;
+    }
+
+    inline bool operator!=(const StringView &a, const StringView &b)
+    { return !(a == b); }
+
+} // namespace utils
+
+#endif // UTILS_STRINGVIEW_H
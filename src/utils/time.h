@@ -27,6 +27,19 @@
 
 namespace utils {
 
+/**
+  * Converts a time_t value to the local time. Unlike localtime(), this may
+  * be called from several threads, like the one of the asynchronous logger.
+  */
+static void getLocalTime(time_t time, tm &local)
+{
+#ifdef WIN32
+    localtime_s(&local, &time);
+#else
+    localtime_r(&time, &local);
+#endif
+}
+
 /**
   * Gets the current time.
   *
@@ -42,7 +55,7 @@ static std::string getCurrentTime()
 
     // Convert time_t to tm struct to break the time into individual
     // constituents.
-    local = *(localtime(&now));
+    getLocalTime(now, local);
 
     // Stringify the time, the format is: hh:mm:ss
     using namespace std;
@@ -69,7 +82,7 @@ static std::string getCurrentDate()
 
     // Convert time_t to tm struct to break the time into individual
     // constituents.
-    local = *(localtime(&now));
+    getLocalTime(now, local);
 
     // Stringify the time, the format is: yyyy-mm-dd
     using namespace std;
@@ -20,24 +20,70 @@
 
 #include "timer.h"
 
+#include <errno.h>
 #include <time.h>
-#include <sys/time.h>
 
 #ifdef _WIN32
 #include <windows.h>
 #endif
 
+#include <chrono>
+
+/*
+ * Where the monotonic clock can be slept on with an absolute deadline, both
+ * reading the time and sleeping go through it. Elsewhere the time comes from
+ * std::chrono::steady_clock and the remaining time is slept.
+ */
+#if !defined(_WIN32) && defined(CLOCK_MONOTONIC) && defined(TIMER_ABSTIME)
+#define TIMER_ABSOLUTE_SLEEP
+#endif
+
+static const uint64_t NANOSECONDS_PER_MILLISECOND = 1000 * 1000;
+static const uint64_t NANOSECONDS_PER_SECOND = 1000 * 1000 * 1000;
+
+/**
+ * Returns the time of the monotonic clock in nanoseconds.
+ */
+static uint64_t getTimeInNanosec()
+{
+#ifdef TIMER_ABSOLUTE_SLEEP
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * NANOSECONDS_PER_SECOND + time.tv_nsec;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
 /**
- * Calls gettimeofday() and converts it into milliseconds.
+ * Sleeps until the monotonic clock reaches the given time in nanoseconds.
  */
-static uint64_t getTimeInMillisec()
+static void sleepUntil(uint64_t deadline)
 {
-    uint64_t timeInMillisec;
-    timeval time;
+#ifdef TIMER_ABSOLUTE_SLEEP
+    timespec req;
+    req.tv_sec = deadline / NANOSECONDS_PER_SECOND;
+    req.tv_nsec = deadline % NANOSECONDS_PER_SECOND;
 
-    gettimeofday(&time, 0);
-    timeInMillisec = (uint64_t)time.tv_sec * 1000 + time.tv_usec / 1000;
-    return timeInMillisec;
+    // Interrupted sleeps are resumed, the deadline stays the same
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &req, 0) == EINTR)
+        ;
+#else
+    uint64_t now = getTimeInNanosec();
+    if (now >= deadline)
+        return;
+#ifndef _WIN32
+    struct timespec req;
+    req.tv_sec = (deadline - now) / NANOSECONDS_PER_SECOND;
+    req.tv_nsec = (deadline - now) % NANOSECONDS_PER_SECOND;
+    nanosleep(&req, 0);
+#else
+    // Round up, waking up early would only cause another sleep
+    Sleep((deadline - now + NANOSECONDS_PER_MILLISECOND - 1)
+          / NANOSECONDS_PER_MILLISECOND);
+#endif
+#endif
 }
 
 namespace utils
@@ -46,23 +92,14 @@ namespace utils
 Timer::Timer(unsigned ms)
 {
     active = false;
-    interval = ms;
-    lastpulse = getTimeInMillisec();
+    interval = ms * NANOSECONDS_PER_MILLISECOND;
+    lastpulse = getTimeInNanosec();
 }
 
 void Timer::sleep()
 {
     if (!active) return;
-    uint64_t now = getTimeInMillisec();
-    if (now - lastpulse >= interval) return;
-#ifndef _WIN32
-    struct timespec req;
-    req.tv_sec = 0;
-    req.tv_nsec = (interval - (now - lastpulse)) * (1000 * 1000);
-    nanosleep(&req, 0);
-#else
-    Sleep(interval - (now - lastpulse));
-#endif
+    sleepUntil(lastpulse + interval);
 }
 
 int Timer::poll()
@@ -70,17 +107,14 @@ int Timer::poll()
     int elapsed = 0;
     if (active)
     {
-        uint64_t now = getTimeInMillisec();
-        if (now > lastpulse)
+        uint64_t now = getTimeInNanosec();
+        if (now >= lastpulse + interval)
         {
             elapsed = (now - lastpulse) / interval;
             lastpulse += interval * elapsed;
-        }
-        else
-        {
-            // Time has made a jump to the past. This should be a rare
-            // occurence, so just reset lastpulse to prevent problems.
-            lastpulse = now;
+
+            // How long after its deadline the latest pulse was noticed
+            lateness.record((now - lastpulse) / 1000);
         }
     };
     return elapsed;
@@ -89,7 +123,8 @@ int Timer::poll()
 void Timer::start()
 {
     active = true;
-    lastpulse = getTimeInMillisec();
+    lastpulse = getTimeInNanosec();
+    lateness.reset();
 }
 
 void Timer::stop()
@@ -99,7 +134,7 @@ void Timer::stop()
 
 void Timer::changeInterval(unsigned newinterval)
 {
-    interval = newinterval;
+    interval = newinterval * NANOSECONDS_PER_MILLISECOND;
 }
 
 } // ::utils
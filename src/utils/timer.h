@@ -28,11 +28,19 @@
    #include <stdint.h> // on other compilers use the C99 official header
 #endif
 
+#include "utils/histogram.h"
+
 namespace utils
 {
 
 /**
  * This class is for timing purpose as a replacement for SDL_TIMER
+ *
+ * Time is taken from a monotonic clock with nanosecond resolution, so
+ * changes to the wall clock do not affect the pulses. Pulses are kept on a
+ * fixed grid of deadlines starting when the timer is activated, and
+ * sleep() waits until the next deadline rather than for a relative
+ * duration, so that oversleeping does not make the pulses drift.
  */
 class Timer
 {
@@ -54,6 +62,20 @@ class Timer
          */
         void sleep();
 
+        /**
+         * Returns how late poll() noticed the pulses it reported, in
+         * microseconds. This is the jitter of the pulses caused by sleeping
+         * and by the work done between two polls.
+         */
+        const Histogram &getLateness() const
+        { return lateness; }
+
+        /**
+         * Forgets the recorded lateness of the pulses.
+         */
+        void resetLateness()
+        { lateness.reset(); }
+
         /**
          * Activates the timer.
          */
@@ -71,15 +93,20 @@ class Timer
 
     private:
         /**
-         * Interval between two pulses.
+         * Interval between two pulses, in nanoseconds.
          */
-        unsigned interval;
+        uint64_t interval;
 
         /**
-         * The time the last pulse occured.
+         * The deadline of the last pulse, in nanoseconds.
          */
         uint64_t lastpulse;
 
+        /**
+         * Lateness of the reported pulses, in microseconds.
+         */
+        Histogram lateness;
+
         /**
          * Activity status of the timer.
          */
@@ -20,101 +20,165 @@
 
 #include "utils/tokencollector.h"
 
-/* We are optimistic and we assume that clients connect as soon as possible.
-   It means that pending data are mainly outdated ones, except for the newer
-   ones. So we search the lists backward (from newer to older) for already
-   inserted data. On the contrary, data are removed when there was a network
-   failure, especially a timeout. So we search the lists forward when removing
-   data, in order to start from the older ones. */
+#include <sys/time.h>
 
-void TokenCollectorBase::insertClient(const std::string &token, intptr_t data)
+/** Pending tokens are removed after 30 seconds. */
+static const time_t TOKEN_TIMEOUT = 30;
+
+static uint64_t getTimeInMillisec()
 {
-    for (std::list<Item>::reverse_iterator it = mPendingConnects.rbegin(),
-         it_end = mPendingConnects.rend(); it != it_end; ++it)
-    {
-        if (it->token == token)
-        {
-            foundMatch(data, it->data);
-            mPendingConnects.erase(--it.base());
-            return;
-        }
-    }
+    timeval time;
+    gettimeofday(&time, 0);
+    return (uint64_t)time.tv_sec * 1000 + time.tv_usec / 1000;
+}
 
-    time_t current = time(nullptr);
+/* Pending items are stored in an expiry wheel of one second buckets, so that
+   outdated items can be removed every second without looking at the other
+   ones, and are indexed by token, so that matching a token does not depend on
+   the number of pending items. When the same token is inserted twice, the
+   index refers to the newer item and the older one just times out. */
 
+void TokenCollectorBase::insert(Pending &pending, const std::string &token,
+                                intptr_t data, bool indexData)
+{
     Item item;
     item.token = token;
     item.data = data;
-    item.timeStamp = current;
-    mPendingClients.push_back(item);
+    item.timeStamp = time(nullptr);
+    item.created = getTimeInMillisec();
+
+    Bucket &bucket = pending.buckets[item.timeStamp % WHEEL_SIZE];
+    Bucket::iterator it = bucket.insert(bucket.end(), item);
+    pending.byToken[token] = it;
+    if (indexData)
+        pending.byData[data] = it;
+    ++pending.size;
+}
 
-    removeOutdated(current);
+void TokenCollectorBase::erase(Pending &pending, Bucket::iterator it)
+{
+    TokenIndex::iterator t = pending.byToken.find(it->token);
+    if (t != pending.byToken.end() && &*t->second == &*it)
+        pending.byToken.erase(t);
+
+    DataIndex::iterator d = pending.byData.find(it->data);
+    if (d != pending.byData.end() && &*d->second == &*it)
+        pending.byData.erase(d);
+
+    pending.buckets[it->timeStamp % WHEEL_SIZE].erase(it);
+    --pending.size;
 }
 
-void TokenCollectorBase::insertConnect(const std::string &token, intptr_t data)
+bool TokenCollectorBase::match(Pending &pending, const std::string &token,
+                               intptr_t &data)
+{
+    TokenIndex::iterator t = pending.byToken.find(token);
+    if (t == pending.byToken.end())
+        return false;
+
+    Bucket::iterator it = t->second;
+    data = it->data;
+
+    const uint64_t latency = getTimeInMillisec() - it->created;
+    ++mStatistics.matched;
+    mStatistics.totalMatchLatency += latency;
+    if (latency > mStatistics.maxMatchLatency)
+        mStatistics.maxMatchLatency = latency;
+
+    erase(pending, it);
+    return true;
+}
+
+void TokenCollectorBase::insertClient(const std::string &token, intptr_t data)
 {
-    for (std::list<Item>::reverse_iterator it = mPendingClients.rbegin(),
-         it_end = mPendingClients.rend(); it != it_end; ++it)
+    intptr_t connect;
+    if (match(mPendingConnects, token, connect))
     {
-        if (it->token == token)
-        {
-            foundMatch(it->data, data);
-            mPendingClients.erase(--it.base());
-            return;
-        }
+        foundMatch(data, connect);
+        return;
     }
 
-    time_t current = time(nullptr);
+    insert(mPendingClients, token, data, true);
+    removeOutdated(time(nullptr));
+}
 
-    Item item;
-    item.token = token;
-    item.data = data;
-    item.timeStamp = current;
-    mPendingConnects.push_back(item);
+void TokenCollectorBase::insertConnect(const std::string &token, intptr_t data)
+{
+    intptr_t client;
+    if (match(mPendingClients, token, client))
+    {
+        foundMatch(client, data);
+        return;
+    }
 
-    removeOutdated(current);
+    insert(mPendingConnects, token, data, false);
+    removeOutdated(time(nullptr));
 }
 
 void TokenCollectorBase::removeClient(intptr_t data)
 {
-    for (std::list<Item>::iterator it = mPendingClients.begin(),
-         it_end = mPendingClients.end(); it != it_end; ++it)
+    DataIndex::iterator d = mPendingClients.byData.find(data);
+    if (d != mPendingClients.byData.end())
+        erase(mPendingClients, d->second);
+}
+
+void TokenCollectorBase::collectOutdated(Pending &pending, unsigned index,
+                                         time_t threshold,
+                                         std::vector<intptr_t> &expired)
+{
+    Bucket &bucket = pending.buckets[index];
+    for (Bucket::iterator it = bucket.begin(); it != bucket.end();)
     {
-        if (it->data == data)
+        Bucket::iterator next = it;
+        ++next;
+        if (it->timeStamp < threshold)
         {
-            mPendingClients.erase(it);
-            return;
+            expired.push_back(it->data);
+            erase(pending, it);
         }
+        it = next;
     }
 }
 
 void TokenCollectorBase::removeOutdated(time_t current)
 {
-    // Timeout happens after 30 seconds. Much longer may actually pass, though.
-    time_t threshold = current - 30;
-    if (threshold < mLastCheck) return;
-
-    std::list<Item>::iterator it;
-
-    it = mPendingConnects.begin();
-    while (it != mPendingConnects.end() && it->timeStamp < threshold)
+    // Timeout happens after 30 seconds, checked with a resolution of one
+    // second.
+    const time_t threshold = current - TOKEN_TIMEOUT;
+    if (threshold <= mExpiredUntil)
+        return;
+
+    // When more time passed than the wheel covers, every bucket is visited
+    // once.
+    time_t first = mExpiredUntil;
+    if (threshold - first > (time_t) WHEEL_SIZE)
+        first = threshold - WHEEL_SIZE;
+
+    std::vector<intptr_t> expiredConnects;
+    std::vector<intptr_t> expiredClients;
+
+    for (time_t second = first; second < threshold; ++second)
     {
-        removedConnect(it->data);
-        it = mPendingConnects.erase(it);
-    }
+        const unsigned index = second % WHEEL_SIZE;
 
-    it = mPendingClients.begin();
-    while (it != mPendingClients.end() && it->timeStamp < threshold)
-    {
-        removedClient(it->data);
-        it = mPendingClients.erase(it);
+        collectOutdated(mPendingConnects, index, threshold, expiredConnects);
+        collectOutdated(mPendingClients, index, threshold, expiredClients);
     }
 
-    mLastCheck = current;
+    mExpiredUntil = threshold;
+    mStatistics.expiredConnects += expiredConnects.size();
+    mStatistics.expiredClients += expiredClients.size();
+
+    // The handler is only told once the collector is consistent again, as it
+    // may call back into it.
+    for (intptr_t data : expiredConnects)
+        removedConnect(data);
+    for (intptr_t data : expiredClients)
+        removedClient(data);
 }
 
 TokenCollectorBase::TokenCollectorBase():
-    mLastCheck(time(nullptr))
+    mExpiredUntil(time(nullptr) - TOKEN_TIMEOUT)
 {
 }
 
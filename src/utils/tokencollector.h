@@ -24,8 +24,27 @@
 #include <stdint.h>
 #include <string>
 #include <list>
+#include <unordered_map>
+#include <vector>
 #include <time.h>
 
+/**
+ * Counters describing how well tokens are matched.
+ */
+struct TokenStatistics
+{
+    TokenStatistics():
+        matched(0), expiredClients(0), expiredConnects(0),
+        totalMatchLatency(0), maxMatchLatency(0)
+    {}
+
+    unsigned matched;           /**< Number of tokens matched. */
+    unsigned expiredClients;    /**< Clients that timed out. */
+    unsigned expiredConnects;   /**< Server data that timed out. */
+    uint64_t totalMatchLatency; /**< Sum of match latencies in ms. */
+    unsigned maxMatchLatency;   /**< Highest match latency in ms. */
+};
+
 /**
  * Base class containing the generic implementation of TokenCollector.
  */
@@ -36,24 +55,50 @@ class TokenCollectorBase
             std::string token; /**< Cookie used by the client. */
             intptr_t data;     /**< User data. */
             time_t timeStamp;  /**< Creation time. */
+            uint64_t created;  /**< Creation time in milliseconds. */
         };
 
+        typedef std::list<Item> Bucket;
+        typedef std::unordered_map<std::string, Bucket::iterator> TokenIndex;
+        typedef std::unordered_map<intptr_t, Bucket::iterator> DataIndex;
+
         /**
-         * List containing client already connected. Newer clients are at the
-         * back of the list.
+         * Number of one second buckets in the expiry wheel. Needs to be
+         * larger than the timeout, so that a bucket never holds items of
+         * different turns of the wheel.
          */
-        std::list<Item> mPendingClients;
+        static const unsigned WHEEL_SIZE = 32;
 
         /**
-         * List containing server data waiting for clients. Newer data are at
-         * the back of the list.
+         * Pending items of one side, stored in the bucket of the second they
+         * were created in and indexed by token. Pending clients are also
+         * indexed by their data, so that they can be removed directly.
          */
-        std::list<Item> mPendingConnects;
+        struct Pending
+        {
+            Bucket buckets[WHEEL_SIZE];
+            TokenIndex byToken;
+            DataIndex byData;
+            unsigned size;
+
+            Pending(): size(0) {}
+        };
+
+        Pending mPendingClients;    /**< Clients already connected. */
+        Pending mPendingConnects;   /**< Server data waiting for clients. */
 
         /**
-         * Time at which the TokenCollector performed its last check.
+         * Items created before this time were already removed.
          */
-        time_t mLastCheck;
+        time_t mExpiredUntil;
+
+        TokenStatistics mStatistics;
+
+        void insert(Pending &, const std::string &, intptr_t, bool indexData);
+        void erase(Pending &, Bucket::iterator);
+        bool match(Pending &, const std::string &, intptr_t &data);
+        void collectOutdated(Pending &, unsigned index, time_t threshold,
+                             std::vector<intptr_t> &expired);
 
     protected:
 
@@ -66,6 +111,15 @@ class TokenCollectorBase
         void removeClient(intptr_t);
         void insertConnect(const std::string &, intptr_t);
         void removeOutdated(time_t);
+
+        const TokenStatistics &statistics() const
+        { return mStatistics; }
+
+        unsigned pendingClientCount() const
+        { return mPendingClients.size; }
+
+        unsigned pendingConnectCount() const
+        { return mPendingConnects.size; }
 };
 
 /**
@@ -122,6 +176,25 @@ class TokenCollector: private TokenCollectorBase
         void deletePendingClient(Client data)
         { removeClient((intptr_t)data); }
 
+        /**
+         * Removes the items that timed out. Meant to be called about once
+         * per second or more often; calls in the same second return early.
+         */
+        void removeExpired()
+        { removeOutdated(time(nullptr)); }
+
+        /**
+         * Returns the counters of matched and expired tokens.
+         */
+        const TokenStatistics &getStatistics() const
+        { return statistics(); }
+
+        unsigned getPendingClientCount() const
+        { return pendingClientCount(); }
+
+        unsigned getPendingConnectCount() const
+        { return pendingConnectCount(); }
+
     private:
 
         void removedClient(intptr_t data)
@@ -0,0 +1,210 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "utils/tracer.h"
+
+#include "common/configuration.h"
+#include "utils/logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+namespace utils
+{
+
+bool Tracer::mEnabled = false;
+std::string Tracer::mTraceFile;
+
+/**
+ * A finished span.
+ */
+struct TraceEvent
+{
+    const char *category;
+    const char *name;
+    uint64_t start;
+    uint32_t duration;
+    std::string detail;
+};
+
+/** Ring buffer of the recorded spans. */
+static std::vector<TraceEvent> events;
+/** Index at which the next span is written. */
+static size_t nextEvent = 0;
+/** Whether the buffer was filled completely at least once. */
+static bool wrapped = false;
+/** Set by signal handlers. */
+static volatile sig_atomic_t dumpRequested = 0;
+
+/**
+ * Writes a string as a JSON string literal.
+ */
+static void writeJsonString(std::ostream &os, const std::string &text)
+{
+    os << '"';
+    for (std::string::const_iterator i = text.begin(), i_end = text.end();
+         i != i_end; ++i)
+    {
+        const unsigned char c = *i;
+        switch (c)
+        {
+            case '"':  os << "\\\""; break;
+            case '\\': os << "\\\\"; break;
+            case '\n': os << "\\n"; break;
+            case '\t': os << "\\t"; break;
+            default:
+                if (c < 0x20)
+                {
+                    char buffer[8];
+                    snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                    os << buffer;
+                }
+                else
+                {
+                    os << c;
+                }
+        }
+    }
+    os << '"';
+}
+
+static void writeEvent(std::ostream &os, const TraceEvent &event)
+{
+    os << "{\"name\":\"" << event.name
+       << "\",\"cat\":\"" << event.category
+       << "\",\"ph\":\"X\",\"ts\":" << event.start
+       << ",\"dur\":" << event.duration
+       << ",\"pid\":1,\"tid\":1";
+
+    if (!event.detail.empty())
+    {
+        os << ",\"args\":{\"detail\":";
+        writeJsonString(os, event.detail);
+        os << '}';
+    }
+    os << '}';
+}
+
+void Tracer::initialize(const std::string &traceFile)
+{
+    mTraceFile = traceFile;
+
+    setEnabled(Configuration::getBoolValue("log_traceEnabled", false),
+               Configuration::getValue("log_traceBufferSize", 65536));
+}
+
+void Tracer::setEnabled(bool enable, unsigned capacity)
+{
+    if (enable)
+    {
+        events.clear();
+        events.resize(std::max(1u, capacity));
+        nextEvent = 0;
+        wrapped = false;
+        LOG_INFO("Tracing enabled, keeping the last " << events.size()
+                 << " spans.");
+    }
+    else if (mEnabled)
+    {
+        LOG_INFO("Tracing disabled.");
+    }
+
+    mEnabled = enable;
+}
+
+uint64_t Tracer::now()
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(
+            steady_clock::now().time_since_epoch()).count();
+}
+
+void Tracer::record(const char *category, const char *name,
+                    uint64_t start, uint64_t end,
+                    const std::string &detail)
+{
+    if (!mEnabled)
+        return;
+
+    TraceEvent &event = events[nextEvent];
+    event.category = category;
+    event.name = name;
+    event.start = start;
+    event.duration = end - start;
+    event.detail = detail;
+
+    if (++nextEvent == events.size())
+    {
+        nextEvent = 0;
+        wrapped = true;
+    }
+}
+
+bool Tracer::dump(const std::string &fileName)
+{
+    std::ofstream os(fileName.c_str());
+    if (!os)
+    {
+        LOG_ERROR("Unable to write the trace to " << fileName);
+        return false;
+    }
+
+    // Oldest spans first.
+    const size_t count = wrapped ? events.size() : nextEvent;
+    const size_t first = wrapped ? nextEvent : 0;
+
+    os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (i)
+            os << ",\n";
+        writeEvent(os, events[(first + i) % events.size()]);
+    }
+    os << "\n]}\n";
+
+    LOG_INFO("Wrote " << count << " trace spans to " << fileName);
+    return true;
+}
+
+bool Tracer::dump()
+{
+    return dump(mTraceFile);
+}
+
+void Tracer::requestDump()
+{
+    dumpRequested = 1;
+}
+
+void Tracer::update()
+{
+    if (!dumpRequested)
+        return;
+
+    dumpRequested = 0;
+    dump();
+}
+
+} // namespace utils
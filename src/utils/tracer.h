@@ -0,0 +1,151 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <stdint.h>
+#include <string>
+
+namespace utils
+{
+
+/**
+ * Records spans of server activity for later inspection in a trace viewer.
+ *
+ * While enabled, finished spans are kept in a fixed-size ring buffer, so
+ * that the most recent activity is always available. On request, the buffer
+ * is written out in the Chrome trace event format, which can be opened with
+ * chrome://tracing or Perfetto.
+ *
+ * When disabled, a span costs the check of a flag, so the instrumentation
+ * can stay compiled in.
+ */
+class Tracer
+{
+    public:
+        /**
+         * Reads the tracing options from the configuration.
+         *
+         * @param traceFile the file written by dump requests.
+         */
+        static void initialize(const std::string &traceFile);
+
+        /**
+         * Starts or stops recording spans. Starting clears the buffer.
+         *
+         * @param enable whether to record spans.
+         * @param capacity the number of spans kept in the buffer.
+         */
+        static void setEnabled(bool enable, unsigned capacity = 65536);
+
+        static bool isEnabled()
+        { return mEnabled; }
+
+        /**
+         * Returns the current time in microseconds, on the clock used for
+         * the span timestamps.
+         */
+        static uint64_t now();
+
+        /**
+         * Adds a finished span to the buffer.
+         *
+         * @param category the category of the span, must be a literal.
+         * @param name the name of the span, must be a literal.
+         * @param start the start time as returned by now().
+         * @param end the end time as returned by now().
+         * @param detail an optional argument shown with the span.
+         */
+        static void record(const char *category, const char *name,
+                           uint64_t start, uint64_t end,
+                           const std::string &detail = std::string());
+
+        /**
+         * Writes the spans in the buffer to the given file.
+         *
+         * @return whether the file could be written.
+         */
+        static bool dump(const std::string &fileName);
+
+        /**
+         * Writes the spans to the configured trace file.
+         */
+        static bool dump();
+
+        /**
+         * Asks for a dump at the next call to update(). Safe to call from
+         * a signal handler.
+         */
+        static void requestDump();
+
+        /**
+         * Performs the requested dump, if any. Called from the main loop.
+         */
+        static void update();
+
+        static const std::string &getTraceFile()
+        { return mTraceFile; }
+
+    private:
+        static bool mEnabled;
+        static std::string mTraceFile;
+};
+
+/**
+ * Records the time between its construction and destruction as a span.
+ */
+class TraceSpan
+{
+    public:
+        TraceSpan(const char *category, const char *name):
+            mCategory(category),
+            mName(name),
+            mStart(Tracer::isEnabled() ? Tracer::now() : 0)
+        {}
+
+        ~TraceSpan()
+        {
+            if (mStart)
+                Tracer::record(mCategory, mName, mStart, Tracer::now(),
+                               mDetail);
+        }
+
+        /**
+         * Whether the span is being recorded. Use this to avoid building
+         * details for nothing.
+         */
+        bool isRecording() const
+        { return mStart != 0; }
+
+        void setDetail(const std::string &detail)
+        { mDetail = detail; }
+
+    private:
+        const char *mCategory;
+        const char *mName;
+        uint64_t mStart;
+        std::string mDetail;
+};
+
+} // namespace utils
+
+#endif // TRACER_H
@@ -38,8 +38,11 @@ static void logZlibError(int error)
         case Z_DATA_ERROR:
             LOG_ERROR("Incorrect zlib compressed data!");
             break;
+        case Z_BUF_ERROR:
+            LOG_ERROR("Buffer too small while compressing data!");
+            break;
         default:
-            LOG_ERROR("Unknown error while decompressing data!");
+            LOG_ERROR("Unknown error while (de)compressing data!");
     }
 }
 
@@ -115,3 +118,29 @@ bool inflateMemory(char *in, unsigned inLength,
     inflateEnd(&strm);
     return true;
 }
+
+bool deflateMemory(const char *in, unsigned inLength,
+                   char *&out, unsigned &outLength)
+{
+    uLongf bufferSize = compressBound(inLength);
+    out = (char *)malloc(bufferSize);
+
+    if (!out)
+    {
+        logZlibError(Z_MEM_ERROR);
+        return false;
+    }
+
+    int ret = compress2((Bytef *)out, &bufferSize,
+                        (const Bytef *)in, inLength, Z_BEST_SPEED);
+
+    if (ret != Z_OK)
+    {
+        logZlibError(ret);
+        free(out);
+        return false;
+    }
+
+    outLength = bufferSize;
+    return true;
+}
@@ -29,4 +29,12 @@
 bool inflateMemory(char *in, unsigned inLength,
                    char *&out, unsigned &outLength);
 
+/**
+ * Deflates memory into the zlib format, favouring speed over compression
+ * ratio. The deflated memory is expected to be freed by the caller. Returns
+ * true if the deflation was sucessful.
+ */
+bool deflateMemory(const char *in, unsigned inLength,
+                   char *&out, unsigned &outLength);
+
 #endif